@@ -1,11 +1,24 @@
+#include <charconv>
+#include <cstdlib>
+#include <filesystem>
 #include <queue>
 #include <string>
 #include <sstream>
 #include <stdexcept>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include "parser/parser.h"
 #include "interpreter/interpreter.h"
+#include "interpreter/optimizer.h"
+#include "interpreter/constants.h"
+#include "interpreter/except.h"
+#include "interpreter/vm/machine.h"
+#include "interpreter/jit/compiler.h"
+#include "interpreter/tiers.h"
+#include "interpreter/profiles.h"
+#include "interpreter/aot/emitter.h"
+#include "toolchain.h"
 
 class ArgumentReader {
     std::queue<std::string> arguments;
@@ -32,6 +45,14 @@ public:
         }
         return false;
     }
+    auto readOption(const std::string& name) -> std::optional<std::string> {
+        const auto prefix = name + "=";
+        if (arguments.empty()) return std::nullopt;
+        if (!arguments.front().starts_with(prefix)) return std::nullopt;
+        auto value = arguments.front().substr(prefix.size());
+        arguments.pop();
+        return value;
+    }
     auto read(const std::string& argName) -> std::string {
         if (arguments.empty()) {
             throw ArgumentException(argName);
@@ -42,22 +63,126 @@ public:
     }
 };
 
-auto executeCode(const std::string& filename, std::istream& stream) -> void {
+enum class Engine { TreeWalker, VirtualMachine };
+
+struct RunOptions {
+    Engine engine = Engine::TreeWalker;
+    interpreter::Options engineOptions;
+    bool jitStatistics = false;
+    bool tierStatistics = false;
+    bool dumpOptimized = false;
+    bool stream = false;
+    std::optional<std::string> profileIn;
+    std::optional<std::string> profileOut;
+};
+
+auto printJitStatistics() -> void {
+    const auto &statistics = interpreter::jit::statistics();
+    std::cerr << "JIT: " << statistics.compiled << " region(s) compiled, "
+              << statistics.rejected << " rejected" << std::endl;
+    std::cerr << "JIT: " << statistics.entered << " native run(s), "
+              << statistics.bailedOut << " bail-out(s) to the interpreter" << std::endl;
+}
+
+auto printTierStatistics() -> void {
+    const auto &promotions = interpreter::tiers::promotions();
+    std::cerr << "Tiers: " << promotions.size() << " unit(s) promoted" << std::endl;
+    for (const auto &each : promotions) {
+        std::cerr << "Tiers: " << each.unit << " promoted at " << each.milliseconds << " ms"
+                  << " after " << each.calls << " call(s) and " << each.iterations << " loop iteration(s)"
+                  << ", by " << each.reason << std::endl;
+    }
+}
+
+auto printParserErrors(const parser::Parser& _parser) -> void {
+    std::cerr << "Encountered errors while parsing: " << std::endl;
+    for (const auto &each : _parser.getErrors()) {
+        std::cerr << each << std::endl;
+    }
+}
+
+auto printFatalError(const std::string& error) -> void {
+    std::cerr << std::endl << "Encountered a fatal error during runtime: "  << std::endl;
+    std::cerr << error << std::endl;
+}
+
+// both engines share the same public interface
+template<typename EngineType>
+auto executeWith(const std::string& filename, Program& ast, const interpreter::Options& options) -> void {
+    EngineType engine(filename, {}, options);
+    engine.executeProgram(ast);
+    const auto maybeError = engine.getFatalError();
+    if (maybeError.has_value()) {
+        printFatalError(maybeError.value());
+    }
+}
+
+// Each statement runs as soon as it is read, as a program of its own on
+// the same engine. Only the statements whose functions are still around
+// stay in memory, and output starts before the rest of the file is read.
+// An error stops the run where it is found, after the statements before it
+template<typename EngineType>
+auto streamWith(const std::string& filename, parser::Parser& _parser, const RunOptions& options) -> void {
+    EngineType engine(filename, {}, options.engineOptions);
+    interpreter::Constants::Stream constants;
+    while (!_parser.eof()) {
+        std::vector<StatementPtr> statements;
+        statements.push_back(_parser.readStatement());
+        if (!_parser.getErrors().empty()) {
+            printParserErrors(_parser);
+            return;
+        }
+        auto position = statements.front()->position;
+        const auto program = std::make_shared<Program>(statements, position);
+        try {
+            constants.check(*program);
+        } catch (const interpreter::exceptions::RuntimeException &exception) {
+            printFatalError(exception.what());
+            return;
+        }
+        if (options.engineOptions.optimizationLevel > 0) {
+            interpreter::Optimizer::optimize(*program);
+        }
+        if (options.dumpOptimized) {
+            std::cout << program->toFormatString();
+            continue;
+        }
+        engine.executeStreamed(program);
+        const auto maybeError = engine.getFatalError();
+        if (maybeError.has_value()) {
+            printFatalError(maybeError.value());
+            return;
+        }
+    }
+}
+
+auto executeCode(const std::string& filename, std::istream& stream, const RunOptions& options = {}) -> void {
     parser::Parser _parser(stream);
+    if (options.stream) {
+        switch (options.engine) {
+            case Engine::TreeWalker:
+                return streamWith<interpreter::Interpreter>(filename, _parser, options);
+            case Engine::VirtualMachine:
+                return streamWith<interpreter::vm::Machine>(filename, _parser, options);
+        }
+    }
     const auto ast = _parser.readProgram();
     if (!_parser.getErrors().empty()) {
-        std::cerr << "Encountered errors while parsing: " << std::endl;
-        for (const auto &each : _parser.getErrors()) {
-            std::cerr << each << std::endl;
-        }
+        printParserErrors(_parser);
         return;
     }
-    interpreter::Interpreter _interpreter(filename);
-    _interpreter.executeProgram(*ast);
-    const auto maybeError = _interpreter.getFatalError();
-    if (maybeError.has_value()) {
-        std::cerr << std::endl << "Encountered a fatal error during runtime: "  << std::endl;
-        std::cerr << maybeError.value() << std::endl;
+    if (options.engineOptions.optimizationLevel > 0) {
+        interpreter::Optimizer::optimize(*ast);
+    }
+    if (options.dumpOptimized) {
+        std::cout << ast->toFormatString();
+        return;
+    }
+    switch (options.engine) {
+        case Engine::TreeWalker:
+            return executeWith<interpreter::Interpreter>(filename, *ast, options.engineOptions);
+        case Engine::VirtualMachine:
+            return executeWith<interpreter::vm::Machine>(filename, *ast, options.engineOptions);
     }
 }
 
@@ -77,13 +202,215 @@ auto runConsole() -> void {
     }
 }
 
-auto runFile(const std::string& filename) -> void {
+auto runFile(const std::string& filename, const RunOptions& options) -> int {
     std::fstream filestream(filename);
     if (!filestream.good()) {
         std::cerr << "Error while opening file \"" << filename << "\". Maybe file does not exist" << std::endl;
-        return;
+        return 1;
+    }
+    if (options.profileIn.has_value() || options.profileOut.has_value()) {
+        interpreter::profiles::enable();
+    }
+    if (options.profileIn.has_value() && !interpreter::profiles::load(*options.profileIn)) {
+        std::cerr << "Error while reading profile \"" << *options.profileIn << "\". Maybe file does not exist or is not a profile" << std::endl;
+        return 1;
+    }
+    executeCode(filename, filestream, options);
+    if (options.profileOut.has_value() && !interpreter::profiles::save(*options.profileOut)) {
+        std::cerr << "Error while writing profile \"" << *options.profileOut << "\". Maybe its directory does not exist or is not writable" << std::endl;
+        return 1;
+    }
+    if (options.jitStatistics) {
+        printJitStatistics();
+    }
+    if (options.tierStatistics) {
+        printTierStatistics();
+    }
+    return 0;
+}
+
+// whole text of a decimal count: no sign, spaces or trailing characters
+auto readCount(const std::string& text) -> std::optional<size_t> {
+    size_t count;
+    const auto end = text.data() + text.size();
+    const auto [stop, error] = std::from_chars(text.data(), end, count);
+    if (error != std::errc() || stop != end) {
+        return std::nullopt;
+    }
+    return count;
+}
+
+// other commands may take options of their own among these
+auto readRunOptions(ArgumentReader& reader, const std::function<bool()>& readOther = {}) -> std::optional<RunOptions> {
+    RunOptions options;
+    while (true) {
+        if (const auto engine = reader.readOption("--engine")) {
+            if (*engine == "tree") {
+                options.engine = Engine::TreeWalker;
+            } else if (*engine == "vm") {
+                options.engine = Engine::VirtualMachine;
+            } else {
+                std::cerr << "Unknown engine \"" << *engine << "\", expected \"tree\" or \"vm\"" << std::endl;
+                return std::nullopt;
+            }
+            continue;
+        }
+        if (const auto depth = reader.readOption("--max-call-depth")) {
+            const auto count = readCount(*depth);
+            if (!count.has_value()) {
+                std::cerr << "Expected a number of calls, found \"" << *depth << "\"" << std::endl;
+                return std::nullopt;
+            }
+            options.engineOptions.maxCallDepth = *count;
+            continue;
+        }
+        if (const auto budget = reader.readOption("--inline-budget")) {
+            const auto count = readCount(*budget);
+            if (!count.has_value()) {
+                std::cerr << "Expected a number of nodes, found \"" << *budget << "\"" << std::endl;
+                return std::nullopt;
+            }
+            options.engineOptions.inlineBudget = *count;
+            continue;
+        }
+        if (const auto threshold = reader.readOption("--tier-threshold")) {
+            const auto count = readCount(*threshold);
+            if (!count.has_value()) {
+                std::cerr << "Expected a number of calls and iterations, found \"" << *threshold << "\"" << std::endl;
+                return std::nullopt;
+            }
+            options.engineOptions.tierThreshold = *count;
+            continue;
+        }
+        if (const auto path = reader.readOption("--profile-in")) {
+            options.profileIn = *path;
+            continue;
+        }
+        if (const auto path = reader.readOption("--profile-out")) {
+            options.profileOut = *path;
+            continue;
+        }
+        if (reader.readIf("--tier-stats")) {
+            options.tierStatistics = true;
+            continue;
+        }
+        if (reader.readIf("--jit")) {
+            options.engineOptions.jit = true;
+            continue;
+        }
+        if (reader.readIf("--jit-stats")) {
+            options.jitStatistics = true;
+            continue;
+        }
+        if (reader.readIf("-O0")) {
+            options.engineOptions.optimizationLevel = 0;
+            continue;
+        }
+        if (reader.readIf("-O1")) {
+            options.engineOptions.optimizationLevel = 1;
+            continue;
+        }
+        if (reader.readIf("--dump-optimized")) {
+            options.dumpOptimized = true;
+            continue;
+        }
+        if (reader.readIf("--no-tail-calls")) {
+            options.engineOptions.tailCalls = false;
+            continue;
+        }
+        if (reader.readIf("--stream")) {
+            options.stream = true;
+            continue;
+        }
+        if (readOther && readOther()) continue;
+        return options;
     }
-    executeCode(filename, filestream);
+}
+
+struct BuildOptions {
+    std::optional<std::string> output;
+    bool emitCpp = false;
+};
+
+auto readBuildOption(ArgumentReader& reader, BuildOptions& options) -> bool {
+    if (const auto output = reader.readOption("--output")) {
+        options.output = *output;
+        return true;
+    }
+    if (reader.readIf("--emit-cpp")) {
+        options.emitCpp = true;
+        return true;
+    }
+    return false;
+}
+
+struct RuntimeFlags {
+    std::string includes;
+    std::string libraries;
+};
+
+// the runtime installed with this executable, in <prefix>/include
+// and <prefix>/lib next to <prefix>/bin, otherwise the one of the tree
+// it was built in: an executable that is only moved finds neither
+auto findRuntime() -> RuntimeFlags {
+    std::error_code error;
+    const auto executable = std::filesystem::canonical("/proc/self/exe", error);
+    if (!error) {
+        const auto prefix = executable.parent_path().parent_path();
+        if (std::filesystem::exists(prefix / "include" / "interpreter" / "aot" / "runtime.h", error)) {
+            return {
+                "-I\"" + (prefix / "include").string() + "\"",
+                "-L\"" + (prefix / "lib").string() + "\" -ltoy_lang_interpreter -ltoy_lang_parser -ltoy_lang_lexer -ltoy_lang_utils",
+            };
+        }
+    }
+    return { TOY_RUNTIME_INCLUDES, TOY_RUNTIME_LIBRARIES };
+}
+
+auto buildFile(const std::string& filename, const RunOptions& runOptions, const BuildOptions& options) -> int {
+    std::ifstream filestream(filename);
+    if (!filestream.good()) {
+        std::cerr << "Error while opening file \"" << filename << "\". Maybe file does not exist" << std::endl;
+        return 1;
+    }
+    parser::Parser _parser(filestream);
+    const auto ast = _parser.readProgram();
+    if (!_parser.getErrors().empty()) {
+        std::cerr << "Encountered errors while parsing: " << std::endl;
+        for (const auto &each : _parser.getErrors()) {
+            std::cerr << each << std::endl;
+        }
+        return 1;
+    }
+
+    const auto virtualMachine = runOptions.engine == Engine::VirtualMachine;
+    bool lowered;
+    const auto source = interpreter::aot::Emitter::emitExecutable(filename, *ast, runOptions.engineOptions, virtualMachine, lowered);
+    if (!lowered) {
+        std::cerr << "Note: \"" << filename << "\" is not straight-line code, its syntax tree is embedded and run by the engine" << std::endl;
+    }
+    const auto stem = filename.ends_with(".toy") ? filename.substr(0, filename.size() - 4) : filename + ".out";
+    const auto output = options.output.value_or(stem);
+    const auto sourceName = output + ".cpp";
+    std::ofstream sourceStream(sourceName);
+    if (!sourceStream.is_open()) {
+        std::cerr << "Error while writing file \"" << sourceName << "\"" << std::endl;
+        return 1;
+    }
+    sourceStream << source;
+    sourceStream.close();
+    if (options.emitCpp) return 0;
+
+    const auto compiler = std::getenv("CXX") != nullptr ? std::string(std::getenv("CXX")) : std::string(TOY_CXX_COMPILER);
+    const auto runtime = findRuntime();
+    const auto command = compiler + " -std=c++23 -O2 " + runtime.includes
+        + " \"" + sourceName + "\" " + runtime.libraries + " -o \"" + output + "\"";
+    if (std::system(command.c_str()) != 0) {
+        std::cerr << "Compiler failed to build \"" << output << "\" from \"" << sourceName << "\"" << std::endl;
+        return 1;
+    }
+    std::remove(sourceName.c_str());
+    return 0;
 }
 
 auto formatFile(const std::string& filename) -> void {
@@ -131,14 +458,99 @@ multiple commands for you to utilize:
     a new empty line
 
 3) run
-    [usage: toylang run <filename>]
+    [usage: toylang run [options] <filename>]
     Runs code you provided in a particular file
     under the name <filename>
+    Options:
+    --engine=tree|vm
+        Selects the execution engine: the
+        tree-walking interpreter (default)
+        or the bytecode virtual machine
+    --max-call-depth=<number>
+        Raises a runtime error when calls
+        nest deeper, 200000 by default in
+        both engines. The tree-walking
+        interpreter may run out of its 1 GiB
+        native stack before
+    --jit
+        Translates loops that only compute on
+        numbers into native x86-64 code
+        (tree-walking interpreter on Linux)
+    --jit-stats
+        Reports how many loops were compiled
+        and how often they fell back to the
+        interpreter
+    --no-tail-calls
+        Makes `return f(...)` grow the call
+        stack like any other call, so that
+        error traces list every frame
+    -O0, -O1
+        Whether constant expressions are
+        computed and unreachable code is
+        removed before running (default -O1)
+    --dump-optimized
+        Prints the program as it is after
+        the optimizations instead of running it
+    --stream
+        Runs each top-level statement as soon
+        as it is read, keeping in memory only
+        the ones whose functions are still in
+        use. Meant for very large or generated
+        files: output starts right away, and an
+        error stops the run after the statements
+        before it have run. Constants are only
+        propagated within a statement
+    --inline-budget=<number>
+        Calls of top-level functions that only
+        return an expression of at most this
+        many nodes are replaced by the expression
+        (tree-walking interpreter, -O1, default 16,
+        0 turns it off)
+    --tier-threshold=<number>
+        Functions and the top level start without
+        inlined calls and native loops; they get
+        them once their calls and loop iterations
+        reach this count (default 1000, 0 compiles
+        everything before running)
+    --tier-stats
+        Reports which functions were promoted,
+        when and what made them hot
+    --profile-out=<path>
+        Saves to <path> what the operations,
+        property accesses and functions of the
+        tree-walking interpreter specialized on
+    --profile-in=<path>
+        Starts them specialized as recorded in
+        <path>, skipping the warm-up. Files that
+        changed since start from scratch
 
 4) format
     [usage: toylang format <filename>]
     Formats code in a file under the
     name <filename>
+
+5) build
+    [usage: toylang build [options] <filename>]
+    Compiles the program in <filename> and
+    the modules it imports into a standalone
+    executable that behaves as `run` would
+    with the same engine options. A program
+    made only of declarations, echo and
+    expressions without functions is turned
+    into C++ itself; others (with functions,
+    loops, conditionals, match or imports)
+    are embedded and run by the engine, and
+    a note says so. Needs the C++ compiler
+    this interpreter was built with (or the
+    one named by CXX), and the runtime that
+    `cmake --install` puts next to it (or the
+    build tree it was built in)
+    Options of `run`, and:
+    --output=<path>
+        Where to put the executable (default:
+        <filename> without the .toy extension)
+    --emit-cpp
+        Only writes the C++ source, to <path>.cpp
 )";
     std::cout << information;
 }
@@ -154,9 +566,17 @@ auto main(int argc, char* argv[]) -> int {
         return 0;
     }
     if (reader.readIf("run")) {
+        const auto options = readRunOptions(reader);
+        if (!options.has_value()) return 1;
         const auto filename = reader.read("filename");
-        runFile(filename);
-        return 0;
+        return runFile(filename, *options);
+    }
+    if (reader.readIf("build")) {
+        BuildOptions buildOptions;
+        const auto options = readRunOptions(reader, [&] { return readBuildOption(reader, buildOptions); });
+        if (!options.has_value()) return 1;
+        const auto filename = reader.read("filename");
+        return buildFile(filename, *options, buildOptions);
     }
     if (reader.readIf("format")) {
         const auto filename = reader.read("filename");
@@ -0,0 +1,60 @@
+/*
+ * Translates a program into the C++ source of an executable
+ * running it on the runtime library, see aot/runtime.h.
+ * Modules it imports are read and embedded as well when they
+ * can be found and parsed at build time. The others are
+ * looked up at runtime and fail the way they do under `run`.
+ * A straight-line program (declarations, echo and expressions
+ * of builtin calls, operators, literals and indexing, with
+ * every name declared before it is read) is lowered instead:
+ * it becomes C++ computing the values with the handlers of the
+ * engines, and no syntax tree is built or walked when it runs.
+ * Functions, loops, conditionals, match and imports are not
+ * lowered: a program using any of them is embedded as a whole
+ */
+
+#pragma once
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "parser/ast.h"
+#include "interpreter/options.h"
+
+using namespace parser::AST;
+
+namespace interpreter::aot {
+    class Emitter final {
+        // files of the imported modules, in the order they were found
+        std::vector<std::string> modules;
+        std::set<std::string> seen;
+        // variables of a lowered program by name, and labels of its nodes
+        std::map<std::string, std::string> locals;
+        std::vector<std::string> labels;
+        std::string emitProgram(const Program &program, const std::string &function);
+        std::string emitStatement(const StatementPtr &statement);
+        std::string emitExpression(const ExpressionPtr &expression);
+        std::string emitStatements(const std::vector<StatementPtr> &statements);
+        std::string emitExpressions(const std::vector<ExpressionPtr> &expressions);
+        static std::string emitOptions(const Options &options);
+        static bool straightLine(Program &program);
+        static bool straightLine(const ExpressionPtr &expression, const std::set<std::string> &declared);
+        std::string lowerProgram(const Program &program);
+        std::string lowerStatement(const StatementPtr &statement);
+        std::string lowerExpression(const ExpressionPtr &expression);
+        std::string label(const Node* node);
+        static std::string quoted(const std::string &text);
+        static std::string number(long double value);
+        static std::string position(const Node* node);
+    public:
+        // a program that is lowered is optimized in place first,
+        // lowered tells whether it was or its tree got embedded
+        static std::string emitExecutable (
+            const std::string &filename,
+            Program &program,
+            const Options &options,
+            bool virtualMachine,
+            bool &lowered
+        );
+    };
+}
@@ -0,0 +1,18 @@
+/*
+ * Modules built into an executable by `toy_lang_app build`.
+ * Imports take the syntax tree from here when the module
+ * was embedded and read the file as usual otherwise
+ */
+
+#pragma once
+#include <string>
+#include "parser/ast.h"
+
+namespace interpreter::aot {
+    using parser::AST::ProgramPtr;
+    using ModuleBuilder = ProgramPtr (*)();
+
+    void embedModule(const std::string &filename, ModuleBuilder builder);
+    // a fresh tree for every import, nullptr when it was not embedded
+    ProgramPtr embeddedModule(const std::string &filename);
+}
@@ -0,0 +1,94 @@
+/*
+ * Support of the executables produced by `toy_lang_app build`.
+ * The emitted source rebuilds the syntax trees of the program
+ * and of its modules with the functions below, so nothing is
+ * read or parsed when it starts, then runs the program with
+ * the options it was built with, exactly as `run` would.
+ * A straight-line program is emitted as C++ working on the
+ * values instead, with the helpers at the end of this file
+ */
+
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include "parser/ast.h"
+#include "interpreter/options.h"
+#include "interpreter/except.h"
+#include "interpreter/types.h"
+#include "modules.h"
+
+namespace interpreter::aot {
+    using namespace parser::AST;
+    using ObjectEntry = ObjectExpression::ObjectList::value_type;
+    using MatchCase = MatchStatement::CaseList::value_type;
+
+    template <typename Item, typename... Each>
+    std::vector<Item> list(Each... each) {
+        std::vector<Item> items;
+        items.reserve(sizeof...(each));
+        (items.push_back(std::move(each)), ...);
+        return items;
+    }
+
+    // Builders of nodes. An optional child is passed as nullptr when absent
+    ProgramPtr program(std::vector<StatementPtr> statements, Position position);
+    // statements
+    StatementPtr importLibrary(std::string libName, std::optional<std::string> alias, Position position);
+    StatementPtr variableDeclaration(std::string name, ExpressionPtr value, bool constant, Position position);
+    StatementPtr functionDeclaration(std::string name, std::vector<ExpressionPtr> parameters, StatementPtr body, Position position);
+    StatementPtr forLoop(std::string variable, ExpressionPtr start, ExpressionPtr end, ExpressionPtr step, StatementPtr body, Position position);
+    StatementPtr forInLoop(std::vector<std::string> variables, ExpressionPtr collection, StatementPtr body, Position position);
+    StatementPtr whileLoop(ExpressionPtr condition, StatementPtr body, Position position);
+    StatementPtr ifElse(ExpressionPtr condition, StatementPtr mainClause, StatementPtr elseClause, Position position);
+    StatementPtr match(ExpressionPtr subject, std::vector<MatchCase> cases, StatementPtr elseClause, Position position);
+    StatementPtr continueOperator(Position position);
+    StatementPtr breakOperator(Position position);
+    StatementPtr returnOperator(ExpressionPtr expression, Position position);
+    StatementPtr yieldStatement(ExpressionPtr expression, Position position);
+    StatementPtr bareExpression(ExpressionPtr expression, Position position);
+    StatementPtr block(std::vector<StatementPtr> statements, Position position);
+    StatementPtr echo(ExpressionPtr expression, Position position);
+    StatementPtr illegalStatement(Position position);
+    // expressions
+    ExpressionPtr binaryOperation(ExpressionPtr left, std::string op, ExpressionPtr right, Position position);
+    ExpressionPtr prefixOperation(std::string op, ExpressionPtr expression, Position position);
+    ExpressionPtr call(ExpressionPtr target, std::vector<ExpressionPtr> arguments, Position position);
+    ExpressionPtr indexAccess(ExpressionPtr target, ExpressionPtr index, Position position);
+    ExpressionPtr number(long double value, Position position);
+    ExpressionPtr boolean(bool value, Position position);
+    ExpressionPtr string(std::string value, Position position);
+    ExpressionPtr nil(Position position);
+    ExpressionPtr array(std::vector<ExpressionPtr> values, Position position);
+    ExpressionPtr variable(std::string name, Position position);
+    ExpressionPtr lambda(std::vector<ExpressionPtr> parameters, StatementPtr body, Position position);
+    ExpressionPtr object(std::vector<ObjectEntry> entries, Position position);
+    ExpressionPtr interpolation(std::vector<ExpressionPtr> parts, Position position);
+    ExpressionPtr illegalExpression(Position position);
+
+    // what `run` does once the program is parsed
+    void execute(const std::string &filename, Program &program, const Options &options, bool virtualMachine);
+
+    // Runs the code of a node, labeling an error
+    // leaving it the way the engines label it
+    template <typename Body>
+    auto at(const std::string &label, Body body) -> decltype(body()) {
+        try {
+            return body();
+        } catch (exceptions::PropagatedException &exception) {
+            exception.enclose(label);
+            throw;
+        } catch (const exceptions::RuntimeException &exception) {
+            throw exceptions::PropagatedException(label, exception.what());
+        } catch (...) {
+            throw exceptions::PropagatedException(label, "unknown runtime exception");
+        }
+    }
+    // place of an element as an assignment (or a read) finds it,
+    // the index is only evaluated for an array or an object
+    types::SharedValue* place(const types::SharedValue &target, const std::function<types::SharedValue()> &index, bool read);
+    // function of the prelude under this name
+    const types::BuiltinFunction::CppFunction& builtin(const std::string &name);
+    // what `run` does with a program lowered to these statements
+    void execute(void (*statements)());
+}
@@ -0,0 +1,83 @@
+/*
+ * Caches kept by compiled closures
+ * at the sites they were compiled from
+ */
+
+#pragma once
+#include <array>
+#include "types.h"
+#include "profiles.h"
+
+namespace interpreter::caches {
+    using types::SharedValue;
+    using types::Shape;
+    using types::UserObject;
+
+    // Inline cache of a property access with a constant key.
+    // Remembers the slot of the property in the shapes of the
+    // objects seen at the site: a single entry makes it monomorphic,
+    // several make it polymorphic. Objects with the same keys share
+    // a shape, so one entry serves all of them. A write adding the
+    // key remembers the shape the object moves to as well. A site
+    // that keeps evicting entries sees new shapes all the time: it
+    // turns megamorphic and stops caching, in later runs too when
+    // it has a profile
+    class PropertyCache final {
+        static constexpr size_t CAPACITY = 4;
+        static constexpr size_t MEGAMORPHIC = 64;
+        struct Entry {
+            // held, so that no other shape can be made at its address
+            std::shared_ptr<Shape> shape;
+            size_t slot;
+            // shape after a write adding the key, empty if it was there
+            std::shared_ptr<Shape> next;
+        };
+        std::array<Entry, CAPACITY> entries {};
+        size_t size = 0;
+        size_t nextEvicted = 0;
+        size_t evictions = 0;
+        profiles::Feedback* feedback = nullptr;
+    public:
+        PropertyCache() = default;
+        explicit PropertyCache(profiles::Feedback* feedback) : feedback(feedback) {
+            if (feedback && *feedback) evictions = MEGAMORPHIC;
+        }
+
+        [[nodiscard]] SharedValue* lookup(UserObject* object) const {
+            for (size_t i = 0; i < size; i++) {
+                const auto &entry = entries[i];
+                if (entry.shape != object->shape) continue;
+                if (entry.next) {
+                    object->shape = entry.next;
+                    object->slots.emplace_back();
+                }
+                return &object->slots[entry.slot];
+            }
+            return nullptr;
+        }
+
+        // shapes of their own are changed in place, they are never remembered
+        void remember(const std::shared_ptr<Shape> &shape, size_t slot, const std::shared_ptr<Shape> &next) {
+            if (evictions == MEGAMORPHIC || !shape->shared() || (next && !next->shared())) return;
+            Entry entry { shape, slot, next };
+            for (size_t i = 0; i < size; i++) {
+                if (entries[i].shape == shape) {
+                    entries[i] = std::move(entry);
+                    return;
+                }
+            }
+            if (size < CAPACITY) {
+                entries[size++] = std::move(entry);
+                return;
+            }
+            if (++evictions == MEGAMORPHIC) {
+                entries = {};
+                size = 0;
+                if (feedback) *feedback = 1;
+                return;
+            }
+            entries[nextEvicted] = std::move(entry);
+            nextEvicted = (nextEvicted + 1) % CAPACITY;
+        }
+    };
+}
@@ -0,0 +1,61 @@
+/*
+ * Load-time form of the AST used by the interpreter.
+ * Every node is turned into a pre-bound callable
+ * holding its already compiled children and
+ * already decoded operators, so that nothing
+ * has to be dispatched on during evaluation
+ */
+
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include "parser/ast.h"
+#include "types.h"
+#include "scope.h"
+#include "tiers.h"
+
+using interpreter::types::SharedValue;
+
+namespace interpreter {
+    class Interpreter;
+
+    using ExpressionClosure = std::function<SharedValue(Interpreter&)>;
+    using StatementClosure  = std::function<void(Interpreter&)>;
+
+    struct CompiledParameter {
+        enum class Kind {
+            Required,
+            WithDefault,
+            WrongFormat,
+            Duplicate,
+        };
+        Kind kind;
+        std::string name;
+        size_t slot = 0;
+        ExpressionClosure defaultValue = nullptr;
+    };
+
+    // Attached to the body node of every function.
+    // Holds the call signature, which is validated
+    // once, so that a call only has to bind arguments
+    struct CompiledFunction final : RuntimeData {
+        std::shared_ptr<ScopeLayout> layout;
+        CaptureLayout captures;
+        std::vector<CompiledParameter> parameters;
+        // position of the last parameter without a default plus one
+        size_t minimumArguments;
+        // the body yields: a call makes a generator instead of running it
+        bool generator;
+        // program the function was read in, when it is run as it is read
+        std::weak_ptr<const Node> tree;
+        StatementClosure body;
+        mutable tiers::Unit unit;
+    };
+
+    // attached to the program node
+    struct CompiledProgram final : RuntimeData {
+        std::vector<StatementClosure> statements;
+        mutable tiers::Unit unit;
+    };
+}
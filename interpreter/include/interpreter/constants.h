@@ -0,0 +1,79 @@
+/*
+ * Load time rules of `const` declarations. A program assigning
+ * a variable that may be a constant at that point is rejected
+ * before it runs, and reads certain to find a constant declared
+ * with a literal can be replaced by a copy of the literal.
+ * Names are followed the way the engines look them up: a scope
+ * that has declared the name by then holds it, a scope that only
+ * may declare it lets the scopes around be read meanwhile
+ */
+
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include "parser/ast.h"
+
+using namespace parser::AST;
+
+namespace interpreter {
+    class Constants final {
+        struct Declaration {
+            // index of the statement of the scope declaring it, -1 before all
+            long statement;
+            // declared by the statement itself, not by a conditional body
+            bool definite;
+            bool constant;
+            // value of a constant that can be propagated
+            const Expression* literal;
+        };
+        struct Frame {
+            std::map<std::string, std::vector<Declaration>> declarations;
+            // index of the statement being walked
+            long current = 0;
+        };
+        struct Lookup {
+            // a constant may be what the name finds
+            bool constant = false;
+            // the name surely finds this literal constant
+            const Expression* literal = nullptr;
+            // the name may be the one of the outermost frame
+            bool outermost = true;
+        };
+        std::vector<Frame> frames;
+        // names assigned in the outermost frame, by label of the first assignment
+        std::map<std::string, std::string> outermostAssignments;
+        const bool propagating;
+        bool propagated = false;
+        explicit Constants(bool propagating) : propagating(propagating) {}
+        static void collect(const StatementPtr &statement, long index, bool definite, Frame &frame);
+        static Frame frameOf(const std::vector<StatementPtr> &statements);
+        [[nodiscard]] Lookup lookup(const std::string &name) const;
+        void walkSequence(std::vector<StatementPtr> &statements);
+        void walkStatement(StatementPtr &statement);
+        void walkBody(StatementPtr &body);
+        void walkFunction(std::vector<ExpressionPtr> &parameters, StatementPtr &body);
+        void walkExpression(ExpressionPtr &expression);
+        void walkProgram(Program &program);
+    public:
+        // throws if the program assigns a constant
+        static void check(Program &program);
+        // whether any read was replaced by a literal
+        static bool propagate(Program &program);
+        class Stream;
+    };
+
+    // A program read a statement at a time, each one handed
+    // as a program of its own: its top-level declarations
+    // stay known to the statements checked after it, and a
+    // top-level constant is rejected once an earlier
+    // statement may have assigned the name
+    class Constants::Stream final {
+        Constants constants;
+        long checked;
+    public:
+        Stream();
+        // throws if the statements assign a constant
+        void check(Program &program);
+    };
+}
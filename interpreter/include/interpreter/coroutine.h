@@ -0,0 +1,81 @@
+/*
+ * Function running on a native stack of its own. It can suspend
+ * itself at any depth of nested calls and is resumed right where
+ * it stopped, so the tree interpreter can keep a generator call
+ * between its values without unwinding the closures executing it.
+ * The stack can also be larger than the one of the thread, which
+ * bounds how deep the closures of the tree interpreter may nest
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#if !defined(__x86_64__)
+#include <ucontext.h>
+#endif
+
+namespace interpreter {
+    class Coroutine final {
+        // released stacks kept for the next coroutines of their size
+        static constexpr size_t SPARE_STACKS = 16;
+        // thrown by suspend to unwind a body that is never resumed
+        struct Cancelled {};
+        // where a stack stopped: its saved stack pointer on x86-64,
+        // which switches with a few instructions of its own, a whole
+        // context elsewhere. Neither goes through longjmp, which
+        // fortified builds abort when it jumps between stacks
+#if defined(__x86_64__)
+        using Context = void*;
+#else
+        using Context = ucontext_t;
+#endif
+        // the one running on this thread, none on the stack of the thread
+        static thread_local Coroutine* current;
+        std::function<void(Coroutine&)> body;
+        void* stack;
+        size_t stackSize;
+        // the one that resumed the body, current again once it suspends
+        Coroutine* resumer;
+        Context context;
+        Context caller;
+        std::exception_ptr exception;
+        // kept for AddressSanitizer, which has to be told of each switch:
+        // the stack that resumed the body and the frames moved aside
+        const void* callerStack;
+        size_t callerStackSize;
+        void* callerFakeStack;
+        void* bodyFakeStack;
+        bool started;
+        bool finished;
+        bool cancelled;
+        static void entry(Coroutine* self);
+        // entry of makecontext, which passes int arguments only
+        static void entryParts(unsigned high, unsigned low);
+        static void transfer(Context &save, Context &load);
+        void prepare();
+        static void* allocateStack(size_t size);
+        static void releaseStack(void* stack, size_t size);
+        static std::uintptr_t threadStackLimit();
+        void switchIn();
+    public:
+        // pages of the stack are only taken when touched
+        Coroutine(std::function<void(Coroutine&)> body, size_t stackSize);
+        Coroutine(const Coroutine&) = delete;
+        Coroutine& operator=(const Coroutine&) = delete;
+        // a suspended body is unwound before the stack is released
+        ~Coroutine();
+        // runs the body until it suspends or returns,
+        // an exception leaving the body is thrown here
+        void resume();
+        // from the body: back to resume until the next one
+        void suspend();
+        [[nodiscard]] bool done() const;
+        // whether the caller runs on the stack of a coroutine
+        [[nodiscard]] static bool inside();
+        // whether less than `reserve` bytes are left on the stack
+        // the caller runs on, below them it would overflow
+        [[nodiscard]] static bool exhausted(size_t reserve);
+    };
+}
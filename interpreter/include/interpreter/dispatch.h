@@ -0,0 +1,37 @@
+/*
+ * Case tables of match statements. The literal cases are
+ * laid out once, when the statement is compiled: integers
+ * close to each other index a dense jump table, other numbers
+ * and strings are hashed, booleans and nil have a slot each.
+ * Looking the subject up costs the same however many cases
+ * there are. Values of different types never match, and
+ * neither does NaN (it is not equal even to itself)
+ */
+
+#pragma once
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include "types.h"
+
+namespace interpreter {
+    class DispatchTable final {
+        // a dense table may be at most this many times
+        // larger than the integer cases it holds
+        static constexpr long long DENSITY = 4;
+        static constexpr long long MAX_DENSE = 4096;
+        long long denseBase = 0;
+        std::vector<size_t> dense;
+        std::unordered_map<long double, size_t> numbers;
+        std::unordered_map<std::string, size_t> strings;
+        size_t trueArm, falseArm, nilArm;
+        // of a subject no case lists: the else clause or the end
+        const size_t otherwise;
+        void layOutNumbers(const std::vector<std::tuple<long double, size_t>> &cases);
+    public:
+        // arms are the cases in order, a subject found
+        // in none of them selects arm `cases.size()`
+        explicit DispatchTable(const MatchStatement::CaseList &cases);
+        [[nodiscard]] size_t lookup(const types::SharedValue &subject) const;
+    };
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #define WHAT_DECLARATION [[nodiscard]] const char* what() const noexcept override
 #define ENABLE_WHAT WHAT_DECLARATION { return message.c_str(); }
@@ -43,14 +44,40 @@ namespace interpreter::exceptions {
         ENABLE_WHAT
     };
 
-    class PropagatedException : public RuntimeException {
+    class ConstantAssignmentException : public RuntimeException {
         const std::string message;
     public:
-        PropagatedException(const std::string &label, const std::string &old)
-            : message("At " + label + ":\n" + old) {}
+        explicit ConstantAssignmentException(const std::string &name)
+            : message("Cannot assign to constant '" + name + "'") {}
         ENABLE_WHAT
     };
 
+    // Labels are kept innermost first and joined only once the text
+    // is asked for: an error leaving deep recursion passes through
+    // as many frames as it has labels, joining at each would be quadratic
+    class PropagatedException : public RuntimeException {
+        std::vector<std::string> labels;
+        const std::string reason;
+        mutable std::string message;
+    public:
+        PropagatedException(const std::string &label, const std::string &old)
+            : labels { label }, reason(old) {}
+        // from a frame enclosing the one that labeled the error last
+        void enclose(std::string label) {
+            labels.push_back(std::move(label));
+            message.clear();
+        }
+        WHAT_DECLARATION {
+            if (message.empty()) {
+                for (auto it = labels.rbegin(); it != labels.rend(); ++it) {
+                    message += "At " + *it + ":\n";
+                }
+                message += reason;
+            }
+            return message.c_str();
+        }
+    };
+
     class ErrorNodeException : public RuntimeException {
     public:
         WHAT_DECLARATION {
@@ -146,6 +173,21 @@ namespace interpreter::exceptions {
         ENABLE_WHAT
     };
 
+    class GeneratorRunningException : public RuntimeException {
+    public:
+        WHAT_DECLARATION {
+            return "Generator is resumed while it is running";
+        }
+    };
+
+    class NotIterableException : public RuntimeException {
+        const std::string message;
+    public:
+        explicit NotIterableException(const std::string& name)
+            : message("Expected array, object, string or generator to iterate over, found: " + name) {}
+        ENABLE_WHAT
+    };
+
     class ZeroStepException : public RuntimeException {
         WHAT_DECLARATION {
             return "For loop step cannot be zero";
@@ -180,6 +222,22 @@ namespace interpreter::exceptions {
         ENABLE_WHAT
     };
 
+    class CallDepthExceededException : public RuntimeException {
+        const std::string message;
+    public:
+        explicit CallDepthExceededException(size_t limit)
+            : message("Maximum call depth of " + std::to_string(limit) + " was exceeded") {}
+        ENABLE_WHAT
+    };
+
+    class StackExhaustedException : public RuntimeException {
+        const std::string message;
+    public:
+        explicit StackExhaustedException(size_t depth)
+            : message("Stack space ran out with " + std::to_string(depth) + " nested calls") {}
+        ENABLE_WHAT
+    };
+
     class FileImportFailedException : public RuntimeException {
         const std::string message;
     public:
@@ -0,0 +1,24 @@
+/*
+ * Which calls the tree interpreter compiles as the expression
+ * their function returns, instead of entering the function.
+ * A function qualifies when it is declared at the top level
+ * of a program, its body is a single `return` of an expression
+ * within the size budget, the expression creates no functions
+ * and assigns nothing, and the function does not call itself
+ */
+
+#pragma once
+#include "parser/ast.h"
+#include "options.h"
+
+using namespace parser::AST;
+
+namespace interpreter::inliner {
+    // expression returned by the function, if it can be inlined
+    const ExpressionPtr* inlinable(const FunctionDeclarationStatement* function, const Options &options);
+    // number of nodes of the expression
+    size_t size(const ExpressionPtr &expression);
+    // An argument is copied, as on a call, when the expression could
+    // keep the value itself or change it through another name
+    bool copiesArgument(const ExpressionPtr &expression, const std::string &parameter);
+}
@@ -1,62 +1,143 @@
 #pragma once
 #include "parser/ast.h"
 #include "scope.h"
+#include "closures.h"
+#include "caches.h"
+#include "resolver.h"
 #include <map>
 
 using namespace parser::AST;
 
 namespace interpreter {
     class Interpreter final {
+        // Every toy call nests native frames of the closures, so a
+        // program and each generator run on a stack of their own, far
+        // larger than the one of the thread, with room for the default
+        // limit of calls. Pages are only taken as deep as calls go
+        static constexpr size_t PROGRAM_STACK_SIZE = 1 << 30;
+        // left to a call for builtins and for unwinding,
+        // a call finding less raises an error instead
+        static constexpr size_t STACK_RESERVE = 64 << 10;
         enum class FlowFlag {
             SequentialFlow,
             BreakLoop,
             ContinueLoop,
             ReturnValue
         };
+        // call left in tail position by a returning function
+        struct TailCall {
+            SharedValue function;
+            std::vector<SharedValue> arguments;
+        };
         static std::string flowFlagToString(FlowFlag flag);
         const std::string filename;
+        const Options options;
+        const size_t maxCallDepth;
+        size_t callDepth;
         SharedScope scope;
+        // closures are entered from the top level scope
+        SharedScope globals;
         FlowFlag flowRegister;
         std::optional<SharedValue> returnRegister;
+        std::optional<TailCall> tailCallRegister;
+        // arguments of inlined calls, the innermost call reads them from the base
+        std::vector<SharedValue> inlinedArguments;
+        size_t inlinedBase;
+        // suspended call of a generator function
+        struct Generator;
+        // set in the engine running the body of a generator, yields go there
+        Generator* generator;
         std::optional<std::string> fatalError;
-        std::vector<ProgramPtr> importedASTs;
-        void enterScope();
+        // shared with the functions made by the modules,
+        // which keep them as long as they are left
+        std::vector<std::shared_ptr<Program>> importedASTs;
+        // engine of a generator: the body runs in the scope of the call
+        Interpreter(const types::FunctionalObject* function, SharedScope scope, const Options& options, Generator* generator);
+        void enterScope(const ScopeLayout* layout);
         void leaveScope();
+        SharedValue createClosure(const std::vector<ExpressionPtr> &parameters, const StatementPtr &body);
+        void executeLibraryImport(const ImportLibraryStatement* import, size_t slot);
+        SharedValue callFunction(types::FunctionalObject* function, std::vector<SharedValue> &arguments);
+        SharedValue invokeFunction(types::FunctionalObject* function, std::vector<SharedValue> &arguments);
+        static std::vector<SharedValue> evaluateArguments(Interpreter &self, const std::vector<ExpressionClosure> &arguments);
+        static SharedValue* getPlacePointer (
+            Interpreter &self,
+            const SharedValue &target,
+            const ExpressionClosure &index,
+            bool read
+        );
+        static SharedValue* getCachedPlacePointer (
+            Interpreter &self,
+            const SharedValue &target,
+            const ExpressionClosure &index,
+            const std::string &key,
+            caches::PropertyCache &cache,
+            bool read
+        );
+        // Load time: turning nodes into closures
+        static const CompiledProgram& compileProgram (
+            Program &program,
+            const std::string &filename,
+            const Options &options,
+            const std::weak_ptr<const Node> &tree = {}
+        );
+        void execute(Program &program, const std::weak_ptr<const Node> &tree);
+        static const CompiledFunction& compileFunction (
+            const Node* node,
+            const std::vector<ExpressionPtr> &parameters,
+            const StatementPtr &body,
+            Resolver &resolver
+        );
+        static const CompiledFunction& compiledFunction(const StatementPtr &body);
         // Statements:
-        void executeStatement(const StatementPtr &statement);
-        void executeLibraryImport(const ImportLibraryStatement* import);
-        void executeVariableDeclaration(const VariableDeclarationStatement* declaration);
-        void executeFunctionDeclaration(const FunctionDeclarationStatement* function);
-        void executeForLoop(const ForLoopStatement* forLoop);
-        void executeWhileLoop(const WhileLoopStatement* whileLoop);
-        void executeIfElse(const IfElseStatement* ifElse);
-        void executeContinue();
-        void executeBreak();
-        void executeReturn(const ReturnOperatorStatement* returnOp);
-        void executeBlock(const BlockStatement* block);
-        void executeEcho(const EchoStatement* echo);
-        void executeBareExpression(const ExpressionStatement* bare);
-        SharedValue* getPlacePointer(const IndexAccessExpression* indexExpression, bool read);
+        static StatementClosure compileStatement(const StatementPtr &statement, Resolver &resolver);
+        static StatementClosure compileLibraryImport(const ImportLibraryStatement* import, Resolver &resolver);
+        static StatementClosure compileVariableDeclaration(const VariableDeclarationStatement* declaration, Resolver &resolver);
+        static StatementClosure compileFunctionDeclaration(const FunctionDeclarationStatement* function, Resolver &resolver);
+        static StatementClosure compileForLoop(const ForLoopStatement* forLoop, Resolver &resolver);
+        static StatementClosure compileForInLoop(const ForInLoopStatement* forIn, Resolver &resolver);
+        static StatementClosure compileWhileLoop(const WhileLoopStatement* whileLoop, Resolver &resolver);
+        static StatementClosure compileIfElse(const IfElseStatement* ifElse, Resolver &resolver);
+        static StatementClosure compileMatch(const MatchStatement* match, Resolver &resolver);
+        static StatementClosure compileContinue(const ContinueOperatorStatement* continueOp);
+        static StatementClosure compileBreak(const BreakOperatorStatement* breakOp);
+        static StatementClosure compileReturn(const ReturnOperatorStatement* returnOp, Resolver &resolver);
+        static StatementClosure compileYield(const YieldStatement* yield, Resolver &resolver);
+        static StatementClosure compileBlock(const BlockStatement* block, Resolver &resolver);
+        static StatementClosure compileEcho(const EchoStatement* echo, Resolver &resolver);
+        static StatementClosure compileBareExpression(const ExpressionStatement* bare, Resolver &resolver);
         // Expressions:
-        SharedValue executeExpression(const ExpressionPtr &expression);
-        SharedValue executeBinaryOperationExpression(const BinaryOperationExpression* expression);
-        SharedValue executeRawAssignment(const ExpressionPtr &left, const ExpressionPtr &right);
-        SharedValue executePrefixOperationExpression(const PrefixOperationExpression* expression);
-        SharedValue executeCallExpression(const CallExpression* expression);
-        SharedValue executeIndexAccessExpression(const IndexAccessExpression* expression);
-        static SharedValue executeNumberLiteralExpression(const NumberLiteralExpression* expression);
-        static SharedValue executeBooleanLiteralExpression(const BooleanLiteralExpression* expression);
-        static SharedValue executeStringLiteralExpression(const StringLiteralExpression* expression);
-        SharedValue executeArrayLiteralExpression(const ArrayLiteralExpression* expression);
-        SharedValue executeVariableExpression(const VariableExpression* expression);
-        SharedValue executeLambdaExpression(const LambdaExpression* expression);
-        SharedValue executeObjectExpression(const ObjectExpression* objExpr);
+        static ExpressionClosure compileExpression(const ExpressionPtr &expression, Resolver &resolver);
+        static ExpressionClosure compileBinaryOperationExpression(const BinaryOperationExpression* expression, Resolver &resolver);
+        static ExpressionClosure compileRawAssignment(const BinaryOperationExpression* expression, Resolver &resolver);
+        static ExpressionClosure compilePrefixOperationExpression(const PrefixOperationExpression* expression, Resolver &resolver);
+        static ExpressionClosure compileCallExpression(const CallExpression* expression, Resolver &resolver);
+        static ExpressionClosure compileInlinedCall (
+            const CallExpression* expression,
+            const FunctionDeclarationStatement* function,
+            Resolver &resolver
+        );
+        static StatementClosure compileTailCall(const CallExpression* expression, Resolver &resolver);
+        static ExpressionClosure compileIndexAccessExpression(const IndexAccessExpression* expression, Resolver &resolver);
+        static ExpressionClosure compileNumberLiteralExpression(const NumberLiteralExpression* expression);
+        static ExpressionClosure compileBooleanLiteralExpression(const BooleanLiteralExpression* expression);
+        static ExpressionClosure compileStringLiteralExpression(const StringLiteralExpression* expression);
+        static ExpressionClosure compileNilLiteralExpression(const NilLiteralExpression* expression);
+        static ExpressionClosure compileArrayLiteralExpression(const ArrayLiteralExpression* expression, Resolver &resolver);
+        static ExpressionClosure compileVariableExpression(const VariableExpression* expression, Resolver &resolver);
+        static ExpressionClosure compileLambdaExpression(const LambdaExpression* expression, Resolver &resolver);
+        static ExpressionClosure compileObjectExpression(const ObjectExpression* objExpr, Resolver &resolver);
+        static ExpressionClosure compileInterpolationExpression(const InterpolationExpression* expression, Resolver &resolver);
     public:
-        explicit Interpreter(std::string filename, const Storage& initialStorage = {});
+        explicit Interpreter(std::string filename, const Storage& initialStorage = {}, const Options& options = {});
         void executeProgram(Program &program);
+        // one more piece of a program run as it is read, usually a single
+        // statement. Declarations stay for the next ones, the tree is kept
+        // only as long as functions made from it are
+        void executeStreamed(const std::shared_ptr<Program> &program);
         [[nodiscard]] bool didFailed() const;
         [[nodiscard]] const std::optional<std::string>& getFatalError() const;
-        [[nodiscard]] std::vector<ProgramPtr>& getImportedASTs();
+        [[nodiscard]] std::vector<std::shared_ptr<Program>>& getImportedASTs();
         [[nodiscard]] const SharedScope& getScope() const;
     };
 }
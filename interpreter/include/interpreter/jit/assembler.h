@@ -0,0 +1,79 @@
+/*
+ * Minimal x86-64 assembler for the template JIT.
+ * Toy numbers are long doubles, which on x86-64 are
+ * the 80-bit extended type of the x87 unit, so the
+ * generated code computes on the x87 register stack.
+ * Operands live in a frame of 16-byte slots which
+ * the generated function receives in rdi
+ */
+
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <vector>
+
+namespace interpreter::jit {
+    #if defined(__x86_64__) && defined(__linux__)
+    constexpr bool PLATFORM_SUPPORTED = true;
+    #else
+    constexpr bool PLATFORM_SUPPORTED = false;
+    #endif
+
+    // condition codes of jcc, as set by fucomip
+    enum class Condition : unsigned char {
+        Below        = 0x82,
+        AboveOrEqual = 0x83,
+        Equal        = 0x84,
+        NotEqual     = 0x85,
+        BelowOrEqual = 0x86,
+        Above        = 0x87,
+        Parity       = 0x8A,
+    };
+
+    class Assembler final {
+    public:
+        using Label = size_t;
+    private:
+        std::vector<unsigned char> code;
+        std::vector<std::optional<size_t>> labels;
+        // positions of rel32 operands and the labels they refer to
+        std::vector<std::pair<size_t, Label>> jumps;
+        void emit(std::initializer_list<unsigned char> bytes);
+        void emitInt32(int32_t value);
+        void emitSlot(unsigned char modrm, size_t slot);
+    public:
+        Label newLabel();
+        void bind(Label label);
+        // x87 stack
+        void load(size_t slot);       // fld tbyte [rdi + slot]
+        void storeAndPop(size_t slot); // fstp tbyte [rdi + slot]
+        void addAndPop();             // st1 = st1 + st0, pop
+        void subtractAndPop();        // st1 = st1 - st0, pop
+        void multiplyAndPop();        // st1 = st1 * st0, pop
+        void divideAndPop();          // st1 = st1 / st0, pop
+        void negate();                // st0 = -st0
+        void compareAndPopBoth();     // compares st0 with st1, pops both
+        // byte flags kept in slots
+        void compareFlag(size_t slot, unsigned char value);
+        void storeFlag(size_t slot, unsigned char value);
+        // control flow
+        void jump(Label label);
+        void jumpIf(Condition condition, Label label);
+        void ret();
+        [[nodiscard]] std::vector<unsigned char> finish();
+    };
+
+    // Finished machine code in memory mapped as executable
+    class ExecutableCode final {
+        void* memory;
+        size_t size;
+    public:
+        using Entry = void (*)(long double* frame);
+        explicit ExecutableCode(const std::vector<unsigned char> &code);
+        ExecutableCode(const ExecutableCode&) = delete;
+        ExecutableCode& operator=(const ExecutableCode&) = delete;
+        ~ExecutableCode();
+        [[nodiscard]] Entry entry() const;
+    };
+}
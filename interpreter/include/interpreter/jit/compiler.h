@@ -0,0 +1,101 @@
+/*
+ * Template JIT for loops that only compute on numbers.
+ * A `for` or `while` loop whose body consists of numeric
+ * assignments, conditionals, nested while loops, break
+ * and continue is translated into native code at load time.
+ * On entry type guards check that every variable the loop
+ * touches holds a number; when one does not, the loop is
+ * interpreted as usual
+ */
+
+#pragma once
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "assembler.h"
+#include "interpreter/resolver.h"
+
+namespace interpreter::jit {
+    using types::AnyValue;
+
+    struct Statistics {
+        size_t compiled = 0;
+        size_t rejected = 0;
+        size_t entered = 0;
+        size_t bailedOut = 0;
+    };
+
+    Statistics& statistics();
+
+    // Variable the region reads or writes, addressed
+    // from the scope the region is entered in.
+    // Takes three slots: current value, value of
+    // the original object and whether it was replaced
+    struct RegionVariable {
+        std::string name;
+        VariableAddress address;
+        size_t slot;
+        bool assigned;
+    };
+
+    class Region final {
+        friend class Compiler;
+        // for loops only
+        static constexpr size_t COUNTER_SLOT = 0;
+        static constexpr size_t END_SLOT = 1;
+        static constexpr size_t STEP_SLOT = 2;
+        static constexpr size_t POSITIVE_SLOT = 3;
+        static constexpr size_t FIXED_SLOTS = 4;
+        std::vector<RegionVariable> variables;
+        // constants are already in place
+        std::vector<long double> initialFrame;
+        std::unique_ptr<ExecutableCode> code;
+        bool execute(const SharedScope &scope, std::vector<long double> &frame, const std::vector<const AnyValue*> &loopObjects);
+    public:
+        // false when a guard failed and nothing was executed
+        bool runWhile(const SharedScope &scope);
+        bool runFor(const SharedScope &scope, const SharedValue &start, const SharedValue &end, const SharedValue &step);
+    };
+
+    class Compiler final {
+        using VariableKey = std::tuple<size_t, size_t, std::string>;
+        struct LoopLabels {
+            Assembler::Label continueTarget;
+            Assembler::Label breakTarget;
+        };
+        Resolver &resolver;
+        Region &region;
+        Assembler assembler;
+        std::map<VariableKey, size_t> variableIndices;
+        std::vector<LoopLabels> loops;
+        std::string counterName;
+        // scopes between the resolver and the scope the region
+        // is entered in: blocks of the body and the scope of a for loop
+        size_t scopeDepth;
+        size_t stackDepth;
+        Compiler(Resolver &resolver, Region &region);
+        // statements
+        void compileStatement(const StatementPtr &statement);
+        void compileAssignment(const BinaryOperationExpression* assignment);
+        void compileIfElse(const IfElseStatement* ifElse);
+        void compileWhileLoop(const WhileLoopStatement* whileLoop);
+        void compileBlock(const BlockStatement* block);
+        // expressions
+        void compileNumber(const ExpressionPtr &expression);
+        void compileBranch(const ExpressionPtr &condition, bool jumpWhen, Assembler::Label target);
+        void compileComparison(const BinaryOperationExpression* comparison, bool jumpWhen, Assembler::Label target);
+        // helpers
+        size_t variableSlot(const std::string &name, bool assigned);
+        size_t constantSlot(long double value);
+        void push();
+        void pop(size_t amount = 1);
+        void finish();
+        void leaveScopes();
+    public:
+        // resolver is in the scope enclosing the loop
+        static std::shared_ptr<Region> compileWhileLoop(const WhileLoopStatement* whileLoop, Resolver &resolver);
+        static std::shared_ptr<Region> compileForLoop(const ForLoopStatement* forLoop, Resolver &resolver);
+    };
+}
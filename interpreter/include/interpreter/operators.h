@@ -0,0 +1,101 @@
+/*
+ * Dispatch of binary and prefix operations.
+ * Handlers are looked up in tables generated at
+ * compile time, keyed by the operator and the data
+ * types of the operands. Hot combinations (mostly
+ * numbers) get specialized handlers, others fall
+ * back to the virtual operators of AnyValue, which
+ * raise exceptions for unsupported types
+ */
+
+#pragma once
+#include <array>
+#include <string>
+#include "parser/ast.h"
+#include "types.h"
+#include "profiles.h"
+
+namespace interpreter::operators {
+    using types::SharedValue;
+    using types::AnyValue;
+    using parser::AST::Operator;
+
+    using BinaryHandler = SharedValue (*)(const SharedValue &left, const SharedValue &right);
+    using PrefixHandler = SharedValue (*)(const SharedValue &value);
+
+    constexpr size_t DATA_TYPES = static_cast<size_t>(AnyValue::DataType::IteratorType) + 1;
+    constexpr size_t OPERATORS  = static_cast<size_t>(Operator::Unknown) + 1;
+
+    using BinaryRow = std::array<std::array<BinaryHandler, DATA_TYPES>, DATA_TYPES>;
+    using PrefixRow = std::array<PrefixHandler, DATA_TYPES>;
+
+    // handlers of a single operator, operator has to be
+    // a binary operation or a compound assignment
+    const BinaryRow& binaryRow(Operator op);
+    // operator has to be Not or Negate
+    const PrefixRow& prefixRow(Operator op);
+
+    inline SharedValue binary(const BinaryRow &row, const SharedValue &left, const SharedValue &right) {
+        const auto leftType = static_cast<size_t>(left->dataType());
+        const auto rightType = static_cast<size_t>(right->dataType());
+        return row[leftType][rightType](left, right);
+    }
+
+    inline SharedValue prefix(const PrefixRow &row, const SharedValue &value) {
+        return row[static_cast<size_t>(value->dataType())](value);
+    }
+
+    // operations with a right operand of a known type, unboxed
+    using NumberKernel = SharedValue (*)(const SharedValue &left, long double right);
+    using StringKernel = SharedValue (*)(const SharedValue &left, const std::string &right);
+
+    // Binary operation site that specializes itself on the operand
+    // types it observes. The first evaluation picks the kernel for
+    // two numbers or two strings, later ones only check the tags.
+    // A site seeing other types turns generic and uses the table.
+    // With a profile the site starts in the state it reached before
+    class QuickenedBinary final {
+        enum class State : unsigned char {
+            Unobserved,
+            Numbers,
+            Strings,
+            Generic,
+        };
+        const BinaryRow *row;
+        NumberKernel numbers;
+        StringKernel strings;
+        State state;
+        profiles::Feedback* feedback;
+        SharedValue observe(const SharedValue &left, const SharedValue &right);
+    public:
+        explicit QuickenedBinary(Operator op, profiles::Feedback* feedback = nullptr);
+        SharedValue operator()(const SharedValue &left, const SharedValue &right);
+        // the right operand is a number literal,
+        // it is only boxed when the left one is not a number
+        SharedValue withNumber(const SharedValue &left, long double right) const;
+    };
+
+    inline SharedValue QuickenedBinary::operator()(const SharedValue &left, const SharedValue &right) {
+        using enum AnyValue::DataType;
+        switch (state) {
+            case State::Numbers:
+                if (left->dataType() == NumberType && right->dataType() == NumberType) {
+                    // the same object on both sides is equal to itself even if NaN
+                    constexpr auto number = static_cast<size_t>(NumberType);
+                    if (left == right) return (*row)[number][number](left, right);
+                    return numbers(left, static_cast<types::NumberValue*>(right.get())->value);
+                }
+                break;
+            case State::Strings:
+                if (left->dataType() == StringType && right->dataType() == StringType) {
+                    return strings(left, static_cast<types::StringValue*>(right.get())->value);
+                }
+                break;
+            case State::Generic:
+                return binary(*row, left, right);
+            case State::Unobserved:
+                break;
+        }
+        return observe(left, right);
+    }
+}
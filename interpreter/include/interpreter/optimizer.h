@@ -0,0 +1,37 @@
+/*
+ * Rewrites a parsed program before an engine compiles it.
+ * Operations on literals are folded into a single literal,
+ * literal parts of string interpolations are joined,
+ * conditionals with a literal condition keep only the taken
+ * branch, and statements following return, break or continue
+ * are removed, reads of constants declared with a literal
+ * become the literal. Folding evaluates operators with the same
+ * handlers the engines use, operations that would fail
+ * are left in place to fail at runtime
+ */
+
+#pragma once
+#include "parser/ast.h"
+
+using namespace parser::AST;
+
+namespace interpreter {
+    class Optimizer final {
+        // statements are replaced in place; a removed
+        // statement leaves an empty pointer behind
+        static void optimizeStatement(StatementPtr &statement);
+        static void optimizeBody(StatementPtr &body);
+        static void optimizeSequence(std::vector<StatementPtr> &statements);
+        static void optimizeIfElse(StatementPtr &statement);
+        static void optimizeExpression(ExpressionPtr &expression);
+        static void optimizeFunction(std::vector<ExpressionPtr> &parameters, StatementPtr &body);
+        // literal replacing the expression, if it can be computed
+        static ExpressionPtr foldBinary(const BinaryOperationExpression* expression);
+        static ExpressionPtr foldPrefix(const PrefixOperationExpression* expression);
+        static ExpressionPtr foldInterpolation(InterpolationExpression* expression);
+        // whether the statements after this one are never reached
+        static bool interrupts(const StatementPtr &statement);
+    public:
+        static void optimize(Program &program);
+    };
+}
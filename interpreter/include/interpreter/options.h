@@ -0,0 +1,34 @@
+/*
+ * Settings of the execution engines
+ * that can be chosen from the command line
+ */
+
+#pragma once
+#include <cstddef>
+#include <optional>
+
+namespace interpreter {
+    struct Options {
+        // `return f(...)` inside a function reuses the frame
+        // of the caller. Replaced frames are missing from traces
+        bool tailCalls = true;
+        static constexpr size_t DEFAULT_MAX_CALL_DEPTH = 200000;
+        // deepest nesting of calls to toy functions, DEFAULT_MAX_CALL_DEPTH
+        // in both engines unless set. The tree interpreter may run out
+        // of native stack before, when its calls nest large expressions
+        std::optional<size_t> maxCallDepth;
+        // loops computing only on numbers are
+        // translated into native code at load time
+        bool jit = false;
+        // 0 runs the program as parsed, 1 folds constants
+        // and removes unreachable code before compiling it
+        unsigned optimizationLevel = 1;
+        // largest returned expression, counted in nodes, of a function
+        // whose calls the tree interpreter inlines at level 1. 0 disables it
+        size_t inlineBudget = 16;
+        // calls and loop iterations after which the tree interpreter
+        // compiles inlined calls and native loops of a function or
+        // a program. 0 compiles them before running
+        size_t tierThreshold = 1000;
+    };
+}
@@ -4,4 +4,6 @@
 
 namespace interpreter::prelude {
     const std::map<std::string, types::SharedValue>& getPrelude();
+    // declared as constants before the program starts
+    const std::map<std::string, long double>& getConstants();
 }
\ No newline at end of file
@@ -0,0 +1,56 @@
+/*
+ * Type feedback kept between runs. Sites of the tree interpreter
+ * that specialize on what they observe (binary operations, property
+ * caches and tiered units) leave their state in a profile, and
+ * the same sites of a later run start from it. Sites are keyed by
+ * the position of their node and a detail telling apart nested
+ * nodes starting at the same place. The feedback of a file is
+ * dropped once the file changes
+ */
+
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <tuple>
+#include "parser/ast.h"
+
+namespace interpreter::profiles {
+    using parser::AST::Node;
+    using parser::AST::Position;
+
+    // state a site leaves, 0 when it observed nothing
+    using Feedback = unsigned char;
+
+    enum class SiteKind : char {
+        Operation = 'o',
+        PropertyRead = 'r',
+        PropertyWrite = 'w',
+        Unit = 'u',
+    };
+
+    // feedback of the sites of one source file
+    struct Source {
+        using Key = std::tuple<char, Position, Position>;
+        // of the contents the feedback was observed on
+        std::uint64_t hash = 0;
+        std::map<Key, Feedback> sites;
+        // slot of the site, it stays valid for the whole run
+        Feedback* site(SiteKind kind, const Node* node, Position detail);
+    };
+
+    // detail of a binary operation: where its right operand starts
+    Position detail(const parser::AST::BinaryOperationExpression* operation);
+    // detail of an index access: links of a chain like a.b.c all
+    // start at `a`, they differ in how many links precede them
+    Position detail(const parser::AST::IndexAccessExpression* access);
+
+    // from now on the engines hand feedback slots to their sites
+    void enable();
+    // nullptr when profiles are off or the file cannot be read;
+    // a file is read and hashed the first time it is asked for
+    Source* source(const std::string &filename);
+    // false if the file cannot be read or is not a profile
+    bool load(const std::string &path);
+    bool save(const std::string &path);
+}
@@ -0,0 +1,104 @@
+/*
+ * Resolver mirrors the chain of runtime scopes
+ * during compilation and gives every variable
+ * a lexical address (depth and slot), so that
+ * at runtime no names have to be looked up
+ */
+
+#pragma once
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "parser/ast.h"
+#include "scope.h"
+#include "options.h"
+#include "tiers.h"
+#include "profiles.h"
+
+using namespace parser::AST;
+
+namespace interpreter {
+    class Resolver final {
+        // Function being compiled. Its scopes start at the frame
+        // of parameters, whose runtime parent is the global scope:
+        // variables of the frames below are captured
+        struct FunctionFrame {
+            size_t firstFrame;
+            CaptureLayout* captures;
+            // capture index by the frame and slot of the variable
+            std::map<std::pair<size_t, size_t>, size_t> indices;
+            tiers::Unit* unit;
+        };
+        // the first frame is the global scope: it has no layout,
+        // its variables are addressed by global symbol ids
+        std::vector<std::shared_ptr<ScopeLayout>> frames;
+        std::vector<FunctionFrame> functions;
+        tiers::Unit* program;
+        // feedback of the file being compiled, if profiles are on
+        profiles::Source* profile;
+        // program being compiled when it is run as it is read,
+        // the functions made from it keep it alive
+        std::weak_ptr<const Node> tree;
+        // functions of the program that calls may be inlined to, by name.
+        // Shared with copies kept by sites compiled again once hot
+        std::shared_ptr<std::map<std::string, const FunctionDeclarationStatement*>> inlinable;
+        // functions whose returned expressions are being compiled
+        // in place of calls, the innermost last. Names inside them
+        // are arguments of the innermost one or globals
+        std::vector<const FunctionDeclarationStatement*> inlined;
+        const Options options;
+        static void collectDeclarations(const StatementPtr &statement, ScopeLayout &layout);
+        size_t capture(size_t level, const std::string &name, size_t frame, size_t slot);
+    public:
+        explicit Resolver (
+            Options options = {},
+            tiers::Unit* program = nullptr,
+            profiles::Source* profile = nullptr,
+            std::weak_ptr<const Node> tree = {}
+        );
+        // layouts of the scopes created at runtime
+        static std::shared_ptr<ScopeLayout> blockLayout(const std::vector<StatementPtr> &statements);
+        static std::shared_ptr<ScopeLayout> forLoopLayout(const ForLoopStatement* forLoop);
+        static std::shared_ptr<ScopeLayout> forInLoopLayout(const ForInLoopStatement* forIn);
+        static std::shared_ptr<ScopeLayout> parametersLayout (
+            const std::vector<std::string> &parameters,
+            const StatementPtr &body
+        );
+        // whether the statement adds names to the scope it runs in
+        static bool declares(const StatementPtr &statement);
+        // whether a yield runs as part of the statement, which makes
+        // the function around a generator. Nested functions do not count
+        static bool yields(const StatementPtr &statement);
+        // whether the name occurs anywhere inside, as a variable or
+        // a declaration, including nested functions. Shadowing is ignored
+        static bool mentions(const StatementPtr &statement, const std::string &name);
+        static bool mentions(const ExpressionPtr &expression, const std::string &name);
+        void enterScope(std::shared_ptr<ScopeLayout> layout);
+        void leaveScope();
+        // the scope of parameters opens the body of a function,
+        // variables it uses from around are added to captures
+        void enterFunction(std::shared_ptr<ScopeLayout> layout, CaptureLayout &captures, tiers::Unit &unit);
+        void leaveFunction();
+        [[nodiscard]] bool insideFunction() const;
+        // function body or program being compiled
+        [[nodiscard]] tiers::Unit* unit() const;
+        [[nodiscard]] const Options& getOptions() const;
+        [[nodiscard]] const std::weak_ptr<const Node>& getTree() const;
+        // slot of a site in the profile, nullptr without one
+        [[nodiscard]] profiles::Feedback* feedback(profiles::SiteKind kind, const Node* node, Position detail) const;
+        [[nodiscard]] VariableAddress resolve(const std::string &name);
+        // functions declared once at the top level of the program
+        // are the ones calls can be statically resolved to
+        void collectInlinable(const std::vector<StatementPtr> &statements);
+        // function a call of the target is inlined to, if any
+        [[nodiscard]] const FunctionDeclarationStatement* inlineTarget(const ExpressionPtr &target) const;
+        void enterInlined(const FunctionDeclarationStatement* function);
+        void leaveInlined();
+        [[nodiscard]] bool insideInlined() const;
+        // position of the argument the name stands for inside an inlined function
+        [[nodiscard]] std::optional<size_t> inlinedArgument(const std::string &name) const;
+        // slot of the variable declared in the innermost scope
+        [[nodiscard]] size_t declare(const std::string &name) const;
+    };
+}
@@ -2,25 +2,96 @@
 #include <optional>
 #include <map>
 #include <memory>
+#include <vector>
 #include "types.h"
 
 using interpreter::types::SharedValue;
 
 namespace interpreter {
+    // Names of the variables a scope holds,
+    // in the order of their slots
+    struct ScopeLayout {
+        std::vector<std::string> names;
+        // slots used by closures, they are kept in cells
+        std::vector<size_t> captured;
+        [[nodiscard]] std::optional<size_t> slotOf(const std::string &name) const;
+        size_t add(const std::string &name);
+        void capture(size_t slot);
+    };
+
+    // Position of a variable computed by the resolver:
+    // amount of scopes to go up and the slot there.
+    // A captured variable is found in the scope of
+    // parameters of a closure, slot is its capture index
+    struct VariableAddress {
+        size_t depth;
+        size_t slot;
+        bool captured = false;
+    };
+
+    // Variables a function uses from the scopes around
+    // its definition. Sources are addresses of their cells,
+    // relative to the scope the function is created in.
+    // A name is listed once per scope declaring it, innermost
+    // first: while one is not initialized the next one is used
+    struct CaptureLayout {
+        std::vector<std::string> names;
+        std::vector<VariableAddress> sources;
+        size_t add(const std::string &name, const VariableAddress &source);
+    };
+
+    // variable shared by the scope declaring it and closures
+    using SharedCell = std::shared_ptr<SharedValue>;
+
+    // cells a closure holds instead of its defining scope
+    struct Captures {
+        // not owned: layouts live as long as the compiled AST
+        const CaptureLayout* layout;
+        std::vector<SharedCell> cells;
+    };
+
     class LexicalScope final {
         using SharedScope = std::shared_ptr<LexicalScope>;
         std::optional<SharedScope> parent;
+        // variables laid out by the resolver. In the
+        // global scope slots are global symbol ids
+        std::vector<SharedValue> slots;
+        // cells of captured slots, empty when nothing is captured
+        std::vector<SharedCell> cells;
+        // variables of the closure whose parameters the scope holds
+        std::shared_ptr<const Captures> captures;
+        // not owned: layouts live as long as the compiled AST
+        const ScopeLayout* layout;
+        // variables the resolver knows nothing about
         std::map<std::string, SharedValue> storage;
-        LexicalScope() : parent(std::nullopt) {}
+        LexicalScope() : parent(std::nullopt), layout(nullptr) {}
+        SharedValue* findLocal(const std::string &name);
+        SharedValue* findCaptured(const std::string &name, size_t from);
+        SharedValue& place(size_t slot);
+        LexicalScope* ancestor(size_t depth);
     public:
         static SharedScope create();
-        static SharedScope createInner(SharedScope &parent);
+        static SharedScope createInner (
+            SharedScope &parent,
+            const ScopeLayout* layout = nullptr,
+            std::shared_ptr<const Captures> captures = nullptr
+        );
+        static size_t globalSymbol(const std::string &name);
+        // dynamic access by name
         void initVariable(const std::string &name, std::optional<SharedValue> value = std::nullopt);
         [[nodiscard]] SharedValue getValue(const std::string &name);
         void setValue(const std::string &name, SharedValue &value);
+        // access by the address computed by the resolver,
+        // name is used for error messages and as a fallback
+        // when the variable has not been declared yet
+        void initSlot(size_t slot, const std::string &name, SharedValue value);
+        [[nodiscard]] SharedValue getValue(const VariableAddress &address, const std::string &name);
+        void setValue(const VariableAddress &address, const std::string &name, SharedValue &value);
+        // cell of a captured slot or of a variable captured by the closure
+        [[nodiscard]] SharedCell getCell(const VariableAddress &address);
         [[nodiscard]] std::optional<SharedScope> getParent();
     };
 
     using SharedScope = std::shared_ptr<LexicalScope>;
     using Storage = std::map<std::string, SharedValue>;
-}
\ No newline at end of file
+}
@@ -0,0 +1,53 @@
+/*
+ * Tiered execution of the tree interpreter. A function body
+ * or a program starts in the baseline tier: its calls are made
+ * as written and its loops are interpreted. Calls of a function
+ * and iterations of loops inside it are counted, and once the
+ * count reaches the threshold the code is promoted. Its sites
+ * that have a faster form, inlined calls and native loops,
+ * compile it the next time they run. A unit promoted in the run
+ * a profile was saved from starts promoted
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include "profiles.h"
+
+namespace interpreter::tiers {
+    // record of a unit leaving the baseline tier
+    struct Promotion {
+        std::string unit;
+        std::string reason;
+        size_t calls;
+        size_t iterations;
+        // since the process started
+        double milliseconds;
+    };
+
+    std::vector<Promotion>& promotions();
+
+    // Code promoted as a whole: a function body or a program
+    class Unit final {
+        std::string label;
+        size_t threshold = 0;
+        size_t calls = 0;
+        size_t iterations = 0;
+        bool hot = true;
+        profiles::Feedback* feedback = nullptr;
+        void promote(std::string reason);
+    public:
+        // with a threshold of 0 the unit starts promoted
+        void start(std::string unitLabel, size_t unitThreshold, profiles::Feedback* unitFeedback = nullptr);
+        [[nodiscard]] bool promoted() const { return hot; }
+        void call() {
+            if (!hot && ++calls + iterations >= threshold) promote("calls");
+        }
+        void iterate() {
+            if (!hot && calls + ++iterations >= threshold) promote("loop iterations");
+        }
+        // a loop about to run that many times promotes right away,
+        // so that it can be entered in the faster form
+        void expect(long double loopIterations);
+    };
+}
@@ -7,11 +7,16 @@
  * - String            by value
  * - Array             by reference
  * - Function          by reference
+ * - Generator         by reference
  */
 
 #pragma once
+#include <deque>
+#include <functional>
 #include <string>
 #include <memory>
+#include <optional>
+#include <span>
 #include <utility>
 #include <vector>
 #include "parser/ast.h"
@@ -19,7 +24,7 @@
 #include <map>
 #include "except.h"
 // forward declaration to avoid cycles
-namespace interpreter { class LexicalScope; }
+namespace interpreter { class LexicalScope; struct Captures; }
 
 #define TYPENAME(NAME)  [[nodiscard]] std::string getTypename() const override { return NAME; }
 #define DECL_STRING     [[nodiscard]] std::string toString()    const override
@@ -31,6 +36,7 @@ namespace interpreter::types {
 
     struct AnyValue {
         using SharedValue = std::shared_ptr<AnyValue>;
+        // tables of operators are sized by the last one
         enum class DataType {
             NilType,
             BooleanType,
@@ -40,6 +46,8 @@ namespace interpreter::types {
             FunctionType,
             ObjectType,
             BuiltinType,
+            GeneratorType,
+            IteratorType,
         };
         [[nodiscard]] virtual DataType    dataType()    const = 0;
         [[nodiscard]] virtual std::string getTypename() const = 0;
@@ -80,6 +88,9 @@ namespace interpreter::types {
     }
 
     SharedValue copyForAssignment(const SharedValue &value);
+    // string of the texts of the values one after another,
+    // its buffer is sized once before anything is copied
+    SharedValue concatenate(std::span<const SharedValue> values);
 
     struct NilValue final : AnyValue {
         DATA_TYPE(NilType)
@@ -137,11 +148,32 @@ namespace interpreter::types {
         OVERRIDE_ASSIGN(+=) OVERRIDE_ASSIGN(*=)
     };
 
+    // An array made by range() keeps its numbers uncounted until they
+    // are read, so looping over one takes the same memory whatever its
+    // length. They are counted as adding the step one time after another
+    // does, and become values of the array once it is indexed or changed
     struct ArrayObject final : AnyValue {
+        struct Numbers {
+            long double first;
+            long double step;
+            size_t length;
+        };
+        // elements are in `value` unless these are set
         std::vector<SharedValue> value;
+        std::optional<Numbers> numbers;
         // I'm moving here -- watch out
         // not to use the argument after the constructor
         explicit ArrayObject(std::vector<SharedValue> &value) : value(std::move(value)) {}
+        explicit ArrayObject(Numbers numbers) : numbers(numbers) {}
+        // numbers from start up to end, excluded; nil if
+        // the step is zero or leads away from the end
+        static SharedValue range(long double start, long double end, long double step);
+        [[nodiscard]] size_t size() const;
+        // elements read in order from the first: the number of a range
+        // is counted on from the one before, kept in `counter`
+        [[nodiscard]] SharedValue walk(size_t index, long double &counter) const;
+        // elements to index or change, numbers of a range become values
+        std::vector<SharedValue>& elements();
 
         DATA_TYPE(ArrayType)
         TYPENAME("array")
@@ -158,13 +190,22 @@ namespace interpreter::types {
         const std::string filename;
         const std::vector<ExpressionPtr> &parameters;
         const StatementPtr &body;
+        // the tree interpreter keeps the global scope and the captured
+        // variables only, the virtual machine keeps the defining scope
         std::shared_ptr<LexicalScope> scope;
+        std::shared_ptr<const Captures> captures;
+        // the program holding the body when a program is run as it
+        // is read: it is freed once no function made from it is left
+        std::shared_ptr<const Node> tree;
         FunctionalObject (
             std::string filename,
             const std::vector<ExpressionPtr> &parameters,
             const StatementPtr &body,
-            std::shared_ptr<LexicalScope> &scope
-        ) : filename(std::move(filename)), parameters(parameters), body(body), scope(scope) {}
+            std::shared_ptr<LexicalScope> &scope,
+            std::shared_ptr<const Captures> captures = nullptr,
+            std::shared_ptr<const Node> tree = nullptr
+        ) : filename(std::move(filename)), parameters(parameters), body(body),
+            scope(scope), captures(std::move(captures)), tree(std::move(tree)) {}
 
         DATA_TYPE(FunctionType)
         TYPENAME("function")
@@ -173,10 +214,41 @@ namespace interpreter::types {
         OVERRIDE_BIN_OP(==) OVERRIDE_BIN_OP(!=)
     };
 
+    // Key set of objects, telling the slot each key keeps its value in.
+    // Objects given the same keys share a shape, reached by adding the
+    // keys one at a time from the empty shape, so that inline caches
+    // can tell the layout of an object without looking at its keys.
+    // An object with more keys than SHARED_KEYS is used as a dictionary:
+    // it gets a shape of its own, which gains its keys in place
+    struct Shape final : std::enable_shared_from_this<Shape> {
+        static constexpr size_t SHARED_KEYS = 32;
+        // keys in order, and their slots in the order they were added
+        std::map<std::string, size_t> slots;
+        explicit Shape(bool shared = true) : isShared(shared) {}
+        ~Shape();
+        [[nodiscard]] bool shared() const { return isShared; }
+        static const std::shared_ptr<Shape>& empty();
+        // shape with the key added, in the slot after the others
+        std::shared_ptr<Shape> with(const std::string &key);
+    private:
+        // shapes made by adding a key to this one, while objects use them
+        std::map<std::string, std::weak_ptr<Shape>> transitions;
+        std::shared_ptr<Shape> parent;
+        std::string key;
+        const bool isShared;
+    };
+
     struct UserObject final : AnyValue {
-        std::map<std::string, SharedValue> value;
-        explicit UserObject(std::map<std::string, SharedValue> value = {})
-            : value(std::move(value)) {}
+        std::shared_ptr<Shape> shape;
+        // places stay where they are as keys are added
+        std::deque<SharedValue> slots;
+        explicit UserObject(std::map<std::string, SharedValue> value = {});
+        [[nodiscard]] SharedValue* findPlace(const std::string &key);
+        // a key that is not there yet changes the shape of the object
+        SharedValue& getPlace(const std::string &key);
+        // keys in order, and their values in the same order
+        [[nodiscard]] std::vector<std::string> keys() const;
+        [[nodiscard]] std::vector<SharedValue> values() const;
 
         DATA_TYPE(ObjectType)
         TYPENAME("object")
@@ -199,4 +271,46 @@ namespace interpreter::types {
         OVERRIDE_BIN_OP(==) OVERRIDE_BIN_OP(!=)
     };
 
+    // Values made one at a time by a call of a function with
+    // `yield`, which is suspended in between. The engine that
+    // made the call keeps it and resumes it for every value
+    struct GeneratorObject final : AnyValue {
+        // false once the call has returned, otherwise sets the value yielded
+        using Resume = std::function<bool(SharedValue &value)>;
+        const Resume resume;
+        explicit GeneratorObject(Resume resume) : resume(std::move(resume)) {}
+
+        DATA_TYPE(GeneratorType)
+        TYPENAME("generator")
+        DECL_STRING { return "generator"; }
+
+        OVERRIDE_BIN_OP(==) OVERRIDE_BIN_OP(!=)
+    };
+
+    // Position of a for-in loop or a builtin in its collection. The
+    // collection is read as it is at each step, so changing it inside
+    // the loop is safe: arrays and strings are walked by index until
+    // it reaches their current size, objects in the order of keys,
+    // visiting keys added meanwhile after the current one (keys are
+    // never removed). Numbers of ranges are counted one at a time,
+    // generators are resumed for each value
+    struct IteratorValue final : AnyValue {
+        explicit IteratorValue(SharedValue collection);
+        // whether a single loop variable takes keys rather than elements
+        [[nodiscard]] bool keyed() const;
+        // false once the collection is over, otherwise sets the
+        // key (index of arrays and strings) and the element asked for
+        bool next(SharedValue* key, SharedValue* element);
+
+        DATA_TYPE(IteratorType)
+        TYPENAME("iterator")
+        DECL_STRING { return "iterator"; }
+    private:
+        const SharedValue collection;
+        size_t index;
+        long double counter;
+        // of objects, the key visited last
+        std::string key;
+    };
+
 }
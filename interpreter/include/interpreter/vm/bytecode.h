@@ -0,0 +1,156 @@
+/*
+ * Compact bytecode executed by the stack machine.
+ * Variables have the lexical addresses the tree-walking
+ * interpreter gives them, scopes are laid out the same way;
+ * only names declared outside of the code that is known
+ * when it is compiled are looked up by name.
+ * Every instruction remembers the chain of AST nodes
+ * it was compiled from, so that runtime errors can be
+ * reported with exactly the same labels as the
+ * tree-walking interpreter produces
+ */
+
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "parser/ast.h"
+#include "interpreter/dispatch.h"
+#include "interpreter/operators.h"
+#include "interpreter/scope.h"
+
+using namespace parser::AST;
+
+namespace interpreter::vm {
+    enum class OpCode : unsigned char {
+        // stack manipulation
+        Pop,              // operand: amount of values to drop
+        PushNumber,       // operand: index in numbers
+        PushString,       // operand: index in strings
+        PushBoolean,      // operand: 0 or 1
+        PushNil,
+        CopyValue,        // copyForAssignment on top of the stack
+        // variables and scopes
+        LoadVariable,     // operand: index of the name in strings
+        StoreVariable,    // operand: index of the name, keeps value on the stack
+        LoadSlot,         // operand: index in slots
+        StoreSlot,        // operand: index in slots, keeps value on the stack
+        DeclareVariable,  // operand: index in slots, pops value
+        DeclareNil,       // operand: index in slots
+        EnterScope,       // operand: index in layouts
+        LeaveScope,       // operand: amount of scopes to leave
+        // operators
+        BinaryOperation,  // operand: index in sites (binary or compound assignment)
+        BinaryWithNumber, // operand: index in sites, the right operand is its number
+        PrefixOperation,  // operand: Operator (Not or Negate)
+        // objects
+        MakeArray,        // operand: amount of elements
+        MakeObject,       // operand: amount of key-value pairs
+        MakeFunction,     // operand: index in functions
+        Concatenate,      // operand: amount of values joined into a string
+        CheckIndexTarget,
+        LoadIndex,
+        StoreIndex,
+        // control flow
+        Jump,             // operand: target instruction
+        JumpIfFalse,      // operand: target instruction, expects boolean
+        Dispatch,         // operand: index in dispatches, pops the subject
+        ForPrepare,
+        ForDeclare,       // operand: index of the counter in slots
+        ForCheck,         // operand: target instruction when the loop is over
+        ForStep,          // operand: index of the counter in slots
+        IterPrepare,      // replaces the collection with its iterator
+        IterNext,         // operand: target when it is over, pushes the element (key of objects)
+        IterNextPair,     // operand: target when it is over, pushes the key and the element
+        Call,             // operand: amount of arguments
+        Return,
+        ReturnNil,
+        Yield,            // suspends the generator, handing out the top of the stack
+        // function prologue, defaults are declared as variables
+        BindArguments,
+        GeneratorStart,   // suspends the generator until it is first resumed
+        // statements
+        Import,           // operand: index in imports
+        Echo,
+        // errors
+        ThrowMisplaced,   // operand: MisplacedFlow
+        ThrowUnsupportedOperator, // operand: index of the operator in strings
+        ThrowExpectedIdentifier,
+        ThrowParameterFormat,
+        ThrowDuplicateParameter, // operand: index of the name in strings
+        ThrowErrorNode,
+    };
+
+    enum class MisplacedFlow : unsigned char {
+        Break, Continue, Return, Yield,
+    };
+
+    // path entries form a tree: each one points to the
+    // entry of the enclosing node, -1 marks the root
+    struct PathEntry {
+        const Node* node;
+        int parent;
+    };
+
+    struct Instruction {
+        OpCode code;
+        unsigned operand;
+        int path;
+    };
+
+    struct FunctionTemplate {
+        const std::vector<ExpressionPtr> &parameters;
+        const StatementPtr &body;
+        // layouts of the scopes the function is made in, the
+        // outermost first: an empty one stands for the global scope
+        std::vector<std::shared_ptr<ScopeLayout>> enclosing;
+    };
+
+    // variable found by its address, the name
+    // is for errors and for the fallback lookup
+    struct Slot {
+        VariableAddress address;
+        unsigned name;
+    };
+
+    // binary operation specializing itself on the
+    // operands it sees, number is a literal right operand
+    struct OperationSite {
+        operators::QuickenedBinary operation;
+        long double number;
+    };
+
+    // parameter bound by BindArguments, in the order of the arguments
+    struct Parameter {
+        unsigned name;
+        size_t slot;
+        bool required;
+    };
+
+    // where each arm of a match statement starts,
+    // the last target is the else clause or the end
+    struct DispatchTargets {
+        DispatchTable table;
+        std::vector<size_t> targets;
+    };
+
+    struct Code {
+        std::vector<Instruction> instructions;
+        std::vector<long double> numbers;
+        std::vector<std::string> strings;
+        std::vector<FunctionTemplate> functions;
+        std::vector<const ImportLibraryStatement*> imports;
+        std::vector<DispatchTargets> dispatches;
+        std::vector<PathEntry> paths;
+        std::vector<std::shared_ptr<ScopeLayout>> layouts;
+        std::vector<Slot> slots;
+        mutable std::vector<OperationSite> sites;
+        // scope of parameters of a function and what is bound in it
+        std::shared_ptr<ScopeLayout> frame;
+        std::vector<Parameter> parameters;
+        // calls get a generator suspended before the body
+        bool generator = false;
+        // program the code was read in, when it is run as it is read
+        std::weak_ptr<const Node> tree;
+    };
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include "bytecode.h"
+
+namespace interpreter::vm {
+    class Compiler final {
+        struct LoopContext {
+            size_t scopeDepth;
+            std::optional<size_t> continueTarget;
+            std::vector<size_t> continueJumps;
+            std::vector<size_t> breakJumps;
+        };
+        Code &code;
+        const bool insideFunction;
+        std::vector<LoopContext> loops;
+        std::unordered_map<std::string, unsigned> names;
+        // layouts of the scopes around the instruction being
+        // emitted, the innermost last. An empty one is the
+        // global scope, names not found before it or the
+        // first one are looked up by name at runtime
+        std::vector<std::shared_ptr<ScopeLayout>> frames;
+        size_t scopeDepth;
+        int currentPath;
+        Compiler(Code &code, bool insideFunction, std::vector<std::shared_ptr<ScopeLayout>> frames);
+        // statements
+        void compileStatement(const StatementPtr &statement);
+        void compileVariableDeclaration(const VariableDeclarationStatement* declaration);
+        void compileFunctionDeclaration(const FunctionDeclarationStatement* function);
+        void compileForLoop(const ForLoopStatement* forLoop);
+        void compileForInLoop(const ForInLoopStatement* forIn);
+        void compileWhileLoop(const WhileLoopStatement* whileLoop);
+        void compileIfElse(const IfElseStatement* ifElse);
+        void compileMatch(const MatchStatement* match);
+        void compileContinue();
+        void compileBreak();
+        void compileReturn(const ReturnOperatorStatement* returnOp);
+        void compileYield(const YieldStatement* yield);
+        void compileBlock(const BlockStatement* block);
+        // expressions
+        void compileExpression(const ExpressionPtr &expression);
+        void compileBinaryOperation(const BinaryOperationExpression* expression);
+        void compileAssignment(const ExpressionPtr &left, const ExpressionPtr &right);
+        void compilePrefixOperation(const PrefixOperationExpression* expression);
+        void compileCall(const CallExpression* expression);
+        void compileObject(const ObjectExpression* objExpr);
+        // function prologue
+        void compileParameters(const std::vector<ExpressionPtr> &parameters);
+        // helper functions
+        size_t emit(OpCode opCode, unsigned operand = 0);
+        void emitMisplaced(MisplacedFlow flow);
+        void patchJump(size_t instruction);
+        void enterPath(const Node* node);
+        void leavePath();
+        void leaveScopesUntil(size_t depth);
+        void enterScope(std::shared_ptr<ScopeLayout> layout);
+        void leaveScope();
+        // emits a load or a store of the variable
+        void emitVariable(const std::string &name, bool store);
+        // slot of a name declared in the innermost scope
+        unsigned declare(const std::string &name);
+        unsigned addSlot(const VariableAddress &address, const std::string &name);
+        unsigned addSite(Operator op, long double number = 0);
+        unsigned addName(const std::string &name);
+        unsigned addNumber(long double number);
+        unsigned addFunction(const std::vector<ExpressionPtr> &parameters, const StatementPtr &body);
+    public:
+        static std::unique_ptr<Code> compileProgram(const Program &program);
+        // enclosing as in FunctionTemplate, none when the
+        // function is not known to be made by compiled code
+        static std::unique_ptr<Code> compileFunction (
+            const std::vector<ExpressionPtr> &parameters,
+            const StatementPtr &body,
+            std::vector<std::shared_ptr<ScopeLayout>> enclosing
+        );
+    };
+}
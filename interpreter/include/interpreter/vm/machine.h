@@ -0,0 +1,67 @@
+#pragma once
+#include <unordered_map>
+#include "bytecode.h"
+#include "interpreter/scope.h"
+#include "interpreter/options.h"
+
+using interpreter::types::FunctionalObject;
+
+namespace interpreter::vm {
+    // Stack machine executing code produced by vm::Compiler.
+    // Calls of toy functions do not nest native frames:
+    // they are kept on a heap-allocated stack of frames.
+    // Public interface mirrors interpreter::Interpreter
+    class Machine final {
+        struct Frame {
+            const Code* code;
+            // where to continue after the callee returns
+            // or once the generator is resumed
+            size_t ip;
+            // size of the value stack when the frame was entered
+            size_t base;
+            // nil for the frame of a program
+            SharedValue function;
+            SharedScope callingScope;
+            // bound once the defaults of the parameters are declared
+            std::vector<SharedValue> arguments;
+        };
+        const std::string filename;
+        const Options options;
+        const size_t maxCallDepth;
+        SharedScope scope;
+        std::vector<SharedValue> stack;
+        std::vector<Frame> frames;
+        std::optional<std::string> fatalError;
+        // shared with the functions made by the modules,
+        // which keep them as long as they are left
+        std::vector<std::shared_ptr<Program>> importedASTs;
+        // shared with the machines of generators
+        std::shared_ptr<std::unordered_map<const Statement*, std::unique_ptr<Code>>> functionCode;
+        // set while the machine of a generator runs its body
+        bool running;
+        Machine(const Machine &parent, std::string filename);
+        void execute(Program &program, const std::weak_ptr<const Node> &tree);
+        void dropFreedCode();
+        SharedValue run(const Code &code);
+        SharedValue execute(size_t entryDepth);
+        void enterFunction(const Code &code, SharedValue function, std::vector<SharedValue> arguments);
+        SharedValue startGenerator(const Code &code, SharedValue function, std::vector<SharedValue> arguments);
+        bool resume(SharedValue &value);
+        [[noreturn]] void unwind(size_t entryDepth, size_t ip, const std::exception_ptr &exception);
+        // compiled when the function is made, from where it is made
+        const Code& getFunctionCode(const FunctionalObject* function, const FunctionTemplate* source = nullptr);
+        void executeImport(const ImportLibraryStatement* import);
+        static SharedValue* getPlacePointer(const SharedValue &target, const SharedValue &index, bool read);
+    public:
+        explicit Machine(std::string filename, const Storage& initialStorage = {}, const Options& options = {});
+        void executeProgram(Program &program);
+        // one more piece of a program run as it is read, usually a single
+        // statement. Declarations stay for the next ones, the tree is kept
+        // only as long as functions made from it are
+        void executeStreamed(const std::shared_ptr<Program> &program);
+        [[nodiscard]] bool didFailed() const;
+        [[nodiscard]] const std::optional<std::string>& getFatalError() const;
+        [[nodiscard]] std::vector<std::shared_ptr<Program>>& getImportedASTs();
+        [[nodiscard]] const SharedScope& getScope() const;
+    };
+}
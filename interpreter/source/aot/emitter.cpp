@@ -0,0 +1,559 @@
+#include "aot/emitter.h"
+#include "parser/parser.h"
+#include "constants.h"
+#include "optimizer.h"
+#include "prelude.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+using namespace interpreter;
+using namespace interpreter::aot;
+
+std::string Emitter::emitExecutable (
+    const std::string &filename,
+    Program &program,
+    const Options &options,
+    bool virtualMachine,
+    bool &lowered
+) {
+    Emitter emitter;
+    lowered = straightLine(program);
+    if (lowered) {
+        if (options.optimizationLevel > 0) {
+            Optimizer::optimize(program);
+        }
+        const auto statements = emitter.lowerProgram(program);
+        std::string labels;
+        if (!emitter.labels.empty()) {
+            labels = "static const std::string labels[] = {\n";
+            for (const auto &each : emitter.labels) {
+                labels += "    " + quoted(each) + ",\n";
+            }
+            labels += "};\n\n";
+        }
+        return "// Built by `toy_lang_app build` from " + quoted(filename) + "\n"
+            "#include <iostream>\n"
+            "#include \"interpreter/aot/runtime.h\"\n"
+            "#include \"interpreter/operators.h\"\n\n"
+            "using namespace interpreter;\n"
+            "using namespace interpreter::aot;\n\n"
+            + labels + statements +
+            "int main() {\n"
+            "    execute(&lowered);\n"
+            "    return 0;\n"
+            "}\n";
+    }
+
+    std::string functions = emitter.emitProgram(program, "module0");
+    std::string embeddings;
+    // a module may import further ones, they are appended as found
+    for (size_t i = 0; i < emitter.modules.size(); i++) {
+        const auto &module = emitter.modules[i];
+        std::ifstream filestream(module);
+        if (filestream.bad() || !filestream.is_open()) continue;
+        auto _parser = parser::Parser(filestream);
+        const auto moduleAST = _parser.readProgram();
+        if (!_parser.getErrors().empty()) continue;
+        const auto function = "module" + std::to_string(i + 1);
+        functions += emitter.emitProgram(*moduleAST, function);
+        embeddings += "    embedModule(" + quoted(module) + ", &" + function + ");\n";
+    }
+
+    return "// Built by `toy_lang_app build` from " + quoted(filename) + "\n"
+        "#include \"interpreter/aot/runtime.h\"\n\n"
+        "using namespace interpreter::aot;\n\n"
+        + functions +
+        "int main() {\n"
+        + embeddings
+        + emitOptions(options) +
+        "    auto entry = module0();\n"
+        "    execute(" + quoted(filename) + ", *entry, options, " + (virtualMachine ? "true" : "false") + ");\n"
+        "    return 0;\n"
+        "}\n";
+}
+
+std::string Emitter::emitProgram(const Program &program, const std::string &function) {
+    std::string code = "static ProgramPtr " + function + "() {\n";
+    code += "    std::vector<StatementPtr> statements;\n";
+    for (const auto &each : program.statements) {
+        code += "    statements.push_back(" + emitStatement(each) + ");\n";
+    }
+    code += "    return program(std::move(statements), " + position(&program) + ");\n";
+    code += "}\n\n";
+    return code;
+}
+
+std::string Emitter::emitOptions(const Options &options) {
+    std::string code = "    interpreter::Options options;\n";
+    code += "    options.tailCalls = " + std::string(options.tailCalls ? "true" : "false") + ";\n";
+    if (options.maxCallDepth.has_value()) {
+        code += "    options.maxCallDepth = " + std::to_string(*options.maxCallDepth) + ";\n";
+    }
+    code += "    options.jit = " + std::string(options.jit ? "true" : "false") + ";\n";
+    code += "    options.optimizationLevel = " + std::to_string(options.optimizationLevel) + ";\n";
+    code += "    options.inlineBudget = " + std::to_string(options.inlineBudget) + ";\n";
+    code += "    options.tierThreshold = " + std::to_string(options.tierThreshold) + ";\n";
+    return code;
+}
+
+// STATEMENTS
+
+std::string Emitter::emitStatement(const StatementPtr &statement) {
+    #define STMT_PTR(TYPE) static_cast<TYPE*>(statement.get())
+    const auto at = position(statement.get());
+    using enum Statement::StatementType;
+    switch (statement->statementType()) {
+        case LibraryImport: {
+            const auto import = STMT_PTR(ImportLibraryStatement);
+            const auto module = import->libName + ".toy";
+            if (seen.insert(module).second) {
+                modules.push_back(module);
+            }
+            const auto alias = import->alias.has_value() ? quoted(*import->alias) : "std::nullopt";
+            return "importLibrary(" + quoted(import->libName) + ", " + alias + ", " + at + ")";
+        }
+        case VariableDeclaration: {
+            const auto declaration = STMT_PTR(VariableDeclarationStatement);
+            const auto value = declaration->value.has_value() ? emitExpression(*declaration->value) : "nullptr";
+            const auto constant = declaration->constant ? "true" : "false";
+            return "variableDeclaration(" + quoted(declaration->name) + ", " + value + ", " + constant + ", " + at + ")";
+        }
+        case FunctionDeclaration: {
+            const auto function = STMT_PTR(FunctionDeclarationStatement);
+            return "functionDeclaration(" + quoted(function->name) + ", "
+                + emitExpressions(function->parameters) + ", "
+                + emitStatement(function->body) + ", " + at + ")";
+        }
+        case ForLoop: {
+            const auto forLoop = STMT_PTR(ForLoopStatement);
+            const auto step = forLoop->step.has_value() ? emitExpression(*forLoop->step) : "nullptr";
+            return "forLoop(" + quoted(forLoop->variable) + ", "
+                + emitExpression(forLoop->start) + ", "
+                + emitExpression(forLoop->end) + ", " + step + ", "
+                + emitStatement(forLoop->body) + ", " + at + ")";
+        }
+        case ForInLoop: {
+            const auto forIn = STMT_PTR(ForInLoopStatement);
+            std::string variables = "list<std::string>(";
+            for (size_t i = 0; i < forIn->variables.size(); i++) {
+                if (i > 0) variables += ", ";
+                variables += quoted(forIn->variables[i]);
+            }
+            return "forInLoop(" + variables + "), " + emitExpression(forIn->collection) + ", "
+                + emitStatement(forIn->body) + ", " + at + ")";
+        }
+        case WhileLoop: {
+            const auto whileLoop = STMT_PTR(WhileLoopStatement);
+            return "whileLoop(" + emitExpression(whileLoop->condition) + ", "
+                + emitStatement(whileLoop->body) + ", " + at + ")";
+        }
+        case IfElse: {
+            const auto ifElse = STMT_PTR(IfElseStatement);
+            const auto elseClause = ifElse->elseClause.has_value() ? emitStatement(*ifElse->elseClause) : "nullptr";
+            return "ifElse(" + emitExpression(ifElse->condition) + ", "
+                + emitStatement(ifElse->mainClause) + ", " + elseClause + ", " + at + ")";
+        }
+        case Match: {
+            const auto match = STMT_PTR(MatchStatement);
+            std::string cases = "list<MatchCase>(";
+            for (size_t i = 0; i < match->cases.size(); i++) {
+                if (i > 0) cases += ", ";
+                const auto &[values, body] = match->cases[i];
+                cases += "MatchCase(" + emitExpressions(values) + ", " + emitStatement(body) + ")";
+            }
+            const auto elseClause = match->elseClause.has_value() ? emitStatement(*match->elseClause) : "nullptr";
+            return "match(" + emitExpression(match->subject) + ", " + cases + "), " + elseClause + ", " + at + ")";
+        }
+        case ContinueOperator:
+            return "continueOperator(" + at + ")";
+        case BreakOperator:
+            return "breakOperator(" + at + ")";
+        case ReturnOperator: {
+            const auto returnOp = STMT_PTR(ReturnOperatorStatement);
+            const auto expression = returnOp->expression.has_value() ? emitExpression(*returnOp->expression) : "nullptr";
+            return "returnOperator(" + expression + ", " + at + ")";
+        }
+        case Yield:
+            return "yieldStatement(" + emitExpression(STMT_PTR(YieldStatement)->expression) + ", " + at + ")";
+        case BareExpression:
+            return "bareExpression(" + emitExpression(STMT_PTR(ExpressionStatement)->expression) + ", " + at + ")";
+        case BlockOfStatements:
+            return "block(" + emitStatements(STMT_PTR(BlockStatement)->statements) + ", " + at + ")";
+        case Echo:
+            return "echo(" + emitExpression(STMT_PTR(EchoStatement)->expression) + ", " + at + ")";
+        case StatementError:
+            return "illegalStatement(" + at + ")";
+    }
+    return "illegalStatement(" + at + ")";
+    #undef STMT_PTR
+}
+
+std::string Emitter::emitStatements(const std::vector<StatementPtr> &statements) {
+    std::string code = "list<StatementPtr>(";
+    for (size_t i = 0; i < statements.size(); i++) {
+        if (i > 0) code += ", ";
+        code += emitStatement(statements[i]);
+    }
+    return code + ")";
+}
+
+// EXPRESSIONS
+
+std::string Emitter::emitExpression(const ExpressionPtr &expression) {
+    #define EXPR_PTR(TYPE) static_cast<TYPE*>(expression.get())
+    const auto at = position(expression.get());
+    using enum Expression::ExpressionType;
+    switch (expression->expressionType()) {
+        case BinaryOperation: {
+            const auto binary = EXPR_PTR(BinaryOperationExpression);
+            return "binaryOperation(" + emitExpression(binary->left) + ", " + quoted(binary->op) + ", "
+                + emitExpression(binary->right) + ", " + at + ")";
+        }
+        case PrefixOperation: {
+            const auto prefix = EXPR_PTR(PrefixOperationExpression);
+            return "prefixOperation(" + quoted(prefix->op) + ", " + emitExpression(prefix->expression) + ", " + at + ")";
+        }
+        case Call: {
+            const auto call = EXPR_PTR(CallExpression);
+            return "call(" + emitExpression(call->target) + ", " + emitExpressions(call->arguments) + ", " + at + ")";
+        }
+        case IndexAccess: {
+            const auto access = EXPR_PTR(IndexAccessExpression);
+            return "indexAccess(" + emitExpression(access->target) + ", " + emitExpression(access->index) + ", " + at + ")";
+        }
+        case NumberLiteral:
+            return "number(" + number(EXPR_PTR(NumberLiteralExpression)->value) + ", " + at + ")";
+        case BooleanLiteral:
+            return "boolean(" + std::string(EXPR_PTR(BooleanLiteralExpression)->value ? "true" : "false") + ", " + at + ")";
+        case StringLiteral:
+            return "string(" + quoted(EXPR_PTR(StringLiteralExpression)->value) + ", " + at + ")";
+        case NilLiteral:
+            return "nil(" + at + ")";
+        case ArrayLiteral:
+            return "array(" + emitExpressions(EXPR_PTR(ArrayLiteralExpression)->values) + ", " + at + ")";
+        case Interpolation:
+            return "interpolation(" + emitExpressions(EXPR_PTR(InterpolationExpression)->parts) + ", " + at + ")";
+        case Variable:
+            return "variable(" + quoted(EXPR_PTR(VariableExpression)->name) + ", " + at + ")";
+        case Lambda: {
+            const auto lambda = EXPR_PTR(LambdaExpression);
+            return "lambda(" + emitExpressions(lambda->parameters) + ", " + emitStatement(lambda->body) + ", " + at + ")";
+        }
+        case Object: {
+            std::string entries = "list<ObjectEntry>(";
+            const auto &objectList = EXPR_PTR(ObjectExpression)->objectList;
+            for (size_t i = 0; i < objectList.size(); i++) {
+                if (i > 0) entries += ", ";
+                const auto &[key, value] = objectList[i];
+                entries += "ObjectEntry(" + emitExpression(key) + ", " + emitExpression(value) + ")";
+            }
+            return "object(" + entries + "), " + at + ")";
+        }
+        case ExpressionError:
+            return "illegalExpression(" + at + ")";
+    }
+    return "illegalExpression(" + at + ")";
+    #undef EXPR_PTR
+}
+
+std::string Emitter::emitExpressions(const std::vector<ExpressionPtr> &expressions) {
+    std::string code = "list<ExpressionPtr>(";
+    for (size_t i = 0; i < expressions.size(); i++) {
+        if (i > 0) code += ", ";
+        code += emitExpression(expressions[i]);
+    }
+    return code + ")";
+}
+
+// LOWERING
+
+// whether the program can be lowered; one that would be
+// rejected before running is left to the engines to reject
+bool Emitter::straightLine(Program &program) {
+    const auto &builtins = prelude::getPrelude();
+    const auto &constants = prelude::getConstants();
+    std::set<std::string> declared;
+    for (const auto &statement : program.statements) {
+        using enum Statement::StatementType;
+        switch (statement->statementType()) {
+            case VariableDeclaration: {
+                const auto declaration = static_cast<VariableDeclarationStatement*>(statement.get());
+                if (declaration->value.has_value() && !straightLine(*declaration->value, declared)) return false;
+                const auto &name = declaration->name;
+                if (builtins.contains(name) || constants.contains(name)) return false;
+                if (!declared.insert(name).second) return false;
+                continue;
+            }
+            case Echo:
+                if (!straightLine(static_cast<EchoStatement*>(statement.get())->expression, declared)) return false;
+                continue;
+            case BareExpression:
+                if (!straightLine(static_cast<ExpressionStatement*>(statement.get())->expression, declared)) return false;
+                continue;
+            default:
+                return false;
+        }
+    }
+    try {
+        Constants::check(program);
+    } catch (const exceptions::RuntimeException&) {
+        return false;
+    }
+    return true;
+}
+
+bool Emitter::straightLine(const ExpressionPtr &expression, const std::set<std::string> &declared) {
+    #define EXPR_PTR(TYPE) static_cast<TYPE*>(expression.get())
+    const auto all = [&](const std::vector<ExpressionPtr> &expressions) {
+        return std::ranges::all_of(expressions, [&](const auto &each) { return straightLine(each, declared); });
+    };
+    using enum Expression::ExpressionType;
+    switch (expression->expressionType()) {
+        case BinaryOperation: {
+            const auto binary = EXPR_PTR(BinaryOperationExpression);
+            if (binary->opcode != Operator::Assign) {
+                return straightLine(binary->left, declared) && straightLine(binary->right, declared);
+            }
+            const auto &left = binary->left;
+            if (left->expressionType() == Variable) {
+                const auto &name = static_cast<VariableExpression*>(left.get())->name;
+                return declared.contains(name) && straightLine(binary->right, declared);
+            }
+            if (left->expressionType() == IndexAccess) {
+                const auto access = static_cast<IndexAccessExpression*>(left.get());
+                return straightLine(access->target, declared) && straightLine(access->index, declared)
+                    && straightLine(binary->right, declared);
+            }
+            return false;
+        }
+        case PrefixOperation:
+            return straightLine(EXPR_PTR(PrefixOperationExpression)->expression, declared);
+        case Call: {
+            const auto call = EXPR_PTR(CallExpression);
+            if (call->target->expressionType() != Variable) return false;
+            const auto &name = static_cast<VariableExpression*>(call->target.get())->name;
+            const auto &builtins = prelude::getPrelude();
+            const auto builtin = builtins.find(name);
+            if (builtin == builtins.end() || builtin->second->dataType() != types::BuiltinType) return false;
+            return all(call->arguments);
+        }
+        case IndexAccess: {
+            const auto access = EXPR_PTR(IndexAccessExpression);
+            return straightLine(access->target, declared) && straightLine(access->index, declared);
+        }
+        case NumberLiteral:
+        case BooleanLiteral:
+        case StringLiteral:
+        case NilLiteral:
+            return true;
+        case ArrayLiteral:
+            return all(EXPR_PTR(ArrayLiteralExpression)->values);
+        case Interpolation:
+            return all(EXPR_PTR(InterpolationExpression)->parts);
+        case Variable:
+            return declared.contains(EXPR_PTR(VariableExpression)->name);
+        case Object:
+            return std::ranges::all_of(EXPR_PTR(ObjectExpression)->objectList, [&](const auto &entry) {
+                const auto &[key, value] = entry;
+                return straightLine(key, declared) && straightLine(value, declared);
+            });
+        case Lambda:
+        case ExpressionError:
+            return false;
+    }
+    return false;
+    #undef EXPR_PTR
+}
+
+// The statements become a function, each variable a value local
+// to it. Evaluation order and copies are the ones of the engines
+std::string Emitter::lowerProgram(const Program &program) {
+    std::string body;
+    for (const auto &each : program.statements) {
+        if (each) body += lowerStatement(each);
+    }
+    std::string code = "static void lowered() {\n";
+    // named in the order of their declarations
+    if (!locals.empty()) {
+        code += "    types::SharedValue ";
+        for (size_t i = 0; i < locals.size(); i++) {
+            if (i > 0) code += ", ";
+            code += "v" + std::to_string(i);
+        }
+        code += ";\n";
+    }
+    return code + body + "}\n\n";
+}
+
+std::string Emitter::lowerStatement(const StatementPtr &statement) {
+    const auto at = label(statement.get());
+    std::string code;
+    using enum Statement::StatementType;
+    switch (statement->statementType()) {
+        case VariableDeclaration: {
+            const auto declaration = static_cast<VariableDeclarationStatement*>(statement.get());
+            const auto value = declaration->value.has_value()
+                ? "types::copyForAssignment(" + lowerExpression(*declaration->value) + ")"
+                : "types::NilValue::getInstance()";
+            const auto variable = "v" + std::to_string(locals.size());
+            locals[declaration->name] = variable;
+            code = variable + " = " + value + ";";
+            break;
+        }
+        case Echo:
+            code = "std::cout << " + lowerExpression(static_cast<EchoStatement*>(statement.get())->expression)
+                + "->toString() << std::endl;";
+            break;
+        case BareExpression:
+            code = lowerExpression(static_cast<ExpressionStatement*>(statement.get())->expression) + ";";
+            break;
+        default:
+            throw exceptions::InternalException("statement cannot be lowered");
+    }
+    return "    at(" + at + ", [&] { " + code + " });\n";
+}
+
+std::string Emitter::lowerExpression(const ExpressionPtr &expression) {
+    #define EXPR_PTR(TYPE) static_cast<TYPE*>(expression.get())
+    const auto lowered = [&](const std::string &body) {
+        return "at(" + label(expression.get()) + ", [&]() -> types::SharedValue { " + body + " })";
+    };
+    const auto values = [&](const std::vector<ExpressionPtr> &expressions) {
+        std::string code = "std::vector<types::SharedValue> values; values.reserve("
+            + std::to_string(expressions.size()) + "); ";
+        for (const auto &each : expressions) {
+            code += "values.push_back(" + lowerExpression(each) + "); ";
+        }
+        return code;
+    };
+    using enum Expression::ExpressionType;
+    switch (expression->expressionType()) {
+        case BinaryOperation: {
+            const auto binary = EXPR_PTR(BinaryOperationExpression);
+            const auto right = lowerExpression(binary->right);
+            if (binary->opcode == Operator::Assign) {
+                const auto &left = binary->left;
+                if (left->expressionType() == Variable) {
+                    const auto &variable = locals.at(static_cast<VariableExpression*>(left.get())->name);
+                    return lowered("auto copy = types::copyForAssignment(" + right + "); "
+                        + variable + " = copy; return copy;");
+                }
+                const auto access = static_cast<IndexAccessExpression*>(left.get());
+                return lowered("auto copy = types::copyForAssignment(" + right + "); "
+                    "const types::SharedValue target = " + lowerExpression(access->target) + "; "
+                    "*place(target, [&]() -> types::SharedValue { return " + lowerExpression(access->index) + "; }, false) = copy; "
+                    "return copy;");
+            }
+            const auto operands = "const types::SharedValue left = " + lowerExpression(binary->left) + "; "
+                "const types::SharedValue right = " + right + "; ";
+            if (binary->opcode == Operator::Unknown) {
+                return lowered(operands + "throw exceptions::UnsupportedOperatorException(" + quoted(binary->op) + ");");
+            }
+            return lowered("static operators::QuickenedBinary site(decodeBinaryOperator(" + quoted(binary->op) + ")); "
+                + operands + "return site(left, right);");
+        }
+        case PrefixOperation: {
+            const auto prefix = EXPR_PTR(PrefixOperationExpression);
+            const auto nested = lowerExpression(prefix->expression);
+            if (prefix->opcode == Operator::Unknown) {
+                return lowered("const types::SharedValue value = " + nested + "; "
+                    "throw exceptions::UnsupportedOperatorException(" + quoted(prefix->op) + ");");
+            }
+            return lowered("static const auto &handlers = operators::prefixRow(decodePrefixOperator(" + quoted(prefix->op) + ")); "
+                "return operators::prefix(handlers, " + nested + ");");
+        }
+        case Call: {
+            const auto call = EXPR_PTR(CallExpression);
+            std::string arguments = "std::vector<types::SharedValue> arguments; arguments.reserve("
+                + std::to_string(call->arguments.size()) + "); ";
+            for (const auto &each : call->arguments) {
+                arguments += "arguments.push_back(types::copyForAssignment(" + lowerExpression(each) + ")); ";
+            }
+            const auto &name = static_cast<VariableExpression*>(call->target.get())->name;
+            return lowered(arguments + "static const auto &function = builtin(" + quoted(name) + "); "
+                "return function(arguments);");
+        }
+        case IndexAccess: {
+            const auto access = EXPR_PTR(IndexAccessExpression);
+            return lowered("const types::SharedValue target = " + lowerExpression(access->target) + "; "
+                "const auto element = place(target, [&]() -> types::SharedValue { return " + lowerExpression(access->index) + "; }, true); "
+                "if (element == nullptr) return types::NilValue::getInstance(); "
+                "return *element;");
+        }
+        case NumberLiteral:
+            return "std::make_shared<types::NumberValue>(" + number(EXPR_PTR(NumberLiteralExpression)->value) + ")";
+        case BooleanLiteral:
+            return "std::make_shared<types::BooleanValue>(" + std::string(EXPR_PTR(BooleanLiteralExpression)->value ? "true" : "false") + ")";
+        case StringLiteral:
+            return "std::make_shared<types::StringValue>(" + quoted(EXPR_PTR(StringLiteralExpression)->value) + ")";
+        case NilLiteral:
+            return "types::NilValue::getInstance()";
+        case ArrayLiteral:
+            return lowered(values(EXPR_PTR(ArrayLiteralExpression)->values) + "return std::make_shared<types::ArrayObject>(values);");
+        case Interpolation:
+            return lowered(values(EXPR_PTR(InterpolationExpression)->parts) + "return types::concatenate(values);");
+        case Variable:
+            return locals.at(EXPR_PTR(VariableExpression)->name);
+        case Object: {
+            std::string entries = "std::map<std::string, types::SharedValue> entries; ";
+            for (const auto &[key, value] : EXPR_PTR(ObjectExpression)->objectList) {
+                entries += "{ const auto key = " + lowerExpression(key) + "->toString(); "
+                    "const types::SharedValue value = " + lowerExpression(value) + "; entries[key] = value; } ";
+            }
+            return lowered(entries + "return std::make_shared<types::UserObject>(entries);");
+        }
+        case Lambda:
+        case ExpressionError:
+            break;
+    }
+    throw exceptions::InternalException("expression cannot be lowered");
+    #undef EXPR_PTR
+}
+
+// labels are made at build time, and kept in a table of the executable
+std::string Emitter::label(const Node *node) {
+    labels.push_back(node->nodeLabel());
+    return "labels[" + std::to_string(labels.size() - 1) + "]";
+}
+
+// HELPERS
+
+// octal escapes take at most three digits, so
+// a following character is never read into them
+std::string Emitter::quoted(const std::string &text) {
+    std::string code = "std::string(\"";
+    for (const auto character : text) {
+        const auto byte = static_cast<unsigned char>(character);
+        if (character == '"' || character == '\\') {
+            code += '\\';
+            code += character;
+        } else if (byte >= 0x20 && byte < 0x7f) {
+            code += character;
+        } else {
+            char escape[5];
+            std::snprintf(escape, sizeof(escape), "\\%03o", byte);
+            code += escape;
+        }
+    }
+    return code + "\", " + std::to_string(text.size()) + ")";
+}
+
+// hexadecimal literals keep every bit of the value
+std::string Emitter::number(long double value) {
+    if (std::isinf(value)) {
+        return value > 0 ? "HUGE_VALL" : "-HUGE_VALL";
+    }
+    if (std::isnan(value)) {
+        return "NAN";
+    }
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%LaL", value);
+    return buffer;
+}
+
+std::string Emitter::position(const Node *node) {
+    const auto [line, column] = node->position;
+    return "{" + std::to_string(line) + ", " + std::to_string(column) + "}";
+}
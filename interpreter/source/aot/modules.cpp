@@ -0,0 +1,19 @@
+#include "aot/modules.h"
+#include <map>
+
+using namespace interpreter;
+
+static std::map<std::string, aot::ModuleBuilder>& registry() {
+    static std::map<std::string, aot::ModuleBuilder> instance;
+    return instance;
+}
+
+void aot::embedModule(const std::string &filename, ModuleBuilder builder) {
+    registry()[filename] = builder;
+}
+
+aot::ProgramPtr aot::embeddedModule(const std::string &filename) {
+    const auto it = registry().find(filename);
+    if (it == registry().end()) return nullptr;
+    return it->second();
+}
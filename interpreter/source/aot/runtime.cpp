@@ -0,0 +1,210 @@
+#include "aot/runtime.h"
+#include "interpreter.h"
+#include "optimizer.h"
+#include "prelude.h"
+#include "vm/machine.h"
+#include <iostream>
+
+using namespace interpreter;
+
+template <typename T>
+static std::optional<T> present(T child) {
+    if (!child) return std::nullopt;
+    return child;
+}
+
+ProgramPtr aot::program(std::vector<StatementPtr> statements, Position position) {
+    return std::make_unique<Program>(statements, position);
+}
+
+// STATEMENTS
+
+StatementPtr aot::importLibrary(std::string libName, std::optional<std::string> alias, Position position) {
+    return std::make_unique<ImportLibraryStatement>(libName, alias, position);
+}
+
+StatementPtr aot::variableDeclaration(std::string name, ExpressionPtr value, bool constant, Position position) {
+    auto maybeValue = present(std::move(value));
+    return std::make_unique<VariableDeclarationStatement>(name, maybeValue, position, constant);
+}
+
+StatementPtr aot::functionDeclaration(std::string name, std::vector<ExpressionPtr> parameters, StatementPtr body, Position position) {
+    return std::make_unique<FunctionDeclarationStatement>(name, parameters, body, position);
+}
+
+StatementPtr aot::forLoop(std::string variable, ExpressionPtr start, ExpressionPtr end, ExpressionPtr step, StatementPtr body, Position position) {
+    auto maybeStep = present(std::move(step));
+    return std::make_unique<ForLoopStatement>(variable, start, end, maybeStep, body, position);
+}
+
+StatementPtr aot::forInLoop(std::vector<std::string> variables, ExpressionPtr collection, StatementPtr body, Position position) {
+    return std::make_unique<ForInLoopStatement>(variables, collection, body, position);
+}
+
+StatementPtr aot::whileLoop(ExpressionPtr condition, StatementPtr body, Position position) {
+    return std::make_unique<WhileLoopStatement>(condition, body, position);
+}
+
+StatementPtr aot::ifElse(ExpressionPtr condition, StatementPtr mainClause, StatementPtr elseClause, Position position) {
+    auto maybeElse = present(std::move(elseClause));
+    return std::make_unique<IfElseStatement>(condition, mainClause, maybeElse, position);
+}
+
+StatementPtr aot::match(ExpressionPtr subject, std::vector<MatchCase> cases, StatementPtr elseClause, Position position) {
+    auto maybeElse = present(std::move(elseClause));
+    return std::make_unique<MatchStatement>(subject, cases, maybeElse, position);
+}
+
+StatementPtr aot::continueOperator(Position position) {
+    return std::make_unique<ContinueOperatorStatement>(position);
+}
+
+StatementPtr aot::breakOperator(Position position) {
+    return std::make_unique<BreakOperatorStatement>(position);
+}
+
+StatementPtr aot::returnOperator(ExpressionPtr expression, Position position) {
+    auto maybeExpression = present(std::move(expression));
+    return std::make_unique<ReturnOperatorStatement>(maybeExpression, position);
+}
+
+StatementPtr aot::yieldStatement(ExpressionPtr expression, Position position) {
+    return std::make_unique<YieldStatement>(expression, position);
+}
+
+StatementPtr aot::bareExpression(ExpressionPtr expression, Position position) {
+    return std::make_unique<ExpressionStatement>(expression, position);
+}
+
+StatementPtr aot::block(std::vector<StatementPtr> statements, Position position) {
+    return std::make_unique<BlockStatement>(statements, position);
+}
+
+StatementPtr aot::echo(ExpressionPtr expression, Position position) {
+    return std::make_unique<EchoStatement>(expression, position);
+}
+
+StatementPtr aot::illegalStatement(Position position) {
+    return std::make_unique<IllegalStatement>(position);
+}
+
+// EXPRESSIONS
+
+ExpressionPtr aot::binaryOperation(ExpressionPtr left, std::string op, ExpressionPtr right, Position position) {
+    return std::make_unique<BinaryOperationExpression>(left, right, op, position);
+}
+
+ExpressionPtr aot::prefixOperation(std::string op, ExpressionPtr expression, Position position) {
+    return std::make_unique<PrefixOperationExpression>(expression, op, position);
+}
+
+ExpressionPtr aot::call(ExpressionPtr target, std::vector<ExpressionPtr> arguments, Position position) {
+    return std::make_unique<CallExpression>(target, arguments, position);
+}
+
+ExpressionPtr aot::indexAccess(ExpressionPtr target, ExpressionPtr index, Position position) {
+    return std::make_unique<IndexAccessExpression>(target, index, position);
+}
+
+ExpressionPtr aot::number(long double value, Position position) {
+    return std::make_unique<NumberLiteralExpression>(value, position);
+}
+
+ExpressionPtr aot::boolean(bool value, Position position) {
+    return std::make_unique<BooleanLiteralExpression>(value, position);
+}
+
+ExpressionPtr aot::string(std::string value, Position position) {
+    return std::make_unique<StringLiteralExpression>(value, position);
+}
+
+ExpressionPtr aot::nil(Position position) {
+    return std::make_unique<NilLiteralExpression>(position);
+}
+
+ExpressionPtr aot::array(std::vector<ExpressionPtr> values, Position position) {
+    return std::make_unique<ArrayLiteralExpression>(values, position);
+}
+
+ExpressionPtr aot::variable(std::string name, Position position) {
+    return std::make_unique<VariableExpression>(name, position);
+}
+
+ExpressionPtr aot::lambda(std::vector<ExpressionPtr> parameters, StatementPtr body, Position position) {
+    return std::make_unique<LambdaExpression>(parameters, body, position);
+}
+
+ExpressionPtr aot::object(std::vector<ObjectEntry> entries, Position position) {
+    return std::make_unique<ObjectExpression>(entries, position);
+}
+
+ExpressionPtr aot::interpolation(std::vector<ExpressionPtr> parts, Position position) {
+    return std::make_unique<InterpolationExpression>(parts, position);
+}
+
+ExpressionPtr aot::illegalExpression(Position position) {
+    return std::make_unique<IllegalExpression>(position);
+}
+
+// EXECUTION
+
+static void reportFatalError(const std::string &error) {
+    std::cerr << std::endl << "Encountered a fatal error during runtime: "  << std::endl;
+    std::cerr << error << std::endl;
+}
+
+template <typename EngineType>
+static void executeWith(const std::string &filename, Program &program, const Options &options) {
+    EngineType engine(filename, {}, options);
+    engine.executeProgram(program);
+    const auto maybeError = engine.getFatalError();
+    if (maybeError.has_value()) {
+        reportFatalError(maybeError.value());
+    }
+}
+
+void aot::execute(const std::string &filename, Program &program, const Options &options, bool virtualMachine) {
+    if (options.optimizationLevel > 0) {
+        Optimizer::optimize(program);
+    }
+    if (virtualMachine) {
+        return executeWith<vm::Machine>(filename, program, options);
+    }
+    executeWith<Interpreter>(filename, program, options);
+}
+
+// LOWERED PROGRAMS
+
+types::SharedValue* aot::place(const types::SharedValue &target, const std::function<types::SharedValue()> &index, bool read) {
+    using namespace types;
+    if (target->dataType() == ArrayType) {
+        const auto arrayObject = static_cast<ArrayObject*>(target.get());
+        const auto floatingIndex = getCastedPointer<NumberType, NumberValue>(index())->value;
+        if (!utils::isInteger(floatingIndex)) throw exceptions::NonIntegerIndexException();
+        const auto integerIndex = static_cast<long>(floatingIndex);
+        if (integerIndex < 0) throw exceptions::NegativeArrayIndexException();
+        auto &elements = arrayObject->elements();
+        if (static_cast<size_t>(integerIndex) >= elements.size()) throw exceptions::IndexOutOfBoundsException(integerIndex);
+        return &elements[integerIndex];
+    }
+    if (target->dataType() == ObjectType) {
+        const auto objectPtr = static_cast<UserObject*>(target.get());
+        const auto key = index()->toString();
+        if (read) return objectPtr->findPlace(key);
+        return &objectPtr->getPlace(key);
+    }
+    throw exceptions::WrongIndexAccessTargetException(target->getTypename());
+}
+
+const types::BuiltinFunction::CppFunction& aot::builtin(const std::string &name) {
+    const auto &function = prelude::getPrelude().at(name);
+    return static_cast<types::BuiltinFunction*>(function.get())->cppCode;
+}
+
+void aot::execute(void (*statements)()) {
+    try {
+        statements();
+    } catch (const exceptions::RuntimeException &exception) {
+        reportFatalError(exception.what());
+    }
+}
@@ -0,0 +1,399 @@
+#include "constants.h"
+#include "prelude.h"
+#include "except.h"
+
+using namespace interpreter;
+using namespace interpreter::exceptions;
+
+static bool isLiteral(const ExpressionPtr &expression) {
+    using enum Expression::ExpressionType;
+    switch (expression->expressionType()) {
+        case NumberLiteral: case BooleanLiteral: case StringLiteral: case NilLiteral:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static ExpressionPtr copyOf(const Expression* literal, Position position) {
+    using enum Expression::ExpressionType;
+    switch (literal->expressionType()) {
+        case NumberLiteral:
+            return std::make_unique<NumberLiteralExpression>(static_cast<const NumberLiteralExpression*>(literal)->value, position);
+        case BooleanLiteral:
+            return std::make_unique<BooleanLiteralExpression>(static_cast<const BooleanLiteralExpression*>(literal)->value, position);
+        case StringLiteral: {
+            auto text = static_cast<const StringLiteralExpression*>(literal)->value;
+            return std::make_unique<StringLiteralExpression>(text, position);
+        }
+        default:
+            return std::make_unique<NilLiteralExpression>(position);
+    }
+}
+
+// constants of the prelude as literals, declared before the program
+static const std::map<std::string, ExpressionPtr>& preludeLiterals() {
+    static const auto instance = [] {
+        std::map<std::string, ExpressionPtr> literals;
+        for (const auto &[name, value] : prelude::getConstants()) {
+            Position nowhere { 0, 0 };
+            literals.emplace(name, std::make_unique<NumberLiteralExpression>(value, nowhere));
+        }
+        return literals;
+    }();
+    return instance;
+}
+
+void Constants::check(Program &program) {
+    Constants(false).walkProgram(program);
+}
+
+bool Constants::propagate(Program &program) {
+    Constants constants(true);
+    constants.walkProgram(program);
+    return constants.propagated;
+}
+
+Constants::Stream::Stream() : constants(false), checked(0) {
+    Frame frame;
+    for (const auto &[name, literal] : preludeLiterals()) {
+        frame.declarations[name].push_back({ -1, true, true, literal.get() });
+    }
+    constants.frames.push_back(std::move(frame));
+}
+
+// the statements are numbered on from the ones checked before,
+// all of them declaring into the same top-level frame
+void Constants::Stream::check(Program &program) {
+    for (auto &statement : program.statements) {
+        Frame declared;
+        collect(statement, checked, true, declared);
+        // the walk pushes frames of its own, moving this one
+        auto &frame = constants.frames.front();
+        for (auto &[name, declarations] : declared.declarations) {
+            const auto assignment = constants.outermostAssignments.find(name);
+            for (const auto &each : declarations) {
+                if (each.constant && assignment != constants.outermostAssignments.end()) {
+                    throw PropagatedException(assignment->second, ConstantAssignmentException(name).what());
+                }
+                frame.declarations[name].push_back(each);
+            }
+        }
+        frame.current = checked++;
+        constants.walkStatement(statement);
+    }
+}
+
+// SCOPES
+
+// declarations land in the same scopes as in Resolver::collectDeclarations
+void Constants::collect(const StatementPtr &statement, long index, bool definite, Frame &frame) {
+    #define STMT_PTR(TYPE) static_cast<TYPE*>(statement.get())
+    if (!statement) return;
+    using enum Statement::StatementType;
+    switch (statement->statementType()) {
+        case LibraryImport: {
+            const auto import = STMT_PTR(ImportLibraryStatement);
+            frame.declarations[import->alias.value_or(import->libName)].push_back({ index, definite, false, nullptr });
+            return;
+        }
+        case VariableDeclaration: {
+            const auto declaration = STMT_PTR(VariableDeclarationStatement);
+            const auto &value = declaration->value;
+            const auto literal = declaration->constant && definite && value.has_value() && isLiteral(*value);
+            frame.declarations[declaration->name].push_back({
+                index, definite, declaration->constant, literal ? value->get() : nullptr
+            });
+            return;
+        }
+        case FunctionDeclaration:
+            frame.declarations[STMT_PTR(FunctionDeclarationStatement)->name].push_back({ index, definite, false, nullptr });
+            return;
+        case WhileLoop:
+            return collect(STMT_PTR(WhileLoopStatement)->body, index, false, frame);
+        case IfElse: {
+            const auto ifElse = STMT_PTR(IfElseStatement);
+            collect(ifElse->mainClause, index, false, frame);
+            if (ifElse->elseClause.has_value()) {
+                collect(*ifElse->elseClause, index, false, frame);
+            }
+            return;
+        }
+        case Match: {
+            const auto match = STMT_PTR(MatchStatement);
+            for (const auto &[values, body] : match->cases) {
+                collect(body, index, false, frame);
+            }
+            if (match->elseClause.has_value()) {
+                collect(*match->elseClause, index, false, frame);
+            }
+            return;
+        }
+        default:
+            return;
+    }
+    #undef STMT_PTR
+}
+
+Constants::Frame Constants::frameOf(const std::vector<StatementPtr> &statements) {
+    Frame frame;
+    for (size_t i = 0; i < statements.size(); i++) {
+        collect(statements[i], static_cast<long>(i), true, frame);
+    }
+    return frame;
+}
+
+Constants::Lookup Constants::lookup(const std::string &name) const {
+    Lookup result;
+    bool certain = true;
+    for (auto frame = frames.rbegin(); frame != frames.rend(); frame++) {
+        const auto it = frame->declarations.find(name);
+        if (it == frame->declarations.end()) continue;
+        const auto &declarations = it->second;
+        bool declared = false;
+        for (const auto &each : declarations) {
+            result.constant = result.constant || each.constant;
+            declared = declared || (each.definite && each.statement < frame->current);
+        }
+        if (declared) {
+            if (certain && declarations.size() == 1) {
+                result.literal = declarations[0].literal;
+            }
+            result.outermost = frame == std::prev(frames.rend());
+            return result;
+        }
+        certain = false;
+    }
+    return result;
+}
+
+// STATEMENTS
+
+void Constants::walkProgram(Program &program) {
+    auto frame = frameOf(program.statements);
+    for (const auto &[name, literal] : preludeLiterals()) {
+        frame.declarations[name].insert(frame.declarations[name].begin(), { -1, true, true, literal.get() });
+    }
+    frames.push_back(std::move(frame));
+    for (size_t i = 0; i < program.statements.size(); i++) {
+        frames.back().current = static_cast<long>(i);
+        walkStatement(program.statements[i]);
+    }
+    frames.pop_back();
+}
+
+void Constants::walkSequence(std::vector<StatementPtr> &statements) {
+    frames.push_back(frameOf(statements));
+    for (size_t i = 0; i < statements.size(); i++) {
+        frames.back().current = static_cast<long>(i);
+        walkStatement(statements[i]);
+    }
+    frames.pop_back();
+}
+
+// unbraced bodies run in the scope around them
+void Constants::walkBody(StatementPtr &body) {
+    if (body->statementType() == Statement::StatementType::BlockOfStatements) {
+        return walkSequence(static_cast<BlockStatement*>(body.get())->statements);
+    }
+    walkStatement(body);
+}
+
+void Constants::walkStatement(StatementPtr &statement) {
+    #define STMT_PTR(TYPE) static_cast<TYPE*>(statement.get())
+    if (!statement) return;
+    using enum Statement::StatementType;
+    switch (statement->statementType()) {
+        case VariableDeclaration: {
+            const auto declaration = STMT_PTR(VariableDeclarationStatement);
+            if (declaration->value.has_value()) {
+                walkExpression(*declaration->value);
+            }
+            return;
+        }
+        case FunctionDeclaration: {
+            const auto function = STMT_PTR(FunctionDeclarationStatement);
+            return walkFunction(function->parameters, function->body);
+        }
+        case ForLoop: {
+            const auto forLoop = STMT_PTR(ForLoopStatement);
+            walkExpression(forLoop->start);
+            walkExpression(forLoop->end);
+            if (forLoop->step.has_value()) {
+                walkExpression(*forLoop->step);
+            }
+            Frame frame;
+            frame.declarations[forLoop->variable].push_back({ -1, true, false, nullptr });
+            if (forLoop->body->statementType() != BlockOfStatements) {
+                collect(forLoop->body, 0, true, frame);
+            }
+            frames.push_back(std::move(frame));
+            walkBody(forLoop->body);
+            frames.pop_back();
+            return;
+        }
+        case ForInLoop: {
+            const auto forIn = STMT_PTR(ForInLoopStatement);
+            walkExpression(forIn->collection);
+            Frame frame;
+            for (const auto &each : forIn->variables) {
+                frame.declarations[each].push_back({ -1, true, false, nullptr });
+            }
+            if (forIn->body->statementType() != BlockOfStatements) {
+                collect(forIn->body, 0, true, frame);
+            }
+            frames.push_back(std::move(frame));
+            walkBody(forIn->body);
+            frames.pop_back();
+            return;
+        }
+        case WhileLoop: {
+            const auto whileLoop = STMT_PTR(WhileLoopStatement);
+            walkExpression(whileLoop->condition);
+            return walkBody(whileLoop->body);
+        }
+        case IfElse: {
+            const auto ifElse = STMT_PTR(IfElseStatement);
+            walkExpression(ifElse->condition);
+            walkBody(ifElse->mainClause);
+            if (ifElse->elseClause.has_value()) {
+                walkBody(*ifElse->elseClause);
+            }
+            return;
+        }
+        case Match: {
+            const auto match = STMT_PTR(MatchStatement);
+            walkExpression(match->subject);
+            for (auto &[values, body] : match->cases) {
+                walkBody(body);
+            }
+            if (match->elseClause.has_value()) {
+                walkBody(*match->elseClause);
+            }
+            return;
+        }
+        case ReturnOperator: {
+            const auto returnOp = STMT_PTR(ReturnOperatorStatement);
+            if (returnOp->expression.has_value()) {
+                walkExpression(*returnOp->expression);
+            }
+            return;
+        }
+        case Yield:
+            return walkExpression(STMT_PTR(YieldStatement)->expression);
+        case BareExpression:
+            return walkExpression(STMT_PTR(ExpressionStatement)->expression);
+        case Echo:
+            return walkExpression(STMT_PTR(EchoStatement)->expression);
+        case BlockOfStatements:
+            return walkSequence(STMT_PTR(BlockStatement)->statements);
+        default:
+            return;
+    }
+    #undef STMT_PTR
+}
+
+// parameters are declared before anything of the function runs
+void Constants::walkFunction(std::vector<ExpressionPtr> &parameters, StatementPtr &body) {
+    Frame frame;
+    std::vector<ExpressionPtr*> defaults;
+    for (const auto &param : parameters) {
+        if (param->expressionType() == Expression::ExpressionType::Variable) {
+            frame.declarations[static_cast<VariableExpression*>(param.get())->name].push_back({ -1, true, false, nullptr });
+            continue;
+        }
+        if (param->expressionType() != Expression::ExpressionType::BinaryOperation) continue;
+        const auto binOp = static_cast<BinaryOperationExpression*>(param.get());
+        if (binOp->opcode == Operator::Assign && binOp->left->expressionType() == Expression::ExpressionType::Variable) {
+            frame.declarations[static_cast<VariableExpression*>(binOp->left.get())->name].push_back({ -1, true, false, nullptr });
+            defaults.push_back(&binOp->right);
+        }
+    }
+    frames.push_back(std::move(frame));
+    for (const auto each : defaults) {
+        walkExpression(*each);
+    }
+    walkBody(body);
+    frames.pop_back();
+}
+
+// EXPRESSIONS
+
+void Constants::walkExpression(ExpressionPtr &expression) {
+    #define EXPR_PTR(TYPE) static_cast<TYPE*>(expression.get())
+    using enum Expression::ExpressionType;
+    switch (expression->expressionType()) {
+        case Variable: {
+            if (!propagating) return;
+            if (const auto literal = lookup(EXPR_PTR(VariableExpression)->name).literal) {
+                expression = copyOf(literal, expression->position);
+                propagated = true;
+            }
+            return;
+        }
+        case BinaryOperation: {
+            const auto binary = EXPR_PTR(BinaryOperationExpression);
+            using enum Operator;
+            switch (binary->opcode) {
+                case Assign: case PlusAssign: case MinusAssign: case MultiplyAssign:
+                case DivideAssign: case PowerAssign:
+                    if (binary->left->expressionType() == Variable) {
+                        const auto &name = static_cast<VariableExpression*>(binary->left.get())->name;
+                        const auto found = lookup(name);
+                        if (!propagating && found.constant) {
+                            throw PropagatedException(binary->nodeLabel(), ConstantAssignmentException(name).what());
+                        }
+                        if (found.outermost) {
+                            outermostAssignments.try_emplace(name, binary->nodeLabel());
+                        }
+                        return walkExpression(binary->right);
+                    }
+                    break;
+                default:
+                    break;
+            }
+            walkExpression(binary->left);
+            walkExpression(binary->right);
+            return;
+        }
+        case PrefixOperation:
+            return walkExpression(EXPR_PTR(PrefixOperationExpression)->expression);
+        case Call: {
+            const auto call = EXPR_PTR(CallExpression);
+            walkExpression(call->target);
+            for (auto &each : call->arguments) {
+                walkExpression(each);
+            }
+            return;
+        }
+        case IndexAccess: {
+            const auto access = EXPR_PTR(IndexAccessExpression);
+            walkExpression(access->target);
+            walkExpression(access->index);
+            return;
+        }
+        case ArrayLiteral:
+            for (auto &each : EXPR_PTR(ArrayLiteralExpression)->values) {
+                walkExpression(each);
+            }
+            return;
+        case Interpolation:
+            for (auto &each : EXPR_PTR(InterpolationExpression)->parts) {
+                walkExpression(each);
+            }
+            return;
+        case Object:
+            for (auto &[key, value] : EXPR_PTR(ObjectExpression)->objectList) {
+                walkExpression(key);
+                walkExpression(value);
+            }
+            return;
+        case Lambda: {
+            const auto lambda = EXPR_PTR(LambdaExpression);
+            return walkFunction(lambda->parameters, lambda->body);
+        }
+        default:
+            return;
+    }
+    #undef EXPR_PTR
+}
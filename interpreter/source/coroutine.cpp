@@ -0,0 +1,279 @@
+#include "coroutine.h"
+#include "except.h"
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__SANITIZE_ADDRESS__)
+#define ANNOTATED_STACKS
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define ANNOTATED_STACKS
+#endif
+#endif
+
+#ifdef ANNOTATED_STACKS
+#include <sanitizer/asan_interface.h>
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+using namespace interpreter;
+
+#if defined(__x86_64__)
+// Saves the registers a call has to preserve on the stack being left,
+// its stack pointer in *save, and returns on the stack of load. A stack
+// that has not run yet is laid out to return into coroutineStart,
+// which calls the function in r13 with the pointer in r12
+extern "C" void coroutineSwitch(void** save, void* load);
+extern "C" void coroutineStart();
+asm(R"(
+    .text
+    .p2align 4
+    .globl coroutineSwitch
+    .hidden coroutineSwitch
+    .type coroutineSwitch, @function
+coroutineSwitch:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size coroutineSwitch, .-coroutineSwitch
+
+    .p2align 4
+    .globl coroutineStart
+    .hidden coroutineStart
+    .type coroutineStart, @function
+coroutineStart:
+    .cfi_startproc
+    .cfi_undefined rip
+    movq %r12, %rdi
+    callq *%r13
+    ud2
+    .cfi_endproc
+    .size coroutineStart, .-coroutineStart
+)");
+#endif
+
+// without the bounds of the stack being switched to, AddressSanitizer
+// takes the frames of one stack for an overflow of the other
+static void startSwitch(void** fakeStack, const void* bottom, size_t size) {
+#ifdef ANNOTATED_STACKS
+    __sanitizer_start_switch_fiber(fakeStack, bottom, size);
+#else
+    (void) fakeStack, (void) bottom, (void) size;
+#endif
+}
+
+static void finishSwitch(void* fakeStack, const void** bottom, size_t* size) {
+#ifdef ANNOTATED_STACKS
+    __sanitizer_finish_switch_fiber(fakeStack, bottom, size);
+#else
+    (void) fakeStack, (void) bottom, (void) size;
+#endif
+}
+
+// frames left on a stack for good stay poisoned otherwise, and
+// would fault the next coroutine given the same stack
+static void abandonFrames() {
+#ifdef ANNOTATED_STACKS
+    __asan_handle_no_return();
+#endif
+}
+
+struct SpareStack {
+    void* stack;
+    size_t size;
+};
+
+static thread_local std::vector<SpareStack> spareStacks;
+
+thread_local Coroutine* Coroutine::current = nullptr;
+
+Coroutine::Coroutine(std::function<void(Coroutine&)> body, size_t stackSize)
+    : body(std::move(body)), stack(nullptr), stackSize(stackSize), resumer(nullptr), context(), caller(),
+      callerStack(nullptr), callerStackSize(0), callerFakeStack(nullptr), bodyFakeStack(nullptr),
+      started(false), finished(false), cancelled(false) {}
+
+Coroutine::~Coroutine() {
+    if (started && !finished) {
+        cancelled = true;
+        switchIn();
+    }
+    if (stack != nullptr) {
+        releaseStack(stack, stackSize);
+    }
+}
+
+// the lowest page stays inaccessible, an overflow faults
+// instead of writing over whatever lies below the stack
+void* Coroutine::allocateStack(size_t size) {
+    for (auto it = spareStacks.rbegin(); it != spareStacks.rend(); ++it) {
+        if (it->size != size) continue;
+        const auto stack = it->stack;
+        spareStacks.erase(std::next(it).base());
+        return stack;
+    }
+    const auto stack = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (stack == MAP_FAILED) {
+        throw exceptions::InternalException("cannot allocate the stack of a coroutine");
+    }
+    mprotect(stack, static_cast<size_t>(sysconf(_SC_PAGESIZE)), PROT_NONE);
+    return stack;
+}
+
+void Coroutine::releaseStack(void* stack, size_t size) {
+    if (spareStacks.size() < SPARE_STACKS) {
+        spareStacks.push_back({ stack, size });
+    } else {
+        munmap(stack, size);
+    }
+}
+
+// lowest address of the stack of the thread, 0 if it cannot be told
+std::uintptr_t Coroutine::threadStackLimit() {
+    static thread_local std::optional<std::uintptr_t> limit;
+    if (limit.has_value()) return *limit;
+    limit = 0;
+    pthread_attr_t attributes;
+    if (pthread_getattr_np(pthread_self(), &attributes) != 0) return 0;
+    void* address;
+    size_t size;
+    if (pthread_attr_getstack(&attributes, &address, &size) == 0) {
+        limit = reinterpret_cast<std::uintptr_t>(address);
+    }
+    pthread_attr_destroy(&attributes);
+    return *limit;
+}
+
+void Coroutine::entry(Coroutine* self) {
+    finishSwitch(nullptr, &self->callerStack, &self->callerStackSize);
+    try {
+        self->body(*self);
+    } catch (const Cancelled&) {
+    } catch (...) {
+        if (!self->cancelled) {
+            self->exception = std::current_exception();
+        }
+    }
+    self->finished = true;
+    // returning would end the thread, the caller is resumed instead
+    abandonFrames();
+    startSwitch(nullptr, self->callerStack, self->callerStackSize);
+    transfer(self->context, self->caller);
+    __builtin_unreachable();
+}
+
+// the pointer is split in two
+void Coroutine::entryParts(unsigned high, unsigned low) {
+    const auto address = (static_cast<std::uintptr_t>(high) << 32) | low;
+    entry(reinterpret_cast<Coroutine*>(address));
+}
+
+void Coroutine::transfer(Context &save, Context &load) {
+#if defined(__x86_64__)
+    coroutineSwitch(&save, load);
+#else
+    if (swapcontext(&save, &load) != 0) {
+        throw exceptions::InternalException("cannot switch to a coroutine");
+    }
+#endif
+}
+
+// the body is entered by the first switch to the stack
+void Coroutine::prepare() {
+    stack = allocateStack(stackSize);
+#if defined(__x86_64__)
+    // what coroutineSwitch pops: control words of SSE (default
+    // mask, round to nearest) and x87 (extended precision), r15,
+    // r14, r13 with the function, r12 with its argument, rbx, rbp
+    // and the return address. The stack is aligned once it returns
+    const auto top = (reinterpret_cast<std::uintptr_t>(stack) + stackSize) & ~std::uintptr_t(15);
+    const auto frame = reinterpret_cast<std::uint64_t*>(top) - 8;
+    frame[0] = 0x1F80 | (std::uint64_t(0x037F) << 32);
+    frame[1] = 0;
+    frame[2] = 0;
+    frame[3] = reinterpret_cast<std::uint64_t>(&Coroutine::entry);
+    frame[4] = reinterpret_cast<std::uint64_t>(this);
+    frame[5] = 0;
+    frame[6] = 0;
+    frame[7] = reinterpret_cast<std::uint64_t>(&coroutineStart);
+    context = frame;
+#else
+    getcontext(&context);
+    context.uc_stack.ss_sp = stack;
+    context.uc_stack.ss_size = stackSize;
+    context.uc_link = nullptr;
+    const auto address = reinterpret_cast<std::uintptr_t>(this);
+    makecontext(&context, reinterpret_cast<void (*)()>(&Coroutine::entryParts), 2,
+        static_cast<unsigned>(address >> 32), static_cast<unsigned>(address));
+#endif
+}
+
+void Coroutine::switchIn() {
+    resumer = current;
+    current = this;
+    startSwitch(&callerFakeStack, stack, stackSize);
+    started = true;
+    transfer(caller, context);
+    finishSwitch(callerFakeStack, nullptr, nullptr);
+    current = resumer;
+}
+
+void Coroutine::resume() {
+    if (finished) return;
+    if (!started) {
+        prepare();
+    }
+    switchIn();
+    if (exception) {
+        std::rethrow_exception(std::exchange(exception, nullptr));
+    }
+}
+
+void Coroutine::suspend() {
+    startSwitch(&bodyFakeStack, callerStack, callerStackSize);
+    transfer(context, caller);
+    finishSwitch(bodyFakeStack, &callerStack, &callerStackSize);
+    if (cancelled) {
+        throw Cancelled();
+    }
+}
+
+bool Coroutine::done() const {
+    return finished;
+}
+
+bool Coroutine::inside() {
+    return current != nullptr;
+}
+
+bool Coroutine::exhausted(size_t reserve) {
+    // the lowest page of a coroutine stack is the inaccessible one
+    static const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const auto frame = reinterpret_cast<std::uintptr_t>(__builtin_frame_address(0));
+    const auto limit = current != nullptr
+        ? reinterpret_cast<std::uintptr_t>(current->stack) + page
+        : threadStackLimit();
+    return frame < limit + reserve;
+}
@@ -0,0 +1,104 @@
+#include "dispatch.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace interpreter;
+using namespace interpreter::types;
+
+// the same value has to hash the same way wherever it comes from
+static long double normalized(long double value) {
+    return value == 0 ? 0.0L : value;
+}
+
+static bool isInteger(long double value) {
+    return std::isfinite(value) && std::fabs(value) < 1e15L && std::trunc(value) == value;
+}
+
+DispatchTable::DispatchTable(const MatchStatement::CaseList &cases)
+    : trueArm(cases.size()), falseArm(cases.size()), nilArm(cases.size()), otherwise(cases.size()) {
+    std::vector<std::tuple<long double, size_t>> numberCases;
+    for (size_t arm = 0; arm < cases.size(); arm++) {
+        for (const auto &value : std::get<0>(cases[arm])) {
+            using enum Expression::ExpressionType;
+            // a value listed by an earlier case keeps its arm
+            switch (value->expressionType()) {
+                case NumberLiteral: {
+                    const auto number = static_cast<NumberLiteralExpression*>(value.get())->value;
+                    if (!std::isnan(number)) {
+                        numberCases.emplace_back(normalized(number), arm);
+                    }
+                    break;
+                }
+                case StringLiteral:
+                    strings.emplace(static_cast<StringLiteralExpression*>(value.get())->value, arm);
+                    break;
+                case BooleanLiteral: {
+                    auto &slot = static_cast<BooleanLiteralExpression*>(value.get())->value ? trueArm : falseArm;
+                    slot = std::min(slot, arm);
+                    break;
+                }
+                case NilLiteral:
+                    nilArm = std::min(nilArm, arm);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    layOutNumbers(numberCases);
+}
+
+// integers go to the dense table when they are packed closely
+// enough, the rest of the numbers are hashed
+void DispatchTable::layOutNumbers(const std::vector<std::tuple<long double, size_t>> &cases) {
+    long long low = 0, high = 0, integers = 0;
+    for (const auto &[number, arm] : cases) {
+        if (!isInteger(number)) continue;
+        const auto integer = static_cast<long long>(number);
+        low = integers == 0 ? integer : std::min(low, integer);
+        high = integers == 0 ? integer : std::max(high, integer);
+        integers++;
+    }
+    const auto span = high - low + 1;
+    const auto useDense = integers > 0 && span <= MAX_DENSE && span <= DENSITY * integers;
+    if (useDense) {
+        denseBase = low;
+        dense.assign(span, otherwise);
+    }
+    for (const auto &[number, arm] : cases) {
+        if (useDense && isInteger(number)) {
+            auto &slot = dense[static_cast<long long>(number) - denseBase];
+            slot = std::min(slot, arm);
+        } else {
+            numbers.emplace(number, arm);
+        }
+    }
+}
+
+size_t DispatchTable::lookup(const SharedValue &subject) const {
+    switch (subject->dataType()) {
+        case NumberType: {
+            const auto number = static_cast<NumberValue*>(subject.get())->value;
+            if (!dense.empty() && isInteger(number)) {
+                const auto index = static_cast<long long>(number) - denseBase;
+                if (index >= 0 && index < static_cast<long long>(dense.size())) {
+                    return dense[index];
+                }
+                return otherwise;
+            }
+            if (numbers.empty() || std::isnan(number)) return otherwise;
+            const auto found = numbers.find(normalized(number));
+            return found != numbers.end() ? found->second : otherwise;
+        }
+        case StringType: {
+            const auto found = strings.find(static_cast<StringValue*>(subject.get())->value);
+            return found != strings.end() ? found->second : otherwise;
+        }
+        case BooleanType:
+            return static_cast<BooleanValue*>(subject.get())->value ? trueArm : falseArm;
+        case NilType:
+            return nilArm;
+        default:
+            return otherwise;
+    }
+}
@@ -0,0 +1,134 @@
+#include "inliner.h"
+#include "resolver.h"
+#include <algorithm>
+#include <functional>
+
+using namespace interpreter;
+
+using Predicate = std::function<bool(const Expression*)>;
+
+// whether the predicate holds for the expression or any nested one
+static bool anyNode(const ExpressionPtr &expression, const Predicate &predicate) {
+    #define EXPR_PTR(TYPE) static_cast<TYPE*>(expression.get())
+    if (predicate(expression.get())) return true;
+    const auto anyOf = [&](const std::vector<ExpressionPtr> &expressions) {
+        return std::ranges::any_of(expressions, [&](const auto &each) { return anyNode(each, predicate); });
+    };
+    using enum Expression::ExpressionType;
+    switch (expression->expressionType()) {
+        case BinaryOperation: {
+            const auto binary = EXPR_PTR(BinaryOperationExpression);
+            return anyNode(binary->left, predicate) || anyNode(binary->right, predicate);
+        }
+        case PrefixOperation:
+            return anyNode(EXPR_PTR(PrefixOperationExpression)->expression, predicate);
+        case Call: {
+            const auto call = EXPR_PTR(CallExpression);
+            return anyNode(call->target, predicate) || anyOf(call->arguments);
+        }
+        case IndexAccess: {
+            const auto access = EXPR_PTR(IndexAccessExpression);
+            return anyNode(access->target, predicate) || anyNode(access->index, predicate);
+        }
+        case ArrayLiteral:
+            return anyOf(EXPR_PTR(ArrayLiteralExpression)->values);
+        case Interpolation:
+            return anyOf(EXPR_PTR(InterpolationExpression)->parts);
+        case Object:
+            return std::ranges::any_of(EXPR_PTR(ObjectExpression)->objectList, [&](const auto &pair) {
+                return anyNode(std::get<0>(pair), predicate) || anyNode(std::get<1>(pair), predicate);
+            });
+        default:
+            return false;
+    }
+    #undef EXPR_PTR
+}
+
+static bool isVariable(const ExpressionPtr &expression, const std::string &name) {
+    return expression->expressionType() == Expression::ExpressionType::Variable
+        && static_cast<VariableExpression*>(expression.get())->name == name;
+}
+
+// nodes that need a scope of their own or change variables
+static bool unsupported(const Expression* expression) {
+    using enum Expression::ExpressionType;
+    switch (expression->expressionType()) {
+        case Lambda:
+        case ExpressionError:
+            return true;
+        case BinaryOperation: {
+            using enum Operator;
+            switch (static_cast<const BinaryOperationExpression*>(expression)->opcode) {
+                case Assign: case PlusAssign: case MinusAssign: case MultiplyAssign:
+                case DivideAssign: case PowerAssign: case Unknown:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+        default:
+            return false;
+    }
+}
+
+const ExpressionPtr* inliner::inlinable(const FunctionDeclarationStatement *function, const Options &options) {
+    if (options.optimizationLevel == 0 || options.inlineBudget == 0) return nullptr;
+    if (function->body->statementType() != Statement::StatementType::BlockOfStatements) return nullptr;
+    const auto &statements = static_cast<BlockStatement*>(function->body.get())->statements;
+    if (statements.size() != 1) return nullptr;
+    if (statements[0]->statementType() != Statement::StatementType::ReturnOperator) return nullptr;
+    const auto &returned = static_cast<ReturnOperatorStatement*>(statements[0].get())->expression;
+    if (!returned.has_value()) return nullptr;
+
+    std::vector<std::string> names;
+    for (const auto &param : function->parameters) {
+        if (param->expressionType() != Expression::ExpressionType::Variable) return nullptr;
+        const auto &name = static_cast<VariableExpression*>(param.get())->name;
+        if (std::ranges::find(names, name) != names.end()) return nullptr;
+        names.push_back(name);
+    }
+
+    // a returned call replaces the frame, which shows in traces
+    if (options.tailCalls && (*returned)->expressionType() == Expression::ExpressionType::Call) return nullptr;
+    if (size(*returned) > options.inlineBudget) return nullptr;
+    if (anyNode(*returned, unsupported)) return nullptr;
+    if (Resolver::mentions(*returned, function->name)) return nullptr;
+    return &*returned;
+}
+
+size_t inliner::size(const ExpressionPtr &expression) {
+    size_t nodes = 0;
+    anyNode(expression, [&](const Expression*) {
+        nodes++;
+        return false;
+    });
+    return nodes;
+}
+
+bool inliner::copiesArgument(const ExpressionPtr &expression, const std::string &parameter) {
+    // calls may change the argument in place through the variable it came from,
+    // and equality tells a NaN argument apart from its copy
+    const auto observes = anyNode(expression, [](const Expression* each) {
+        using enum Expression::ExpressionType;
+        if (each->expressionType() == Call) return true;
+        if (each->expressionType() != BinaryOperation) return false;
+        const auto opcode = static_cast<const BinaryOperationExpression*>(each)->opcode;
+        return opcode == Operator::Equal || opcode == Operator::NotEqual;
+    });
+    if (observes || isVariable(expression, parameter)) return true;
+    // operators make new values, literals of arrays and objects keep them
+    return anyNode(expression, [&](const Expression* each) {
+        using enum Expression::ExpressionType;
+        if (each->expressionType() == ArrayLiteral) {
+            return std::ranges::any_of(static_cast<const ArrayLiteralExpression*>(each)->values, [&](const auto &value) {
+                return isVariable(value, parameter);
+            });
+        }
+        if (each->expressionType() == Object) {
+            return std::ranges::any_of(static_cast<const ObjectExpression*>(each)->objectList, [&](const auto &pair) {
+                return isVariable(std::get<0>(pair), parameter) || isVariable(std::get<1>(pair), parameter);
+            });
+        }
+        return false;
+    });
+}
@@ -2,6 +2,15 @@
 #include "except.h"
 #include "utils/utils.h"
 #include "prelude.h"
+#include "operators.h"
+#include "optimizer.h"
+#include "constants.h"
+#include "dispatch.h"
+#include "inliner.h"
+#include "jit/compiler.h"
+#include "profiles.h"
+#include "aot/modules.h"
+#include "coroutine.h"
 #include "parser/parser.h"
 #include <fstream>
 #include <set>
@@ -12,13 +21,23 @@ using namespace interpreter;
 using namespace interpreter::exceptions;
 using namespace interpreter::types;
 
-Interpreter::Interpreter(std::string filename, const Storage& initialStorage)
+Interpreter::Interpreter(std::string filename, const Storage& initialStorage, const Options& options)
     : filename(std::move(filename)),
+      options(options),
+      maxCallDepth(options.maxCallDepth.value_or(Options::DEFAULT_MAX_CALL_DEPTH)),
+      callDepth(0),
       flowRegister(FlowFlag::SequentialFlow),
       returnRegister(std::nullopt),
+      tailCallRegister(std::nullopt),
+      inlinedBase(0),
+      generator(nullptr),
       fatalError(std::nullopt),
       importedASTs() {
     scope = LexicalScope::create();
+    globals = scope;
+    for (const auto &[key, value] : prelude::getConstants()) {
+        scope->initVariable(key, std::make_shared<NumberValue>(value));
+    }
     for (const auto &[key, value] : prelude::getPrelude()) {
         scope->initVariable(key, value);
     }
@@ -27,7 +46,78 @@ Interpreter::Interpreter(std::string filename, const Storage& initialStorage)
     }
 }
 
-std::vector<ProgramPtr>& Interpreter::getImportedASTs() {
+// closures made by the body are entered from the
+// scope the function was made in, like the function itself
+Interpreter::Interpreter(const FunctionalObject* function, SharedScope scope, const Options& options, Generator* generator)
+    : filename(function->filename),
+      options(options),
+      maxCallDepth(options.maxCallDepth.value_or(Options::DEFAULT_MAX_CALL_DEPTH)),
+      callDepth(0),
+      scope(std::move(scope)),
+      globals(function->scope),
+      flowRegister(FlowFlag::SequentialFlow),
+      returnRegister(std::nullopt),
+      tailCallRegister(std::nullopt),
+      inlinedBase(0),
+      generator(generator),
+      fatalError(std::nullopt),
+      importedASTs() {}
+
+// The body runs on a coroutine with an engine of its own, so
+// suspending it leaves the registers and the native stack of
+// the engine resuming it as they are
+struct Interpreter::Generator {
+    // the body has to outlive its suspended call
+    std::shared_ptr<const Node> tree;
+    Interpreter engine;
+    Coroutine coroutine;
+    SharedValue yielded;
+    bool running;
+
+    Generator(const FunctionalObject* function, SharedScope scope, const Options &options)
+        : tree(function->tree),
+          engine(function, std::move(scope), options, this),
+          coroutine([this, &compiled = compiledFunction(function->body)](Coroutine&) { run(compiled); }, PROGRAM_STACK_SIZE),
+          running(false) {}
+
+    // as the end of a call, except that the value returned is dropped
+    void run(const CompiledFunction &compiled) {
+        compiled.body(engine);
+        if (engine.tailCallRegister.has_value()) {
+            auto tailCall = std::move(*engine.tailCallRegister);
+            engine.tailCallRegister = std::nullopt;
+            const auto tailFunction = static_cast<FunctionalObject*>(tailCall.function.get());
+            engine.callFunction(tailFunction, tailCall.arguments);
+        }
+        if (engine.flowRegister != FlowFlag::ReturnValue && engine.flowRegister != FlowFlag::SequentialFlow) {
+            throw MisplacedFlowOperator(flowFlagToString(engine.flowRegister));
+        }
+    }
+
+    bool resume(SharedValue &value) {
+        if (coroutine.done()) return false;
+        if (running) throw GeneratorRunningException();
+        running = true;
+        try {
+            coroutine.resume();
+        } catch (...) {
+            running = false;
+            std::string description = "unknown runtime exception";
+            try {
+                throw;
+            } catch (const RuntimeException &exception) {
+                description = std::string(exception.what());
+            } catch (...) {}
+            throw PropagatedException("calling a function from file \"" + engine.filename + "\"", description);
+        }
+        running = false;
+        if (coroutine.done()) return false;
+        value = std::move(yielded);
+        return true;
+    }
+};
+
+std::vector<std::shared_ptr<Program>>& Interpreter::getImportedASTs() {
     return importedASTs;
 }
 
@@ -43,12 +133,32 @@ std::string Interpreter::flowFlagToString(FlowFlag flag) {
         case ContinueLoop:   return "loop continue";
         case ReturnValue:    return "return value";
     }
+    throw InternalException("unknown flow flag");
 }
 
 void Interpreter::executeProgram(Program &program) {
+    execute(program, {});
+}
+
+void Interpreter::executeStreamed(const std::shared_ptr<Program> &program) {
+    execute(*program, program);
+}
+
+// a program imported or run by a generator is on such a stack already
+void Interpreter::execute(Program &program, const std::weak_ptr<const Node> &tree) {
+    if (!Coroutine::inside()) {
+        try {
+            Coroutine coroutine([&](Coroutine&) { execute(program, tree); }, PROGRAM_STACK_SIZE);
+            coroutine.resume();
+        } catch (const RuntimeException &exception) {
+            fatalError = exception.what();
+        }
+        return;
+    }
     try {
-        for (const auto &statement : program.statements) {
-            executeStatement(statement);
+        const auto &compiled = compileProgram(program, filename, options, tree);
+        for (const auto &statement : compiled.statements) {
+            statement(*this);
             if (flowRegister != FlowFlag::SequentialFlow) {
                 const auto opName = flowFlagToString(flowRegister);
                 throw MisplacedFlowOperator(opName);
@@ -67,8 +177,8 @@ const std::optional<std::string> &Interpreter::getFatalError() const {
     return fatalError;
 }
 
-void Interpreter::enterScope() {
-    auto next = LexicalScope::createInner(scope);
+void Interpreter::enterScope(const ScopeLayout* layout) {
+    auto next = LexicalScope::createInner(scope, layout);
     scope = next;
 }
 
@@ -79,7 +189,28 @@ void Interpreter::leaveScope() {
     scope = *scope->getParent();
 }
 
+// A closure does not keep its defining scope alive:
+// it holds the cells of the variables it uses from there
+SharedValue Interpreter::createClosure(const std::vector<ExpressionPtr> &parameters, const StatementPtr &body) {
+    const auto &compiled = compiledFunction(body);
+    const auto &layout = compiled.captures;
+    std::shared_ptr<Captures> captures;
+    if (!layout.sources.empty()) {
+        captures = std::make_shared<Captures>(&layout);
+        captures->cells.reserve(layout.sources.size());
+        for (const auto &source : layout.sources) {
+            captures->cells.push_back(scope->getCell(source));
+        }
+    }
+    return std::make_shared<FunctionalObject>(filename, parameters, body, globals, std::move(captures), compiled.tree.lock());
+}
+
+
 #define CATCH_PROPAGATE(NODE)                                           \
+    catch (PropagatedException &exception) {                            \
+        exception.enclose(NODE->nodeLabel());                           \
+        throw;                                                          \
+    }                                                                   \
     catch (...) {                                                       \
         const auto currentExpression = std::current_exception();        \
         std::string description = "unknown runtime exception";          \
@@ -91,406 +222,1018 @@ void Interpreter::leaveScope() {
         throw PropagatedException(NODE->nodeLabel(), description);      \
     }
 
-void Interpreter::executeStatement(const StatementPtr &statement) {
-    #define STMT_PTR(TYPE) static_cast<TYPE*>(statement.get())
-    try {
-        using enum Statement::StatementType;
-        switch(statement->statementType()) {
-            case LibraryImport:
-                return executeLibraryImport      (STMT_PTR(ImportLibraryStatement       ));
-            case VariableDeclaration:
-                return executeVariableDeclaration(STMT_PTR(VariableDeclarationStatement ));
-            case FunctionDeclaration:
-                return executeFunctionDeclaration(STMT_PTR(FunctionDeclarationStatement ));
-            case ForLoop:
-                return executeForLoop            (STMT_PTR(ForLoopStatement             ));
-            case WhileLoop:
-                return executeWhileLoop          (STMT_PTR(WhileLoopStatement           ));
-            case IfElse:
-                return executeIfElse             (STMT_PTR(IfElseStatement              ));
-            case ContinueOperator:
-                return executeContinue();
-            case BreakOperator:
-                return executeBreak();
-            case ReturnOperator:
-                return executeReturn             (STMT_PTR(ReturnOperatorStatement      ));
-            case BlockOfStatements:
-                return executeBlock              (STMT_PTR(BlockStatement               ));
-            case BareExpression:
-                return executeBareExpression     (STMT_PTR(ExpressionStatement          ));
-            case Echo:
-                return executeEcho               (STMT_PTR(EchoStatement                ));
-            case StatementError:
-                throw ErrorNodeException();
+// Wraps the body of a closure so that exceptions
+// leaving it are labeled with the node it was compiled from
+template <typename Body>
+static auto guarded(const Node* node, Body body) {
+    return [node, body = std::move(body)](Interpreter &self) mutable -> std::invoke_result_t<Body&, Interpreter&> {
+        try {
+            return body(self);
+        } CATCH_PROPAGATE(node)
+    };
+}
+
+// LOAD TIME
+
+const CompiledProgram& Interpreter::compileProgram (
+    Program &program,
+    const std::string &filename,
+    const Options &options,
+    const std::weak_ptr<const Node> &tree
+) {
+    if (!program.runtimeData) {
+        Constants::check(program);
+        auto compiled = std::make_shared<CompiledProgram>();
+        const auto profile = profiles::source(filename);
+        const auto feedback = profile ? profile->site(profiles::SiteKind::Unit, &program, program.position) : nullptr;
+        compiled->unit.start(program.nodeLabel(), options.tierThreshold, feedback);
+        Resolver resolver(options, &compiled->unit, profile, tree);
+        resolver.collectInlinable(program.statements);
+        for (const auto &statement : program.statements) {
+            compiled->statements.push_back(compileStatement(statement, resolver));
         }
-    } CATCH_PROPAGATE(statement)
+        program.runtimeData = compiled;
+    }
+    return static_cast<const CompiledProgram&>(*program.runtimeData);
+}
+
+const CompiledFunction& Interpreter::compileFunction (
+    const Node* node,
+    const std::vector<ExpressionPtr> &parameters,
+    const StatementPtr &body,
+    Resolver &resolver
+) {
+    if (!body->runtimeData) {
+        auto compiled = std::make_shared<CompiledFunction>();
+        const auto feedback = resolver.feedback(profiles::SiteKind::Unit, node, body->position);
+        compiled->unit.start(node->nodeLabel(), resolver.getOptions().tierThreshold, feedback);
+        std::vector<const ExpressionPtr*> defaults;
+        for (const auto &param : parameters) {
+            using enum CompiledParameter::Kind;
+            if (param->expressionType() == Variable) {
+                const auto variablePointer = static_cast<VariableExpression*>(param.get());
+                compiled->parameters.push_back({ Required, variablePointer->name });
+                defaults.push_back(nullptr);
+                continue;
+            }
+            if (param->expressionType() == BinaryOperation) {
+                const auto binOp = static_cast<BinaryOperationExpression*>(param.get());
+                if ((binOp->opcode == Operator::Assign) && (binOp->left->expressionType() == Variable)) {
+                    const auto variablePointer = static_cast<VariableExpression*>(binOp->left.get());
+                    compiled->parameters.push_back({ WithDefault, variablePointer->name });
+                    defaults.push_back(&binOp->right);
+                    continue;
+                }
+            }
+            compiled->parameters.push_back({ WrongFormat, "" });
+            defaults.push_back(nullptr);
+        }
+
+        // errors are not raised here: a call has to fail
+        // only after evaluating defaults preceding the broken parameter
+        std::vector<std::string> names;
+        compiled->minimumArguments = 0;
+        for (size_t i = 0; i < compiled->parameters.size(); i++) {
+            using enum CompiledParameter::Kind;
+            auto &param = compiled->parameters[i];
+            if (param.kind == WrongFormat) continue;
+            if (std::find(names.begin(), names.end(), param.name) != names.end()) {
+                param.kind = Duplicate;
+                continue;
+            }
+            names.push_back(param.name);
+            if (param.kind == Required) {
+                compiled->minimumArguments = i + 1;
+            }
+        }
+        compiled->layout = Resolver::parametersLayout(names, body);
+
+        resolver.enterFunction(compiled->layout, compiled->captures, compiled->unit);
+        for (size_t i = 0; i < compiled->parameters.size(); i++) {
+            auto &param = compiled->parameters[i];
+            if (param.kind == CompiledParameter::Kind::WrongFormat) continue;
+            if (param.kind == CompiledParameter::Kind::Duplicate) continue;
+            param.slot = resolver.declare(param.name);
+            if (defaults[i] != nullptr) {
+                param.defaultValue = compileExpression(*defaults[i], resolver);
+            }
+        }
+        compiled->body = compileStatement(body, resolver);
+        compiled->generator = Resolver::yields(body);
+        compiled->tree = resolver.getTree();
+        resolver.leaveFunction();
+
+        body->runtimeData = compiled;
+    }
+    return compiledFunction(body);
+}
+
+const CompiledFunction& Interpreter::compiledFunction(const StatementPtr &body) {
+    if (!body->runtimeData) {
+        throw InternalException("calling a function that was not compiled");
+    }
+    return static_cast<const CompiledFunction&>(*body->runtimeData);
 }
 
 // STATEMENTS
 
-void Interpreter::executeLibraryImport(const parser::AST::ImportLibraryStatement *import) {
-    const auto localName = import->libName + ".toy";
-    std::ifstream filestream(localName);
-    if (filestream.bad() || !filestream.is_open()) {
-        throw FileImportFailedException(localName);
+StatementClosure Interpreter::compileStatement(const StatementPtr &statement, Resolver &resolver) {
+    #define STMT_PTR(TYPE) static_cast<TYPE*>(statement.get())
+    using enum Statement::StatementType;
+    switch(statement->statementType()) {
+        case LibraryImport:
+            return compileLibraryImport      (STMT_PTR(ImportLibraryStatement       ), resolver);
+        case VariableDeclaration:
+            return compileVariableDeclaration(STMT_PTR(VariableDeclarationStatement ), resolver);
+        case FunctionDeclaration:
+            return compileFunctionDeclaration(STMT_PTR(FunctionDeclarationStatement ), resolver);
+        case ForLoop:
+            return compileForLoop            (STMT_PTR(ForLoopStatement             ), resolver);
+        case ForInLoop:
+            return compileForInLoop          (STMT_PTR(ForInLoopStatement           ), resolver);
+        case WhileLoop:
+            return compileWhileLoop          (STMT_PTR(WhileLoopStatement           ), resolver);
+        case IfElse:
+            return compileIfElse             (STMT_PTR(IfElseStatement              ), resolver);
+        case Match:
+            return compileMatch              (STMT_PTR(MatchStatement               ), resolver);
+        case ContinueOperator:
+            return compileContinue           (STMT_PTR(ContinueOperatorStatement    ));
+        case BreakOperator:
+            return compileBreak              (STMT_PTR(BreakOperatorStatement       ));
+        case Yield:
+            return compileYield              (STMT_PTR(YieldStatement               ), resolver);
+        case ReturnOperator:
+            return compileReturn             (STMT_PTR(ReturnOperatorStatement      ), resolver);
+        case BlockOfStatements:
+            return compileBlock              (STMT_PTR(BlockStatement               ), resolver);
+        case BareExpression:
+            return compileBareExpression     (STMT_PTR(ExpressionStatement          ), resolver);
+        case Echo:
+            return compileEcho               (STMT_PTR(EchoStatement                ), resolver);
+        case StatementError:
+            return guarded(statement.get(), [](Interpreter&) {
+                throw ErrorNodeException();
+            });
     }
+    throw InternalException("statement cannot be compiled");
+}
+
+StatementClosure Interpreter::compileLibraryImport(const ImportLibraryStatement *import, Resolver &resolver) {
+    const auto slot = resolver.declare(import->alias.value_or(import->libName));
+    return guarded(import, [import, slot](Interpreter &self) {
+        self.executeLibraryImport(import, slot);
+    });
+}
 
-    auto _parser = parser::Parser(filestream);
-    auto programAST = _parser.readProgram();
-    if (!_parser.getErrors().empty()) {
-        const auto& errors = _parser.getErrors();
-        const auto errorString = utils::stringJoin(errors, "\n");
-        throw ImportParserException(localName, errorString);
+void Interpreter::executeLibraryImport(const parser::AST::ImportLibraryStatement *import, size_t slot) {
+    const auto localName = import->libName + ".toy";
+    auto programAST = aot::embeddedModule(localName);
+    if (!programAST) {
+        std::ifstream filestream(localName);
+        if (filestream.bad() || !filestream.is_open()) {
+            throw FileImportFailedException(localName);
+        }
+
+        auto _parser = parser::Parser(filestream);
+        programAST = _parser.readProgram();
+        if (!_parser.getErrors().empty()) {
+            const auto& errors = _parser.getErrors();
+            const auto errorString = utils::stringJoin(errors, "\n");
+            throw ImportParserException(localName, errorString);
+        }
+    }
+    if (options.optimizationLevel > 0) {
+        Optimizer::optimize(*programAST);
     }
 
-    auto _engine = interpreter::Interpreter(localName);
-    _engine.executeProgram(*programAST);
+    // functions of the module own its tree, so it outlives
+    // an engine that goes away first, the one of a generator
+    const std::shared_ptr<Program> module = std::move(programAST);
+    auto _engine = interpreter::Interpreter(localName, {}, options);
+    _engine.execute(*module, module);
     if (_engine.getFatalError().has_value()) {
         throw ImportEvalException(localName, _engine.getFatalError().value());
     }
 
-    importedASTs.push_back(std::move(programAST));
+    importedASTs.push_back(module);
     for (auto& each : _engine.getImportedASTs()) {
         importedASTs.push_back(std::move(each));
     }
 
     const auto exportObject = _engine.getScope()->getValue("exports");
-    if (import->alias.has_value()) {
-        scope->initVariable(import->alias.value(), exportObject);
-    } else {
-        scope->initVariable(import->libName, exportObject);
-    }
+    scope->initSlot(slot, import->alias.value_or(import->libName), exportObject);
 }
 
-void Interpreter::executeVariableDeclaration(const VariableDeclarationStatement *declaration) {
+StatementClosure Interpreter::compileVariableDeclaration(const VariableDeclarationStatement *declaration, Resolver &resolver) {
+    const auto slot = resolver.declare(declaration->name);
     if (declaration->value) {
-        const auto value = executeExpression(*declaration->value);
-        const auto copied = types::copyForAssignment(value);
-        scope->initVariable(declaration->name, copied);
-    } else {
-        scope->initVariable(declaration->name);
+        auto value = compileExpression(*declaration->value, resolver);
+        return guarded(declaration, [name = declaration->name, slot, value = std::move(value)](Interpreter &self) {
+            const auto copied = types::copyForAssignment(value(self));
+            self.scope->initSlot(slot, name, copied);
+        });
     }
+    return guarded(declaration, [name = declaration->name, slot](Interpreter &self) {
+        self.scope->initSlot(slot, name, NilValue::getInstance());
+    });
 }
 
-void Interpreter::executeFunctionDeclaration(const FunctionDeclarationStatement *fnNode) {
-    const auto fnObj =
-        std::make_shared<FunctionalObject> (
-            filename,
-            fnNode->parameters,
-            fnNode->body,
-            scope
-        );
-    scope->initVariable(fnNode->name, fnObj);
+StatementClosure Interpreter::compileFunctionDeclaration(const FunctionDeclarationStatement *fnNode, Resolver &resolver) {
+    const auto slot = resolver.declare(fnNode->name);
+    compileFunction(fnNode, fnNode->parameters, fnNode->body, resolver);
+    return guarded(fnNode, [fnNode, slot](Interpreter &self) {
+        const auto fnObj = self.createClosure(fnNode->parameters, fnNode->body);
+        self.scope->initSlot(slot, fnNode->name, fnObj);
+    });
 }
 
-#define LOOP_FLOW_CHECK                             \
-       using enum FlowFlag;                         \
-        if (flowRegister == BreakLoop) {            \
-            flowRegister = SequentialFlow;          \
-            break;                                  \
-        } else if (flowRegister == ContinueLoop) {  \
-            flowRegister = SequentialFlow;          \
-        } else if (flowRegister == ReturnValue) {   \
-            break;                                  \
+#define LOOP_FLOW_CHECK                                  \
+       using enum FlowFlag;                              \
+        if (self.flowRegister == BreakLoop) {            \
+            self.flowRegister = SequentialFlow;          \
+            break;                                       \
+        } else if (self.flowRegister == ContinueLoop) {  \
+            self.flowRegister = SequentialFlow;          \
+        } else if (self.flowRegister == ReturnValue) {   \
+            break;                                       \
         }
 
-void Interpreter::executeForLoop(const ForLoopStatement *forLoop) {
-    const auto start = executeExpression(forLoop->start);
-    const auto end   = executeExpression(forLoop->end);
-    const auto step  = forLoop->step.has_value()
-            ? executeExpression(*forLoop->step)
-            : std::make_shared<NumberValue>(1);
+StatementClosure Interpreter::compileForLoop(const ForLoopStatement *forLoop, Resolver &resolver) {
+    auto start = compileExpression(forLoop->start, resolver);
+    auto end   = compileExpression(forLoop->end, resolver);
+    auto step  = forLoop->step.has_value()
+            ? compileExpression(*forLoop->step, resolver)
+            : ExpressionClosure([](Interpreter&) -> SharedValue { return std::make_shared<NumberValue>(1); });
+    auto layout = Resolver::forLoopLayout(forLoop);
+    resolver.enterScope(layout);
+    const auto slot = resolver.declare(forLoop->variable);
+    auto body  = compileStatement(forLoop->body, resolver);
+    resolver.leaveScope();
+    // native code is compiled once the code around is hot
+    const auto unit = resolver.unit();
+    std::shared_ptr<jit::Region> region;
+    std::shared_ptr<Resolver> pending;
+    if (resolver.getOptions().jit && unit->promoted()) {
+        region = jit::Compiler::compileForLoop(forLoop, resolver);
+    } else if (resolver.getOptions().jit) {
+        pending = std::make_shared<Resolver>(resolver);
+    }
+    // otherwise the counter is kept unboxed
+    const auto observed = Resolver::mentions(forLoop->body, forLoop->variable);
+
+    return guarded(forLoop, [
+        forLoop, unit, layout = std::move(layout), slot, observed,
+        start = std::move(start), end = std::move(end), step = std::move(step),
+        body = std::move(body), region = std::move(region), pending = std::move(pending)
+    ](Interpreter &self) mutable {
+        const auto &variable = forLoop->variable;
+        const auto startObject = start(self);
+        const auto endObject   = end(self);
+        const auto stepObject  = step(self);
+
+        const auto startValue = getCastedPointer<NumberType, NumberValue>(startObject)->value;
+        const auto endValue = getCastedPointer<NumberType, NumberValue>(endObject)->value;
+        const auto stepValue = getCastedPointer<NumberType, NumberValue>(stepObject)->value;
+
+        if (stepValue == 0) {
+            throw ZeroStepException();
+        }
 
-    const auto startValue = getCastedPointer<NumberType, NumberValue>(start)->value;
-    const auto endValue = getCastedPointer<NumberType, NumberValue>(end)->value;
-    const auto stepValue = getCastedPointer<NumberType, NumberValue>(step)->value;
+        if (startValue < endValue && stepValue < 0) {
+            throw NegativeStepException();
+        }
 
-    if (stepValue == 0) {
-        throw ZeroStepException();
-    }
+        if (startValue > endValue && stepValue > 0) {
+            throw PositiveStepException();
+        }
 
-    if (startValue < endValue && stepValue < 0) {
-        throw NegativeStepException();
-    }
+        unit->expect((endValue - startValue) / stepValue);
+        if (pending && unit->promoted()) {
+            region = jit::Compiler::compileForLoop(forLoop, *pending);
+            pending.reset();
+        }
+        if (region && region->runFor(self.scope, startObject, endObject, stepObject)) {
+            return;
+        }
 
-    if (startValue > endValue && stepValue > 0) {
-        throw PositiveStepException();
-    }
+        // end and step are read on every iteration:
+        // the body may change their objects in place
+        const auto endNumber = static_cast<NumberValue*>(endObject.get());
+        const auto stepNumber = static_cast<NumberValue*>(stepObject.get());
+        self.enterScope(layout.get());
+
+        // a start object held elsewhere too can be changed in place
+        // through another name, so it has to become the first counter
+        if (!observed && startObject.use_count() == 1) {
+            auto counter = startValue;
+            while (true) {
+                const auto over = stepValue > 0 ? counter >= endNumber->value : counter <= endNumber->value;
+                if (over) break;
+                body(self);
+                LOOP_FLOW_CHECK
+                unit->iterate();
+                counter = counter + stepNumber->value;
+            }
+            self.leaveScope();
+            return;
+        }
 
-    enterScope();
-    scope->initVariable(forLoop->variable, start);
+        self.scope->initSlot(slot, variable, startObject);
+        while (true) {
+            const auto counter = self.scope->getValue({ 0, slot }, variable);
+            if (counter->dataType() == NumberType) {
+                const auto counterValue = static_cast<NumberValue*>(counter.get())->value;
+                const auto over = stepValue > 0 ? counterValue >= endNumber->value : counterValue <= endNumber->value;
+                if (over) break;
+            } else {
+                const auto result = stepValue > 0 ? *counter >= endObject : *counter <= endObject;
+                const auto booleanResult = static_cast<BooleanValue*>(result.get());
+                if (booleanResult->value) break;
+            }
+            body(self);
+            LOOP_FLOW_CHECK
+            unit->iterate();
+            auto nextCounter = counter->dataType() == NumberType
+                ? std::make_shared<NumberValue>(static_cast<NumberValue*>(counter.get())->value + stepNumber->value)
+                : *counter + stepObject;
+            self.scope->setValue({ 0, slot }, variable, nextCounter);
+        }
 
-    while (true) {
-        const auto counter = scope->getValue(forLoop->variable);
-        const auto result = stepValue > 0 ? *counter >= end : *counter <= end;
-        const auto booleanResult = static_cast<BooleanValue*>(result.get());
-        if (booleanResult->value) break;
-        executeStatement(forLoop->body);
-        LOOP_FLOW_CHECK
-        auto nextCounter = *counter + step;
-        scope->setValue(forLoop->variable, nextCounter);
+        self.leaveScope();
+    });
+}
+
+// the variables live in the scope of the loop and take
+// the next element on every iteration, like the counter of `for`
+StatementClosure Interpreter::compileForInLoop(const ForInLoopStatement *forIn, Resolver &resolver) {
+    auto collection = compileExpression(forIn->collection, resolver);
+    auto layout = Resolver::forInLoopLayout(forIn);
+    resolver.enterScope(layout);
+    std::vector<size_t> slots;
+    for (const auto &each : forIn->variables) {
+        slots.push_back(resolver.declare(each));
     }
+    auto body = compileStatement(forIn->body, resolver);
+    resolver.leaveScope();
+    const auto unit = resolver.unit();
+
+    return guarded(forIn, [
+        forIn, unit, layout = std::move(layout), slots = std::move(slots),
+        collection = std::move(collection), body = std::move(body)
+    ](Interpreter &self) {
+        const auto &variables = forIn->variables;
+        IteratorValue iterator(collection(self));
+        const auto paired = variables.size() == 2;
+        const auto keyed = paired || iterator.keyed();
+        SharedValue key, element;
+        self.enterScope(layout.get());
+        for (size_t i = 0; i < slots.size(); i++) {
+            self.scope->initSlot(slots[i], variables[i], NilValue::getInstance());
+        }
+        while (iterator.next(keyed ? &key : nullptr, keyed && !paired ? nullptr : &element)) {
+            if (paired) {
+                self.scope->setValue({ 0, slots[0] }, variables[0], key);
+                self.scope->setValue({ 0, slots[1] }, variables[1], element);
+            } else {
+                self.scope->setValue({ 0, slots[0] }, variables[0], keyed ? key : element);
+            }
+            body(self);
+            LOOP_FLOW_CHECK
+            unit->iterate();
+        }
+        self.leaveScope();
+    });
+}
 
-    leaveScope();
+StatementClosure Interpreter::compileWhileLoop(const WhileLoopStatement *whileLoop, Resolver &resolver) {
+    auto condition = compileExpression(whileLoop->condition, resolver);
+    auto body = compileStatement(whileLoop->body, resolver);
+    const auto unit = resolver.unit();
+    std::shared_ptr<jit::Region> region;
+    std::shared_ptr<Resolver> pending;
+    if (resolver.getOptions().jit && unit->promoted()) {
+        region = jit::Compiler::compileWhileLoop(whileLoop, resolver);
+    } else if (resolver.getOptions().jit) {
+        pending = std::make_shared<Resolver>(resolver);
+    }
+    return guarded(whileLoop, [
+        whileLoop, unit, condition = std::move(condition), body = std::move(body),
+        region = std::move(region), pending = std::move(pending)
+    ](Interpreter &self) mutable {
+        if (pending && unit->promoted()) {
+            region = jit::Compiler::compileWhileLoop(whileLoop, *pending);
+            pending.reset();
+        }
+        if (region && region->runWhile(self.scope)) {
+            return;
+        }
+        // the state of the loop is all in variables: when the code
+        // gets hot while it runs, the rest of it can run natively
+        auto waiting = pending != nullptr;
+        while (true) {
+            const auto conditionResult = condition(self);
+            const auto boolResult = types::getCastedPointer<BooleanType, BooleanValue>(conditionResult);
+            if (!boolResult->value) break;
+            body(self);
+            LOOP_FLOW_CHECK
+            unit->iterate();
+            if (waiting && unit->promoted()) {
+                waiting = false;
+                region = jit::Compiler::compileWhileLoop(whileLoop, *pending);
+                pending.reset();
+                if (region && region->runWhile(self.scope)) break;
+            }
+        }
+    });
 }
 
-void Interpreter::executeWhileLoop(const WhileLoopStatement *whileLoop) {
-    while (true) {
-        const auto conditionResult = executeExpression(whileLoop->condition);
+StatementClosure Interpreter::compileIfElse(const IfElseStatement *ifElse, Resolver &resolver) {
+    auto condition = compileExpression(ifElse->condition, resolver);
+    auto mainClause = compileStatement(ifElse->mainClause, resolver);
+    auto elseClause = ifElse->elseClause.has_value()
+            ? compileStatement(*ifElse->elseClause, resolver)
+            : StatementClosure(nullptr);
+    return guarded(ifElse, [
+        condition = std::move(condition),
+        mainClause = std::move(mainClause),
+        elseClause = std::move(elseClause)
+    ](Interpreter &self) {
+        const auto conditionResult = condition(self);
         const auto boolResult = types::getCastedPointer<BooleanType, BooleanValue>(conditionResult);
-        if (!boolResult->value) break;
-        executeStatement(whileLoop->body);
-        LOOP_FLOW_CHECK
-    }
+        if (boolResult->value) {
+            mainClause(self);
+        } else if (elseClause) {
+            elseClause(self);
+        }
+    });
 }
 
-void Interpreter::executeIfElse(const IfElseStatement *ifElse) {
-    const auto conditionResult = executeExpression(ifElse->condition);
-    const auto boolResult = types::getCastedPointer<BooleanType, BooleanValue>(conditionResult);
-    if (boolResult->value) {
-        executeStatement(ifElse->mainClause);
-    } else if (ifElse->elseClause.has_value()) {
-        executeStatement(*ifElse->elseClause);
+StatementClosure Interpreter::compileMatch(const MatchStatement *match, Resolver &resolver) {
+    auto subject = compileExpression(match->subject, resolver);
+    std::vector<StatementClosure> arms;
+    for (const auto &[values, body] : match->cases) {
+        arms.push_back(compileStatement(body, resolver));
     }
+    arms.push_back(match->elseClause.has_value()
+        ? compileStatement(*match->elseClause, resolver)
+        : StatementClosure(nullptr));
+    return guarded(match, [
+        subject = std::move(subject),
+        arms = std::move(arms),
+        table = DispatchTable(match->cases)
+    ](Interpreter &self) {
+        const auto &arm = arms[table.lookup(subject(self))];
+        if (arm) {
+            arm(self);
+        }
+    });
 }
 
-void Interpreter::executeContinue() {
-    flowRegister = FlowFlag::ContinueLoop;
+StatementClosure Interpreter::compileContinue(const ContinueOperatorStatement *continueOp) {
+    return guarded(continueOp, [](Interpreter &self) {
+        self.flowRegister = FlowFlag::ContinueLoop;
+    });
 }
 
-void Interpreter::executeBreak() {
-    flowRegister = FlowFlag::BreakLoop;
+StatementClosure Interpreter::compileBreak(const BreakOperatorStatement *breakOp) {
+    return guarded(breakOp, [](Interpreter &self) {
+        self.flowRegister = FlowFlag::BreakLoop;
+    });
 }
 
-void Interpreter::executeReturn(const ReturnOperatorStatement *returnOp) {
+StatementClosure Interpreter::compileReturn(const ReturnOperatorStatement *returnOp, Resolver &resolver) {
+    const auto tailCall = returnOp->expression
+        && (*returnOp->expression)->expressionType() == Call
+        && resolver.getOptions().tailCalls
+        && resolver.insideFunction();
+    if (tailCall) {
+        const auto callExpression = static_cast<CallExpression*>(returnOp->expression->get());
+        auto call = compileTailCall(callExpression, resolver);
+        return guarded(returnOp, [call = std::move(call)](Interpreter &self) {
+            call(self);
+            self.flowRegister = FlowFlag::ReturnValue;
+        });
+    }
     if (returnOp->expression) {
-        returnRegister = executeExpression(*returnOp->expression);
+        auto expression = compileExpression(*returnOp->expression, resolver);
+        return guarded(returnOp, [expression = std::move(expression)](Interpreter &self) {
+            self.returnRegister = expression(self);
+            self.flowRegister = FlowFlag::ReturnValue;
+        });
     }
-    flowRegister = FlowFlag::ReturnValue;
+    return guarded(returnOp, [](Interpreter &self) {
+        self.flowRegister = FlowFlag::ReturnValue;
+    });
 }
 
-void Interpreter::executeBlock(const BlockStatement *block) {
-    enterScope();
-    for (const auto &each : block->statements) {
-        executeStatement(each);
-        if (flowRegister != FlowFlag::SequentialFlow) {
-            break;
+// the value is handed to whoever resumed the generator,
+// the body goes on from here once it is resumed again
+StatementClosure Interpreter::compileYield(const YieldStatement *yield, Resolver &resolver) {
+    auto expression = compileExpression(yield->expression, resolver);
+    return guarded(yield, [expression = std::move(expression)](Interpreter &self) {
+        if (self.generator == nullptr) {
+            throw MisplacedFlowOperator("yield");
         }
+        self.generator->yielded = copyForAssignment(expression(self));
+        self.generator->coroutine.suspend();
+    });
+}
+
+StatementClosure Interpreter::compileBlock(const BlockStatement *block, Resolver &resolver) {
+    auto layout = Resolver::blockLayout(block->statements);
+    // a block declaring nothing runs in the enclosing scope
+    if (layout->names.empty()) {
+        std::vector<StatementClosure> statements;
+        for (const auto &each : block->statements) {
+            statements.push_back(compileStatement(each, resolver));
+        }
+        return guarded(block, [statements = std::move(statements)](Interpreter &self) {
+            for (const auto &each : statements) {
+                each(self);
+                if (self.flowRegister != FlowFlag::SequentialFlow) {
+                    break;
+                }
+            }
+        });
     }
-    leaveScope();
+    resolver.enterScope(layout);
+    std::vector<StatementClosure> statements;
+    for (const auto &each : block->statements) {
+        statements.push_back(compileStatement(each, resolver));
+    }
+    resolver.leaveScope();
+    return guarded(block, [layout = std::move(layout), statements = std::move(statements)](Interpreter &self) {
+        self.enterScope(layout.get());
+        for (const auto &each : statements) {
+            each(self);
+            if (self.flowRegister != FlowFlag::SequentialFlow) {
+                break;
+            }
+        }
+        self.leaveScope();
+    });
 }
 
-void Interpreter::executeBareExpression(const ExpressionStatement *bare) {
-    executeExpression(bare->expression);
+StatementClosure Interpreter::compileBareExpression(const ExpressionStatement *bare, Resolver &resolver) {
+    auto expression = compileExpression(bare->expression, resolver);
+    return guarded(bare, [expression = std::move(expression)](Interpreter &self) {
+        expression(self);
+    });
 }
 
-void Interpreter::executeEcho(const EchoStatement *echo) {
-    const auto toPrint = executeExpression(echo->expression);
-    std::cout << toPrint->toString() << std::endl;
+StatementClosure Interpreter::compileEcho(const EchoStatement *echo, Resolver &resolver) {
+    auto expression = compileExpression(echo->expression, resolver);
+    return guarded(echo, [expression = std::move(expression)](Interpreter &self) {
+        const auto toPrint = expression(self);
+        std::cout << toPrint->toString() << std::endl;
+    });
 }
 
 // EXPRESSIONS
 
-SharedValue Interpreter::executeExpression(const ExpressionPtr &expression) {
+ExpressionClosure Interpreter::compileExpression(const ExpressionPtr &expression, Resolver &resolver) {
     #define EXPR_PTR(TYPE) static_cast<TYPE*>(expression.get())
-    try {
-        using enum Expression::ExpressionType;
-        switch (expression->expressionType()) {
-            case BinaryOperation:
-                return executeBinaryOperationExpression(EXPR_PTR(BinaryOperationExpression));
-            case PrefixOperation:
-                return executePrefixOperationExpression(EXPR_PTR(PrefixOperationExpression));
-            case Call:
-                return executeCallExpression           (EXPR_PTR(CallExpression           ));
-            case IndexAccess:
-                return executeIndexAccessExpression    (EXPR_PTR(IndexAccessExpression    ));
-            case NumberLiteral:
-                return executeNumberLiteralExpression  (EXPR_PTR(NumberLiteralExpression  ));
-            case BooleanLiteral:
-                return executeBooleanLiteralExpression (EXPR_PTR(BooleanLiteralExpression ));
-            case StringLiteral:
-                return executeStringLiteralExpression  (EXPR_PTR(StringLiteralExpression  ));
-            case ArrayLiteral:
-                return executeArrayLiteralExpression   (EXPR_PTR(ArrayLiteralExpression   ));
-            case NilLiteral:
-                return NilValue::getInstance();
-            case Variable:
-                return executeVariableExpression       (EXPR_PTR(VariableExpression       ));
-            case Lambda:
-                return executeLambdaExpression         (EXPR_PTR(LambdaExpression         ));
-            case Object:
-                return executeObjectExpression         (EXPR_PTR(ObjectExpression         ));
-            case ExpressionError:
-                throw ErrorNodeException               ();
-        }
-    } CATCH_PROPAGATE(expression)
-}
-
-
-SharedValue Interpreter::executeBinaryOperationExpression(const BinaryOperationExpression *expression) {
-    if (expression->op == "=") {
-        return executeRawAssignment(expression->left, expression->right);
-    }
-
-    auto left = executeExpression(expression->left);
-    const auto right = executeExpression(expression->right);
-    #define DEF_BIN_OP(OP_NAME,OP_VAL) if (expression->op == OP_NAME) return *left OP_VAL right;
-    #define DEF_ASSIGN(OP_NAME,OP_VAL) if (expression->op == OP_NAME) { *left OP_VAL right; return left; }
-
-    DEF_BIN_OP("or",  ||)
-    DEF_BIN_OP("and", &&)
-    DEF_BIN_OP("==",  ==)
-    DEF_BIN_OP("!=",  !=)
-    DEF_BIN_OP(">",   > )
-    DEF_BIN_OP("<",   < )
-    DEF_BIN_OP(">=",  >=)
-    DEF_BIN_OP("<=",  <=)
-    DEF_BIN_OP("-",   - )
-    DEF_BIN_OP("+",   + )
-    DEF_BIN_OP("*",   * )
-    DEF_BIN_OP("/",   / )
-    DEF_BIN_OP("div", & )
-    DEF_BIN_OP("mod", % )
-    DEF_BIN_OP("^",   ^ )
-
-    DEF_ASSIGN("+=",  +=)
-    DEF_ASSIGN("-=",  -=)
-    DEF_ASSIGN("*=",  *=)
-    DEF_ASSIGN("/=",  /=)
-    DEF_ASSIGN("^=",  ^=)
-
-    throw UnsupportedOperatorException(expression->op);
-}
-
-SharedValue* Interpreter::getPlacePointer(const IndexAccessExpression* indexExpression, bool read) {
-    const auto target = executeExpression(indexExpression->target);
+    using enum Expression::ExpressionType;
+    switch (expression->expressionType()) {
+        case BinaryOperation:
+            return compileBinaryOperationExpression(EXPR_PTR(BinaryOperationExpression), resolver);
+        case PrefixOperation:
+            return compilePrefixOperationExpression(EXPR_PTR(PrefixOperationExpression), resolver);
+        case Call:
+            return compileCallExpression           (EXPR_PTR(CallExpression           ), resolver);
+        case IndexAccess:
+            return compileIndexAccessExpression    (EXPR_PTR(IndexAccessExpression    ), resolver);
+        case NumberLiteral:
+            return compileNumberLiteralExpression  (EXPR_PTR(NumberLiteralExpression  ));
+        case BooleanLiteral:
+            return compileBooleanLiteralExpression (EXPR_PTR(BooleanLiteralExpression ));
+        case StringLiteral:
+            return compileStringLiteralExpression  (EXPR_PTR(StringLiteralExpression  ));
+        case ArrayLiteral:
+            return compileArrayLiteralExpression   (EXPR_PTR(ArrayLiteralExpression   ), resolver);
+        case NilLiteral:
+            return compileNilLiteralExpression     (EXPR_PTR(NilLiteralExpression     ));
+        case Variable:
+            return compileVariableExpression       (EXPR_PTR(VariableExpression       ), resolver);
+        case Lambda:
+            return compileLambdaExpression         (EXPR_PTR(LambdaExpression         ), resolver);
+        case Object:
+            return compileObjectExpression         (EXPR_PTR(ObjectExpression         ), resolver);
+        case Interpolation:
+            return compileInterpolationExpression  (EXPR_PTR(InterpolationExpression  ), resolver);
+        case ExpressionError:
+            return guarded(expression.get(), [](Interpreter&) -> SharedValue {
+                throw ErrorNodeException();
+            });
+    }
+    throw InternalException("expression cannot be compiled");
+}
+
+ExpressionClosure Interpreter::compileBinaryOperationExpression(const BinaryOperationExpression *expression, Resolver &resolver) {
+    if (expression->opcode == Operator::Assign) {
+        return compileRawAssignment(expression, resolver);
+    }
+
+    auto left = compileExpression(expression->left, resolver);
+    auto right = compileExpression(expression->right, resolver);
+
+    if (expression->opcode == Operator::Unknown) {
+        return guarded(expression, [
+            left = std::move(left), right = std::move(right), op = expression->op
+        ](Interpreter &self) -> SharedValue {
+            left(self);
+            right(self);
+            throw UnsupportedOperatorException(op);
+        });
+    }
 
+    const auto feedback = resolver.feedback(profiles::SiteKind::Operation, expression, profiles::detail(expression));
+    auto site = operators::QuickenedBinary(expression->opcode, feedback);
+    if (expression->right->expressionType() == NumberLiteral) {
+        const auto number = static_cast<NumberLiteralExpression*>(expression->right.get())->value;
+        return guarded(expression, [left = std::move(left), number, site](Interpreter &self) {
+            return site.withNumber(left(self), number);
+        });
+    }
+    return guarded(expression, [
+        left = std::move(left), right = std::move(right), site
+    ](Interpreter &self) mutable {
+        const auto leftValue = left(self);
+        const auto rightValue = right(self);
+        return site(leftValue, rightValue);
+    });
+}
+
+SharedValue* Interpreter::getPlacePointer (
+    Interpreter &self,
+    const SharedValue &target,
+    const ExpressionClosure &indexClosure,
+    bool read
+) {
     if (target->dataType() == ArrayType) {
         auto arrayObject = static_cast<ArrayObject*>(target.get());
-        const auto maybeIndex = executeExpression(indexExpression->index);
+        const auto maybeIndex = indexClosure(self);
         const auto floatingIndex = getCastedPointer<NumberType, NumberValue>(maybeIndex)->value;
         if (!utils::isInteger(floatingIndex)) throw NonIntegerIndexException();
         if (floatingIndex < 0) throw NegativeArrayIndexException();
         const auto integerIndex = static_cast<long>(floatingIndex);
-        if (integerIndex >= arrayObject->value.size()) throw IndexOutOfBoundsException(integerIndex);
-        return &arrayObject->value[integerIndex];
+        auto &elements = arrayObject->elements();
+        if (integerIndex >= elements.size()) throw IndexOutOfBoundsException(integerIndex);
+        return &elements[integerIndex];
     }
 
     if (target->dataType() == ObjectType) {
         auto objectPtr = static_cast<UserObject*>(target.get());
-        const auto key = executeExpression(indexExpression->index)->toString();
-        if ((objectPtr->value.find(key) == objectPtr->value.end()) && read) {
-            return nullptr;
-        }
-        return &objectPtr->value[key];
+        const auto key = indexClosure(self)->toString();
+        if (read) return objectPtr->findPlace(key);
+        return &objectPtr->getPlace(key);
     }
 
     throw WrongIndexAccessTargetException(target->getTypename());
 }
 
-SharedValue Interpreter::executeRawAssignment(const ExpressionPtr &left, const ExpressionPtr &right) {
-    auto rvalue = executeExpression(right);
-    auto copy = copyForAssignment(rvalue);
+SharedValue* Interpreter::getCachedPlacePointer (
+    Interpreter &self,
+    const SharedValue &target,
+    const ExpressionClosure &indexClosure,
+    const std::string &key,
+    caches::PropertyCache &cache,
+    bool read
+) {
+    if (target->dataType() != ObjectType) {
+        return getPlacePointer(self, target, indexClosure, read);
+    }
+    const auto objectPtr = static_cast<UserObject*>(target.get());
+    if (const auto cached = cache.lookup(objectPtr)) return cached;
+    const auto shape = objectPtr->shape;
+    const auto place = read ? objectPtr->findPlace(key) : &objectPtr->getPlace(key);
+    if (place == nullptr) return nullptr;
+    const auto &next = objectPtr->shape;
+    cache.remember(shape, next->slots.at(key), next == shape ? nullptr : next);
+    return place;
+}
+
+ExpressionClosure Interpreter::compileRawAssignment(const BinaryOperationExpression *expression, Resolver &resolver) {
+    const auto &left = expression->left;
+    auto right = compileExpression(expression->right, resolver);
 
     if (left->expressionType() == Variable) {
         const auto varExpression = static_cast<VariableExpression*>(left.get());
-        scope->setValue(varExpression->name, copy);
-    } else if (left->expressionType() == IndexAccess) {
+        const auto address = resolver.resolve(varExpression->name);
+        return guarded(expression, [name = varExpression->name, address, right = std::move(right)](Interpreter &self) {
+            auto copy = copyForAssignment(right(self));
+            self.scope->setValue(address, name, copy);
+            return copy;
+        });
+    }
+
+    if (left->expressionType() == IndexAccess) {
         const auto indexExpression = static_cast<IndexAccessExpression*>(left.get());
-        const auto placePointer = getPlacePointer(indexExpression, false);
-        *placePointer = copy;
-    } else {
-        throw ExpectedIdentifierException();
+        auto target = compileExpression(indexExpression->target, resolver);
+        auto index = compileExpression(indexExpression->index, resolver);
+        if (indexExpression->index->expressionType() == StringLiteral) {
+            const auto key = static_cast<StringLiteralExpression*>(indexExpression->index.get())->value;
+            const auto feedback = resolver.feedback(profiles::SiteKind::PropertyWrite, indexExpression, profiles::detail(indexExpression));
+            return guarded(expression, [
+                target = std::move(target), index = std::move(index), right = std::move(right),
+                key, cache = caches::PropertyCache(feedback)
+            ](Interpreter &self) mutable {
+                auto copy = copyForAssignment(right(self));
+                const auto targetValue = target(self);
+                const auto placePointer = getCachedPlacePointer(self, targetValue, index, key, cache, false);
+                *placePointer = copy;
+                return copy;
+            });
+        }
+        return guarded(expression, [
+            target = std::move(target), index = std::move(index), right = std::move(right)
+        ](Interpreter &self) {
+            auto copy = copyForAssignment(right(self));
+            const auto targetValue = target(self);
+            const auto placePointer = getPlacePointer(self, targetValue, index, false);
+            *placePointer = copy;
+            return copy;
+        });
     }
 
-    return copy;
+    return guarded(expression, [right = std::move(right)](Interpreter &self) -> SharedValue {
+        right(self);
+        throw ExpectedIdentifierException();
+    });
 }
 
-SharedValue Interpreter::executePrefixOperationExpression(const PrefixOperationExpression *expression) {
-    const auto nested = executeExpression(expression->expression);
-    if (expression->op == "not") {
-        return !(*nested);
-    }
-    if (expression->op == "-") {
-        return -(*nested);
+ExpressionClosure Interpreter::compilePrefixOperationExpression(const PrefixOperationExpression *expression, Resolver &resolver) {
+    auto nested = compileExpression(expression->expression, resolver);
+    if (expression->opcode == Operator::Unknown) {
+        return guarded(expression, [nested = std::move(nested), op = expression->op](Interpreter &self) -> SharedValue {
+            nested(self);
+            throw UnsupportedOperatorException(op);
+        });
     }
-    throw UnsupportedOperatorException(expression->op);
+    const auto &handlers = operators::prefixRow(expression->opcode);
+    return guarded(expression, [nested = std::move(nested), &handlers](Interpreter &self) {
+        return operators::prefix(handlers, nested(self));
+    });
 }
 
-SharedValue Interpreter::executeCallExpression(const CallExpression *expression) {
+ExpressionClosure Interpreter::compileCallExpression(const CallExpression *expression, Resolver &resolver) {
+    auto inlined = resolver.inlineTarget(expression->target);
+    if (inlined && inlined->parameters.size() != expression->arguments.size()) {
+        inlined = nullptr;
+    }
+    const auto unit = resolver.unit();
+    if (inlined && (unit->promoted() || resolver.insideInlined())) {
+        return compileInlinedCall(expression, inlined, resolver);
+    }
 
-    std::vector<SharedValue> arguments;
+    std::vector<ExpressionClosure> arguments;
     for (const auto &each : expression->arguments) {
-        const auto value = executeExpression(each);
-        const auto copied = types::copyForAssignment(value);
-        arguments.push_back(copied);
+        arguments.push_back(compileExpression(each, resolver));
     }
+    auto target = compileExpression(expression->target, resolver);
+
+    auto call = guarded(expression, [
+        arguments = std::move(arguments), target = std::move(target)
+    ](Interpreter &self) {
+        auto values = evaluateArguments(self, arguments);
+        const auto maybeTarget = target(self);
+        if (maybeTarget->dataType() == BuiltinType) {
+            const auto builtin = static_cast<BuiltinFunction*>(maybeTarget.get());
+            return builtin->cppCode(values);
+        }
 
-    const auto maybeTarget = executeExpression(expression->target);
-    if (maybeTarget->dataType() == BuiltinType) {
-        const auto builtin = static_cast<BuiltinFunction*>(maybeTarget.get());
-        return builtin->cppCode(arguments);
-    }
+        const auto fnPtr = getCastedPointer<FunctionType, FunctionalObject>(maybeTarget);
+        return self.callFunction(fnPtr, values);
+    });
+    if (!inlined) return call;
+
+    // inlined once the code around is hot, compiled
+    // with the resolver as it is at this point
+    return [
+        expression, inlined, unit, call = std::move(call),
+        pending = std::make_shared<Resolver>(resolver), fast = ExpressionClosure()
+    ](Interpreter &self) mutable {
+        if (!unit->promoted()) return call(self);
+        if (pending) {
+            fast = compileInlinedCall(expression, inlined, *pending);
+            pending.reset();
+        }
+        return fast(self);
+    };
+}
 
-    const auto fnPtr = getCastedPointer<FunctionType, FunctionalObject>(maybeTarget);
+// The returned expression of the function is compiled in place of the call.
+// Arguments stay on a stack instead of a scope of parameters, and are
+// not copied when the expression only passes them to operators. Until
+// the variable is found to hold that very function, the call is made as usual.
+// Failures are labeled with the frames the call would have had
+ExpressionClosure Interpreter::compileInlinedCall (
+    const CallExpression *expression,
+    const FunctionDeclarationStatement *function,
+    Resolver &resolver
+) {
+    std::vector<ExpressionClosure> arguments;
+    for (const auto &each : expression->arguments) {
+        arguments.push_back(compileExpression(each, resolver));
+    }
+    auto target = compileExpression(expression->target, resolver);
+    const auto &returned = *inliner::inlinable(function, resolver.getOptions());
+    std::vector<bool> copies;
+    for (const auto &param : function->parameters) {
+        const auto &name = static_cast<VariableExpression*>(param.get())->name;
+        copies.push_back(inliner::copiesArgument(returned, name));
+    }
+    resolver.enterInlined(function);
+    auto body = compileExpression(returned, resolver);
+    resolver.leaveInlined();
+
+    const auto block = static_cast<BlockStatement*>(function->body.get());
+    const auto returnOp = block->statements.front().get();
+    return guarded(expression, [
+        arguments = std::move(arguments), copies = std::move(copies), target = std::move(target),
+        body = std::move(body), function, block, returnOp
+    ](Interpreter &self) -> SharedValue {
+        auto &stack = self.inlinedArguments;
+        const auto base = stack.size();
+        try {
+            for (size_t i = 0; i < arguments.size(); i++) {
+                const auto value = arguments[i](self);
+                stack.push_back(copies[i] ? copyForAssignment(value) : value);
+            }
+        } catch (...) {
+            stack.resize(base);
+            throw;
+        }
+        const auto maybeTarget = target(self);
+        const auto fnPtr = static_cast<FunctionalObject*>(maybeTarget.get());
+        const auto expected = maybeTarget->dataType() == FunctionType
+            && fnPtr->body.get() == function->body.get()
+            && fnPtr->scope == self.globals
+            && self.callDepth < self.maxCallDepth;
+        if (!expected) {
+            std::vector<SharedValue> values;
+            for (size_t i = 0; i < arguments.size(); i++) {
+                values.push_back(copies[i] ? stack[base + i] : copyForAssignment(stack[base + i]));
+            }
+            stack.resize(base);
+            if (maybeTarget->dataType() == BuiltinType) {
+                const auto builtin = static_cast<BuiltinFunction*>(maybeTarget.get());
+                return builtin->cppCode(values);
+            }
+            return self.callFunction(getCastedPointer<FunctionType, FunctionalObject>(maybeTarget), values);
+        }
 
-    try {
-        const auto callingScope = scope;
-        scope = fnPtr->scope;
-        enterScope();
+        const auto callingBase = self.inlinedBase;
+        self.inlinedBase = base;
+        self.callDepth++;
+        try {
+            auto result = body(self);
+            self.callDepth--;
+            self.inlinedBase = callingBase;
+            stack.resize(base);
+            return result;
+        } catch (...) {
+            self.callDepth--;
+            self.inlinedBase = callingBase;
+            stack.resize(base);
+            const auto label = "calling a function from file \"" + fnPtr->filename + "\"";
+            try {
+                throw;
+            } catch (PropagatedException &exception) {
+                exception.enclose(returnOp->nodeLabel());
+                exception.enclose(block->nodeLabel());
+                exception.enclose(label);
+                throw;
+            } catch (const RuntimeException &exception) {
+                auto frame = PropagatedException(returnOp->nodeLabel(), exception.what());
+                frame.enclose(block->nodeLabel());
+                frame.enclose(label);
+                throw frame;
+            }
+        }
+    });
+}
 
-        std::vector<std::string> parameterNames;
-        std::set<std::string> withoutDefault;
-#define CHECK_FOR_DUPLICATE \
-        if (std::find(parameterNames.begin(), parameterNames.end(), variablePointer->name) != parameterNames.end()) { \
-            throw DuplicateParameterException(variablePointer->name); \
+// Evaluated like a call, except that a user function is not entered:
+// it is left in the tail call register and the returning function
+// is replaced by it in callFunction, so the native stack does not grow
+StatementClosure Interpreter::compileTailCall(const CallExpression *expression, Resolver &resolver) {
+    std::vector<ExpressionClosure> arguments;
+    for (const auto &each : expression->arguments) {
+        arguments.push_back(compileExpression(each, resolver));
+    }
+    auto target = compileExpression(expression->target, resolver);
+
+    return guarded(expression, [
+        arguments = std::move(arguments), target = std::move(target)
+    ](Interpreter &self) {
+        auto values = evaluateArguments(self, arguments);
+        auto maybeTarget = target(self);
+        if (maybeTarget->dataType() == BuiltinType) {
+            const auto builtin = static_cast<BuiltinFunction*>(maybeTarget.get());
+            self.returnRegister = builtin->cppCode(values);
+            return;
         }
 
-        for (const auto &param : fnPtr->parameters) {
-            if (param->expressionType() == Variable) {
-                const auto variablePointer = static_cast<VariableExpression*>(param.get());
-                CHECK_FOR_DUPLICATE
-                parameterNames.push_back(variablePointer->name);
-                withoutDefault.insert(variablePointer->name);
-                continue;
-            }
+        getCastedPointer<FunctionType, FunctionalObject>(maybeTarget);
+        self.tailCallRegister = TailCall { std::move(maybeTarget), std::move(values) };
+    });
+}
 
-            if (param->expressionType() == BinaryOperation) {
-                const auto binOp = static_cast<BinaryOperationExpression*>(param.get());
-                if ((binOp->op != "=") || (binOp->left->expressionType() != Variable)) {
-                    throw FunctionParameterWrongFormatException();
+std::vector<SharedValue> Interpreter::evaluateArguments(Interpreter &self, const std::vector<ExpressionClosure> &arguments) {
+    std::vector<SharedValue> values;
+    values.reserve(arguments.size());
+    for (const auto &each : arguments) {
+        const auto value = each(self);
+        const auto copied = types::copyForAssignment(value);
+        values.push_back(copied);
+    }
+    return values;
+}
+
+SharedValue Interpreter::callFunction(FunctionalObject *fnPtr, std::vector<SharedValue> &arguments) {
+    if (callDepth >= maxCallDepth) {
+        throw CallDepthExceededException(maxCallDepth);
+    }
+    if (Coroutine::exhausted(STACK_RESERVE)) {
+        throw StackExhaustedException(callDepth);
+    }
+    callDepth++;
+    try {
+        auto result = invokeFunction(fnPtr, arguments);
+        while (tailCallRegister.has_value()) {
+            auto tailCall = std::move(*tailCallRegister);
+            tailCallRegister = std::nullopt;
+            const auto tailFunction = static_cast<FunctionalObject*>(tailCall.function.get());
+            result = invokeFunction(tailFunction, tailCall.arguments);
+        }
+        callDepth--;
+        return result;
+    } catch (...) {
+        callDepth--;
+        throw;
+    }
+}
+
+SharedValue Interpreter::invokeFunction(FunctionalObject *fnPtr, std::vector<SharedValue> &arguments) {
+    try {
+        const auto &function = compiledFunction(fnPtr->body);
+        function.unit.call();
+        const auto callingScope = scope;
+        scope = LexicalScope::createInner(fnPtr->scope, function.layout.get(), fnPtr->captures);
+
+        const auto &parameters = function.parameters;
+        for (const auto &param : parameters) {
+            using enum CompiledParameter::Kind;
+            switch (param.kind) {
+                case Required:
+                    continue;
+                case WithDefault: {
+                    const auto defaultValue = param.defaultValue(*this);
+                    const auto copiedDefaultValue = copyForAssignment(defaultValue);
+                    scope->initSlot(param.slot, param.name, copiedDefaultValue);
+                    continue;
                 }
-                const auto variablePointer = static_cast<VariableExpression*>(binOp->left.get());
-                CHECK_FOR_DUPLICATE
-                parameterNames.push_back(variablePointer->name);
-                const auto defaultValue = executeExpression(binOp->right);
-                const auto copiedDefaultValue = copyForAssignment(defaultValue);
-                scope->initVariable(variablePointer->name, copiedDefaultValue);
-                continue;
+                case WrongFormat:
+                    throw FunctionParameterWrongFormatException();
+                case Duplicate:
+                    throw DuplicateParameterException(param.name);
             }
-
-            throw FunctionParameterWrongFormatException();
         }
 
-        if (arguments.size() > parameterNames.size()) {
-            throw ParamsAndArgsDontMatchException(parameterNames.size(), arguments.size());
+        if (arguments.size() > parameters.size()) {
+            throw ParamsAndArgsDontMatchException(parameters.size(), arguments.size());
         }
 
         for (size_t i = 0; i < arguments.size(); i++) {
-            if (const auto it = withoutDefault.find(parameterNames[i]); it != withoutDefault.end()) {
-                scope->initVariable(parameterNames[i], arguments[i]);
-                withoutDefault.erase(it);
+            if (parameters[i].kind == CompiledParameter::Kind::Required) {
+                scope->initSlot(parameters[i].slot, parameters[i].name, arguments[i]);
             } else {
-                scope->setValue(parameterNames[i], arguments[i]);
+                scope->setValue({ 0, parameters[i].slot }, parameters[i].name, arguments[i]);
             }
         }
 
-        if (!withoutDefault.empty()) {
+        if (arguments.size() < function.minimumArguments) {
+            std::set<std::string> withoutDefault;
+            for (size_t i = arguments.size(); i < parameters.size(); i++) {
+                if (parameters[i].kind == CompiledParameter::Kind::Required) {
+                    withoutDefault.insert(parameters[i].name);
+                }
+            }
             const auto paramList = utils::stringJoin(withoutDefault, ", ");
             throw UnsetParametersException(paramList);
         }
 
-        executeStatement(fnPtr->body);
+        if (function.generator) {
+            auto generator = std::make_shared<Generator>(fnPtr, std::move(scope), options);
+            scope = callingScope;
+            return std::make_shared<GeneratorObject>([generator](SharedValue &value) {
+                return generator->resume(value);
+            });
+        }
+
+        function.body(*this);
 
         leaveScope();
         scope = callingScope;
@@ -508,6 +1251,9 @@ SharedValue Interpreter::executeCallExpression(const CallExpression *expression)
         }
 
         return NilValue::getInstance();
+    } catch (PropagatedException &exception) {
+        exception.enclose("calling a function from file \"" + fnPtr->filename + "\"");
+        throw;
     } catch (...) {
         const auto currentExpression = std::current_exception();
         std::string description = "unknown runtime exception";
@@ -521,52 +1267,125 @@ SharedValue Interpreter::executeCallExpression(const CallExpression *expression)
     }
 }
 
-SharedValue Interpreter::executeObjectExpression(const parser::AST::ObjectExpression *objExpr) {
-    std::map<std::string, SharedValue> objValue;
+ExpressionClosure Interpreter::compileObjectExpression(const parser::AST::ObjectExpression *objExpr, Resolver &resolver) {
+    std::vector<std::tuple<ExpressionClosure, ExpressionClosure>> objectList;
     for (const auto& [keyExpr, valExpr] : objExpr->objectList) {
-        const auto key = executeExpression(keyExpr)->toString();
-        const auto value = executeExpression(valExpr);
-        objValue[key] = value;
+        auto key = compileExpression(keyExpr, resolver);
+        auto value = compileExpression(valExpr, resolver);
+        objectList.emplace_back(std::move(key), std::move(value));
+    }
+    return guarded(objExpr, [objectList = std::move(objectList)](Interpreter &self) -> SharedValue {
+        std::map<std::string, SharedValue> objValue;
+        for (const auto& [keyClosure, valueClosure] : objectList) {
+            const auto key = keyClosure(self)->toString();
+            const auto value = valueClosure(self);
+            objValue[key] = value;
+        }
+        return std::make_shared<UserObject>(objValue);
+    });
+}
+
+// the text parts are made once, and are only ever read
+ExpressionClosure Interpreter::compileInterpolationExpression(const InterpolationExpression *expression, Resolver &resolver) {
+    std::vector<std::tuple<SharedValue, ExpressionClosure>> parts;
+    for (const auto &each : expression->parts) {
+        if (each->expressionType() == StringLiteral) {
+            const auto &text = static_cast<StringLiteralExpression*>(each.get())->value;
+            parts.emplace_back(std::make_shared<StringValue>(text), nullptr);
+        } else {
+            parts.emplace_back(nullptr, compileExpression(each, resolver));
+        }
+    }
+    return guarded(expression, [parts = std::move(parts)](Interpreter &self) -> SharedValue {
+        std::vector<SharedValue> values;
+        values.reserve(parts.size());
+        for (const auto &[text, part] : parts) {
+            values.push_back(part ? part(self) : text);
+        }
+        return concatenate(values);
+    });
+}
+
+ExpressionClosure Interpreter::compileIndexAccessExpression(const IndexAccessExpression *expression, Resolver &resolver) {
+    auto target = compileExpression(expression->target, resolver);
+    auto index = compileExpression(expression->index, resolver);
+    // obj.field and obj["field"] go through an inline cache
+    if (expression->index->expressionType() == StringLiteral) {
+        const auto key = static_cast<StringLiteralExpression*>(expression->index.get())->value;
+        const auto feedback = resolver.feedback(profiles::SiteKind::PropertyRead, expression, profiles::detail(expression));
+        return guarded(expression, [
+            target = std::move(target), index = std::move(index), key, cache = caches::PropertyCache(feedback)
+        ](Interpreter &self) mutable {
+            // a temporary target has to outlive the read of its place
+            const auto targetValue = target(self);
+            const auto placePointer = getCachedPlacePointer(self, targetValue, index, key, cache, true);
+            if (placePointer == nullptr) return NilValue::getInstance();
+            return *placePointer;
+        });
     }
-    return std::make_shared<UserObject>(objValue);
+    return guarded(expression, [target = std::move(target), index = std::move(index)](Interpreter &self) {
+        const auto targetValue = target(self);
+        const auto placePointer = getPlacePointer(self, targetValue, index, true);
+        if (placePointer == nullptr) return NilValue::getInstance();
+        return *placePointer;
+    });
 }
 
-SharedValue Interpreter::executeIndexAccessExpression(const IndexAccessExpression *expression) {
-    const auto placePointer = getPlacePointer(expression, true);
-    if (placePointer == nullptr) return NilValue::getInstance();
-    return *placePointer;
+ExpressionClosure Interpreter::compileNumberLiteralExpression(const NumberLiteralExpression *expression) {
+    return guarded(expression, [value = expression->value](Interpreter&) -> SharedValue {
+        return std::make_shared<NumberValue>(value);
+    });
 }
 
-SharedValue Interpreter::executeNumberLiteralExpression(const NumberLiteralExpression *expression) {
-    return std::make_shared<NumberValue>(expression->value);
+ExpressionClosure Interpreter::compileBooleanLiteralExpression(const BooleanLiteralExpression *expression) {
+    return guarded(expression, [value = expression->value](Interpreter&) -> SharedValue {
+        return std::make_shared<BooleanValue>(value);
+    });
 }
 
-SharedValue Interpreter::executeBooleanLiteralExpression(const BooleanLiteralExpression *expression) {
-    return std::make_shared<BooleanValue>(expression->value);
+ExpressionClosure Interpreter::compileStringLiteralExpression(const StringLiteralExpression *expression) {
+    return guarded(expression, [value = expression->value](Interpreter&) -> SharedValue {
+        return std::make_shared<StringValue>(value);
+    });
 }
 
-SharedValue Interpreter::executeStringLiteralExpression(const StringLiteralExpression *expression) {
-    return std::make_shared<StringValue>(expression->value);
+ExpressionClosure Interpreter::compileNilLiteralExpression(const NilLiteralExpression *expression) {
+    return guarded(expression, [](Interpreter&) {
+        return NilValue::getInstance();
+    });
 }
 
-SharedValue Interpreter::executeArrayLiteralExpression(const ArrayLiteralExpression *expression) {
-    std::vector<SharedValue> values;
+ExpressionClosure Interpreter::compileArrayLiteralExpression(const ArrayLiteralExpression *expression, Resolver &resolver) {
+    std::vector<ExpressionClosure> elements;
     for (const auto &each : expression->values) {
-        const auto value = executeExpression(each);
-        values.push_back(value);
+        elements.push_back(compileExpression(each, resolver));
     }
-    return std::make_shared<ArrayObject>(values);
+    return guarded(expression, [elements = std::move(elements)](Interpreter &self) -> SharedValue {
+        std::vector<SharedValue> values;
+        values.reserve(elements.size());
+        for (const auto &each : elements) {
+            const auto value = each(self);
+            values.push_back(value);
+        }
+        return std::make_shared<ArrayObject>(values);
+    });
 }
 
-SharedValue Interpreter::executeVariableExpression(const VariableExpression *expression) {
-    return scope->getValue(expression->name);
+ExpressionClosure Interpreter::compileVariableExpression(const VariableExpression *expression, Resolver &resolver) {
+    if (const auto argument = resolver.inlinedArgument(expression->name)) {
+        return [index = *argument](Interpreter &self) {
+            return self.inlinedArguments[self.inlinedBase + index];
+        };
+    }
+    const auto address = resolver.resolve(expression->name);
+    return guarded(expression, [name = expression->name, address](Interpreter &self) {
+        return self.scope->getValue(address, name);
+    });
 }
 
-SharedValue Interpreter::executeLambdaExpression(const LambdaExpression *expression) {
-    return std::make_shared<FunctionalObject> (
-        filename,
-        expression->parameters,
-        expression->body,
-        scope
-    );
+ExpressionClosure Interpreter::compileLambdaExpression(const LambdaExpression *expression, Resolver &resolver) {
+    compileFunction(expression, expression->parameters, expression->body, resolver);
+    return guarded(expression, [expression](Interpreter &self) {
+        return self.createClosure(expression->parameters, expression->body);
+    });
 }
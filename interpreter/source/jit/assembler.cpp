@@ -0,0 +1,131 @@
+#include "jit/assembler.h"
+#include "except.h"
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include <cstring>
+
+using namespace interpreter::jit;
+using namespace interpreter::exceptions;
+
+void Assembler::emit(std::initializer_list<unsigned char> bytes) {
+    code.insert(code.end(), bytes);
+}
+
+void Assembler::emitInt32(int32_t value) {
+    for (size_t i = 0; i < sizeof(value); i++) {
+        code.push_back(static_cast<unsigned char>((static_cast<uint32_t>(value) >> (8 * i)) & 0xFF));
+    }
+}
+
+// modrm with mod = 10 (disp32) and rm = 111 (rdi)
+void Assembler::emitSlot(unsigned char modrm, size_t slot) {
+    code.push_back(modrm);
+    emitInt32(static_cast<int32_t>(slot * sizeof(long double)));
+}
+
+Assembler::Label Assembler::newLabel() {
+    labels.emplace_back(std::nullopt);
+    return labels.size() - 1;
+}
+
+void Assembler::bind(Label label) {
+    labels[label] = code.size();
+}
+
+void Assembler::load(size_t slot) {
+    emit({0xDB});
+    emitSlot(0xAF, slot);
+}
+
+void Assembler::storeAndPop(size_t slot) {
+    emit({0xDB});
+    emitSlot(0xBF, slot);
+}
+
+void Assembler::addAndPop()      { emit({0xDE, 0xC1}); }
+void Assembler::subtractAndPop() { emit({0xDE, 0xE9}); }
+void Assembler::multiplyAndPop() { emit({0xDE, 0xC9}); }
+void Assembler::divideAndPop()   { emit({0xDE, 0xF9}); }
+void Assembler::negate()         { emit({0xD9, 0xE0}); }
+
+void Assembler::compareAndPopBoth() {
+    // fucomip st0, st1 ; fstp st0
+    emit({0xDF, 0xE9, 0xDD, 0xD8});
+}
+
+void Assembler::compareFlag(size_t slot, unsigned char value) {
+    emit({0x80});
+    emitSlot(0xBF, slot);
+    code.push_back(value);
+}
+
+void Assembler::storeFlag(size_t slot, unsigned char value) {
+    emit({0xC6});
+    emitSlot(0x87, slot);
+    code.push_back(value);
+}
+
+void Assembler::jump(Label label) {
+    emit({0xE9});
+    jumps.emplace_back(code.size(), label);
+    emitInt32(0);
+}
+
+void Assembler::jumpIf(Condition condition, Label label) {
+    emit({0x0F, static_cast<unsigned char>(condition)});
+    jumps.emplace_back(code.size(), label);
+    emitInt32(0);
+}
+
+void Assembler::ret() {
+    emit({0xC3});
+}
+
+std::vector<unsigned char> Assembler::finish() {
+    for (const auto &[position, label] : jumps) {
+        if (!labels[label].has_value()) {
+            throw InternalException("jump to an unbound label");
+        }
+        const auto relative = static_cast<int64_t>(*labels[label]) - static_cast<int64_t>(position + 4);
+        const auto value = static_cast<uint32_t>(static_cast<int32_t>(relative));
+        for (size_t i = 0; i < 4; i++) {
+            code[position + i] = static_cast<unsigned char>((value >> (8 * i)) & 0xFF);
+        }
+    }
+    return code;
+}
+
+ExecutableCode::ExecutableCode(const std::vector<unsigned char> &code)
+    : memory(nullptr), size(0) {
+    #if defined(__linux__)
+    const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size = (code.size() + pageSize - 1) / pageSize * pageSize;
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        memory = nullptr;
+        throw InternalException("failed to map memory for native code");
+    }
+    std::memcpy(memory, code.data(), code.size());
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        memory = nullptr;
+        throw InternalException("failed to make native code executable");
+    }
+    #else
+    throw UnimplementedException("native code on this platform");
+    #endif
+}
+
+ExecutableCode::~ExecutableCode() {
+    #if defined(__linux__)
+    if (memory != nullptr) {
+        munmap(memory, size);
+    }
+    #endif
+}
+
+ExecutableCode::Entry ExecutableCode::entry() const {
+    return reinterpret_cast<Entry>(memory);
+}
@@ -0,0 +1,478 @@
+#include "jit/compiler.h"
+#include "except.h"
+
+using namespace interpreter;
+using namespace interpreter::jit;
+using namespace interpreter::types;
+using namespace interpreter::exceptions;
+
+Statistics& jit::statistics() {
+    static Statistics instance;
+    return instance;
+}
+
+namespace {
+    // thrown when the loop uses something
+    // the JIT has no template for
+    struct Unsupported {};
+}
+
+static constexpr size_t X87_REGISTERS = 8;
+
+// REGION
+
+bool Region::runWhile(const SharedScope &scope) {
+    auto frame = initialFrame;
+    return execute(scope, frame, {});
+}
+
+bool Region::runFor(const SharedScope &scope, const SharedValue &start, const SharedValue &end, const SharedValue &step) {
+    auto frame = initialFrame;
+    frame[COUNTER_SLOT] = static_cast<NumberValue*>(start.get())->value;
+    frame[END_SLOT] = static_cast<NumberValue*>(end.get())->value;
+    frame[STEP_SLOT] = static_cast<NumberValue*>(step.get())->value;
+    reinterpret_cast<unsigned char*>(&frame[POSITIVE_SLOT])[0] = frame[STEP_SLOT] > 0 ? 1 : 0;
+    return execute(scope, frame, { start.get(), end.get(), step.get() });
+}
+
+bool Region::execute(const SharedScope &scope, std::vector<long double> &frame, const std::vector<const AnyValue*> &loopObjects) {
+    std::vector<SharedValue> objects;
+    objects.reserve(variables.size());
+    for (const auto &variable : variables) {
+        SharedValue value;
+        try {
+            value = scope->getValue(variable.address, variable.name);
+        } catch (const RuntimeException&) {
+            statistics().bailedOut++;
+            return false;
+        }
+        if (value->dataType() != NumberType) {
+            statistics().bailedOut++;
+            return false;
+        }
+        objects.push_back(std::move(value));
+    }
+
+    // compound assignments change numbers in place, so the
+    // interpreter has to run loops where an object is shared
+    for (size_t i = 0; i < objects.size(); i++) {
+        for (size_t j = i + 1; j < objects.size(); j++) {
+            if (objects[i] == objects[j]) {
+                statistics().bailedOut++;
+                return false;
+            }
+        }
+        for (const auto each : loopObjects) {
+            if (objects[i].get() == each) {
+                statistics().bailedOut++;
+                return false;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < objects.size(); i++) {
+        frame[variables[i].slot] = static_cast<NumberValue*>(objects[i].get())->value;
+    }
+    statistics().entered++;
+    code->entry()(frame.data());
+
+    for (size_t i = 0; i < objects.size(); i++) {
+        const auto &variable = variables[i];
+        if (!variable.assigned) continue;
+        const auto number = static_cast<NumberValue*>(objects[i].get());
+        const auto replaced = reinterpret_cast<const unsigned char*>(&frame[variable.slot + 2])[0] != 0;
+        if (!replaced) {
+            number->value = frame[variable.slot];
+            continue;
+        }
+        // the original object keeps the value it had when replaced
+        number->value = frame[variable.slot + 1];
+        SharedValue replacement = std::make_shared<NumberValue>(frame[variable.slot]);
+        scope->setValue(variable.address, variable.name, replacement);
+    }
+    return true;
+}
+
+// LOAD TIME
+
+Compiler::Compiler(Resolver &resolver, Region &region)
+    : resolver(resolver),
+      region(region),
+      scopeDepth(0),
+      stackDepth(0) {
+    region.initialFrame.resize(Region::FIXED_SLOTS);
+}
+
+std::shared_ptr<Region> Compiler::compileWhileLoop(const WhileLoopStatement *whileLoop, Resolver &resolver) {
+    if (!PLATFORM_SUPPORTED) {
+        statistics().rejected++;
+        return nullptr;
+    }
+    auto region = std::make_shared<Region>();
+    Compiler compiler(resolver, *region);
+    try {
+        compiler.compileWhileLoop(whileLoop);
+        compiler.assembler.ret();
+        compiler.finish();
+    } catch (const Unsupported&) {
+        compiler.leaveScopes();
+        statistics().rejected++;
+        return nullptr;
+    }
+    return region;
+}
+
+std::shared_ptr<Region> Compiler::compileForLoop(const ForLoopStatement *forLoop, Resolver &resolver) {
+    if (!PLATFORM_SUPPORTED) {
+        statistics().rejected++;
+        return nullptr;
+    }
+    auto region = std::make_shared<Region>();
+    Compiler compiler(resolver, *region);
+    compiler.counterName = forLoop->variable;
+    resolver.enterScope(Resolver::forLoopLayout(forLoop));
+    compiler.scopeDepth++;
+    try {
+        auto &assembler = compiler.assembler;
+        const auto top = assembler.newLabel();
+        const auto negative = assembler.newLabel();
+        const auto body = assembler.newLabel();
+        const auto step = assembler.newLabel();
+        const auto end = assembler.newLabel();
+
+        // the loop is over once the counter reaches the end:
+        // counter >= end for a positive step, counter <= end otherwise
+        assembler.bind(top);
+        assembler.compareFlag(Region::POSITIVE_SLOT, 0);
+        assembler.jumpIf(Condition::Equal, negative);
+        assembler.load(Region::END_SLOT);
+        assembler.load(Region::COUNTER_SLOT);
+        assembler.compareAndPopBoth();
+        assembler.jumpIf(Condition::AboveOrEqual, end);
+        assembler.jump(body);
+        assembler.bind(negative);
+        assembler.load(Region::COUNTER_SLOT);
+        assembler.load(Region::END_SLOT);
+        assembler.compareAndPopBoth();
+        assembler.jumpIf(Condition::AboveOrEqual, end);
+
+        assembler.bind(body);
+        compiler.loops.push_back({ step, end });
+        compiler.compileStatement(forLoop->body);
+        compiler.loops.pop_back();
+
+        assembler.bind(step);
+        assembler.load(Region::COUNTER_SLOT);
+        assembler.load(Region::STEP_SLOT);
+        assembler.addAndPop();
+        assembler.storeAndPop(Region::COUNTER_SLOT);
+        assembler.jump(top);
+        assembler.bind(end);
+        assembler.ret();
+        compiler.finish();
+    } catch (const Unsupported&) {
+        compiler.leaveScopes();
+        statistics().rejected++;
+        return nullptr;
+    }
+    compiler.leaveScopes();
+    return region;
+}
+
+void Compiler::finish() {
+    try {
+        region.code = std::make_unique<ExecutableCode>(assembler.finish());
+    } catch (const RuntimeException&) {
+        throw Unsupported();
+    }
+    statistics().compiled++;
+}
+
+void Compiler::leaveScopes() {
+    for (; scopeDepth > 0; scopeDepth--) {
+        resolver.leaveScope();
+    }
+}
+
+// STATEMENTS
+
+void Compiler::compileStatement(const StatementPtr &statement) {
+    using enum Statement::StatementType;
+    switch (statement->statementType()) {
+        case BareExpression: {
+            const auto &expression = static_cast<ExpressionStatement*>(statement.get())->expression;
+            if (expression->expressionType() != Expression::ExpressionType::BinaryOperation) {
+                throw Unsupported();
+            }
+            return compileAssignment(static_cast<BinaryOperationExpression*>(expression.get()));
+        }
+        case IfElse:
+            return compileIfElse(static_cast<IfElseStatement*>(statement.get()));
+        case WhileLoop:
+            return compileWhileLoop(static_cast<WhileLoopStatement*>(statement.get()));
+        case BlockOfStatements:
+            return compileBlock(static_cast<BlockStatement*>(statement.get()));
+        case BreakOperator:
+            return assembler.jump(loops.back().breakTarget);
+        case ContinueOperator:
+            return assembler.jump(loops.back().continueTarget);
+        default:
+            throw Unsupported();
+    }
+}
+
+void Compiler::compileAssignment(const BinaryOperationExpression *assignment) {
+    if (assignment->left->expressionType() != Expression::ExpressionType::Variable) {
+        throw Unsupported();
+    }
+    const auto &name = static_cast<VariableExpression*>(assignment->left.get())->name;
+
+    if (assignment->opcode == Operator::Assign) {
+        compileNumber(assignment->right);
+        const auto slot = variableSlot(name, true);
+        // the first replacement of the object remembers its value
+        const auto replaced = assembler.newLabel();
+        assembler.compareFlag(slot + 2, 0);
+        assembler.jumpIf(Condition::NotEqual, replaced);
+        push();
+        assembler.load(slot);
+        assembler.storeAndPop(slot + 1);
+        pop();
+        assembler.storeFlag(slot + 2, 1);
+        assembler.bind(replaced);
+        assembler.storeAndPop(slot);
+        pop();
+        return;
+    }
+
+    const auto slot = variableSlot(name, true);
+    assembler.load(slot);
+    push();
+    compileNumber(assignment->right);
+    switch (assignment->opcode) {
+        case Operator::PlusAssign:     assembler.addAndPop();      break;
+        case Operator::MinusAssign:    assembler.subtractAndPop(); break;
+        case Operator::MultiplyAssign: assembler.multiplyAndPop(); break;
+        case Operator::DivideAssign:   assembler.divideAndPop();   break;
+        default: throw Unsupported();
+    }
+    pop();
+    assembler.storeAndPop(slot);
+    pop();
+}
+
+void Compiler::compileIfElse(const IfElseStatement *ifElse) {
+    const auto elseClause = assembler.newLabel();
+    const auto end = assembler.newLabel();
+    compileBranch(ifElse->condition, false, elseClause);
+    compileStatement(ifElse->mainClause);
+    if (ifElse->elseClause.has_value()) {
+        assembler.jump(end);
+        assembler.bind(elseClause);
+        compileStatement(*ifElse->elseClause);
+    } else {
+        assembler.bind(elseClause);
+    }
+    assembler.bind(end);
+}
+
+void Compiler::compileWhileLoop(const WhileLoopStatement *whileLoop) {
+    const auto top = assembler.newLabel();
+    const auto end = assembler.newLabel();
+    assembler.bind(top);
+    compileBranch(whileLoop->condition, false, end);
+    loops.push_back({ top, end });
+    compileStatement(whileLoop->body);
+    loops.pop_back();
+    assembler.jump(top);
+    assembler.bind(end);
+}
+
+void Compiler::compileBlock(const BlockStatement *block) {
+    resolver.enterScope(Resolver::blockLayout(block->statements));
+    scopeDepth++;
+    for (const auto &each : block->statements) {
+        compileStatement(each);
+    }
+    resolver.leaveScope();
+    scopeDepth--;
+}
+
+// EXPRESSIONS
+
+void Compiler::compileNumber(const ExpressionPtr &expression) {
+    using enum Expression::ExpressionType;
+    switch (expression->expressionType()) {
+        case NumberLiteral:
+            assembler.load(constantSlot(static_cast<NumberLiteralExpression*>(expression.get())->value));
+            push();
+            return;
+        case Variable:
+            assembler.load(variableSlot(static_cast<VariableExpression*>(expression.get())->name, false));
+            push();
+            return;
+        case PrefixOperation: {
+            const auto prefix = static_cast<PrefixOperationExpression*>(expression.get());
+            if (prefix->opcode != Operator::Negate) throw Unsupported();
+            compileNumber(prefix->expression);
+            assembler.negate();
+            return;
+        }
+        case BinaryOperation: {
+            const auto binary = static_cast<BinaryOperationExpression*>(expression.get());
+            compileNumber(binary->left);
+            compileNumber(binary->right);
+            switch (binary->opcode) {
+                case Operator::Plus:     assembler.addAndPop();      break;
+                case Operator::Minus:    assembler.subtractAndPop(); break;
+                case Operator::Multiply: assembler.multiplyAndPop(); break;
+                case Operator::Divide:   assembler.divideAndPop();   break;
+                default: throw Unsupported();
+            }
+            pop();
+            return;
+        }
+        default:
+            throw Unsupported();
+    }
+}
+
+// emits a jump to target taken when the condition evaluates to jumpWhen.
+// Operands of `and` and `or` have no side effects here, so they may be skipped
+void Compiler::compileBranch(const ExpressionPtr &condition, bool jumpWhen, Assembler::Label target) {
+    using enum Expression::ExpressionType;
+    switch (condition->expressionType()) {
+        case BooleanLiteral:
+            if (static_cast<BooleanLiteralExpression*>(condition.get())->value == jumpWhen) {
+                assembler.jump(target);
+            }
+            return;
+        case PrefixOperation: {
+            const auto prefix = static_cast<PrefixOperationExpression*>(condition.get());
+            if (prefix->opcode != Operator::Not) throw Unsupported();
+            return compileBranch(prefix->expression, !jumpWhen, target);
+        }
+        case BinaryOperation: {
+            const auto binary = static_cast<BinaryOperationExpression*>(condition.get());
+            if (binary->opcode != Operator::And && binary->opcode != Operator::Or) {
+                return compileComparison(binary, jumpWhen, target);
+            }
+            // `and` jumps on false as soon as one operand is false, `or` on true
+            const auto decisive = binary->opcode == Operator::Or;
+            if (jumpWhen == decisive) {
+                compileBranch(binary->left, jumpWhen, target);
+                compileBranch(binary->right, jumpWhen, target);
+                return;
+            }
+            const auto skip = assembler.newLabel();
+            compileBranch(binary->left, decisive, skip);
+            compileBranch(binary->right, jumpWhen, target);
+            assembler.bind(skip);
+            return;
+        }
+        default:
+            throw Unsupported();
+    }
+}
+
+void Compiler::compileComparison(const BinaryOperationExpression *comparison, bool jumpWhen, Assembler::Label target) {
+    using enum Operator;
+    const auto op = comparison->opcode;
+    if (op != Less && op != Greater && op != LessEqual && op != GreaterEqual && op != Equal && op != NotEqual) {
+        throw Unsupported();
+    }
+
+    // a number is equal to itself even when it is NaN
+    const auto &left = comparison->left;
+    const auto &right = comparison->right;
+    const auto variables = left->expressionType() == Expression::ExpressionType::Variable
+        && right->expressionType() == Expression::ExpressionType::Variable;
+    if ((op == Equal || op == NotEqual) && variables) {
+        const auto &leftName = static_cast<VariableExpression*>(left.get())->name;
+        const auto &rightName = static_cast<VariableExpression*>(right.get())->name;
+        if (leftName == rightName) {
+            variableSlot(leftName, false);
+            if ((op == Equal) == jumpWhen) {
+                assembler.jump(target);
+            }
+            return;
+        }
+    }
+
+    // st0 has to be above st1 for <, <=, > and >=
+    if (op == Greater || op == GreaterEqual) {
+        compileNumber(right);
+        compileNumber(left);
+    } else {
+        compileNumber(left);
+        compileNumber(right);
+    }
+    assembler.compareAndPopBoth();
+    pop(2);
+
+    switch (op) {
+        case Less:
+        case Greater:
+            assembler.jumpIf(jumpWhen ? Condition::Above : Condition::BelowOrEqual, target);
+            return;
+        case LessEqual:
+        case GreaterEqual:
+            assembler.jumpIf(jumpWhen ? Condition::AboveOrEqual : Condition::Below, target);
+            return;
+        default: {
+            // unordered operands set the parity flag
+            if ((op == Equal) == jumpWhen) {
+                const auto skip = assembler.newLabel();
+                assembler.jumpIf(Condition::Parity, skip);
+                assembler.jumpIf(Condition::Equal, target);
+                assembler.bind(skip);
+            } else {
+                assembler.jumpIf(Condition::Parity, target);
+                assembler.jumpIf(Condition::NotEqual, target);
+            }
+            return;
+        }
+    }
+}
+
+// HELPERS
+
+size_t Compiler::variableSlot(const std::string &name, bool assigned) {
+    const auto address = resolver.resolve(name);
+    // blocks of the body declare nothing, so only
+    // the counter of a for loop lives inside the region
+    if (address.depth < scopeDepth) {
+        if (name != counterName || address.depth + 1 != scopeDepth || assigned) {
+            throw Unsupported();
+        }
+        return Region::COUNTER_SLOT;
+    }
+
+    const VariableAddress relative { address.depth - scopeDepth, address.slot, address.captured };
+    const auto key = VariableKey { relative.depth, relative.slot, name };
+    if (const auto it = variableIndices.find(key); it != variableIndices.end()) {
+        auto &variable = region.variables[it->second];
+        variable.assigned = variable.assigned || assigned;
+        return variable.slot;
+    }
+    const auto slot = region.initialFrame.size();
+    region.initialFrame.resize(slot + 3);
+    region.variables.push_back({ name, relative, slot, assigned });
+    variableIndices[key] = region.variables.size() - 1;
+    return slot;
+}
+
+size_t Compiler::constantSlot(long double value) {
+    region.initialFrame.push_back(value);
+    return region.initialFrame.size() - 1;
+}
+
+void Compiler::push() {
+    if (++stackDepth > X87_REGISTERS) {
+        throw Unsupported();
+    }
+}
+
+void Compiler::pop(size_t amount) {
+    stackDepth -= amount;
+}
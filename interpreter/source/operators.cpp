@@ -0,0 +1,253 @@
+#include "operators.h"
+#include "except.h"
+#include <cmath>
+#include <utility>
+
+using namespace interpreter;
+using namespace interpreter::operators;
+using namespace interpreter::types;
+using namespace interpreter::exceptions;
+
+// generic handlers: virtual operators of the values
+
+template <Operator op>
+static SharedValue genericBinary(const SharedValue &left, const SharedValue &right) {
+    using enum Operator;
+    auto &value = *left;
+    if constexpr (op == Or)                return value || right;
+    else if constexpr (op == And)          return value && right;
+    else if constexpr (op == Equal)        return value == right;
+    else if constexpr (op == NotEqual)     return value != right;
+    else if constexpr (op == Less)         return value <  right;
+    else if constexpr (op == Greater)      return value >  right;
+    else if constexpr (op == LessEqual)    return value <= right;
+    else if constexpr (op == GreaterEqual) return value >= right;
+    else if constexpr (op == Plus)         return value +  right;
+    else if constexpr (op == Minus)        return value -  right;
+    else if constexpr (op == Multiply)     return value *  right;
+    else if constexpr (op == Divide)       return value /  right;
+    else if constexpr (op == Div)          return value &  right;
+    else if constexpr (op == Mod)          return value %  right;
+    else if constexpr (op == Power)        return value ^  right;
+    else if constexpr (op == PlusAssign)     { value += right; return left; }
+    else if constexpr (op == MinusAssign)    { value -= right; return left; }
+    else if constexpr (op == MultiplyAssign) { value *= right; return left; }
+    else if constexpr (op == DivideAssign)   { value /= right; return left; }
+    else if constexpr (op == PowerAssign)    { value ^= right; return left; }
+    else throw InternalException("unexpected binary operator");
+}
+
+template <Operator op>
+static SharedValue genericPrefix(const SharedValue &value) {
+    if constexpr (op == Operator::Not)         return !(*value);
+    else if constexpr (op == Operator::Negate) return -(*value);
+    else throw InternalException("unexpected prefix operator");
+}
+
+// specialized handlers, types are guaranteed by the table
+
+#define BOOLEAN_OF(VALUE) static_cast<BooleanValue*>(VALUE.get())->value
+
+#define NUMBER_OF(VALUE) static_cast<NumberValue*>(VALUE.get())->value
+#define STRING_OF(VALUE) static_cast<StringValue*>(VALUE.get())->value
+
+// kernels: the left operand is guaranteed to be of the type,
+// the right one is already unboxed
+
+template <Operator op>
+static consteval bool hasNumberKernel() {
+    using enum Operator;
+    return op != Or && op != And && op != Assign && op != Not && op != Negate && op != Unknown;
+}
+
+template <Operator op>
+static SharedValue numberKernel(const SharedValue &left, long double b) {
+    using enum Operator;
+    const auto a = NUMBER_OF(left);
+    if constexpr (op == Equal)             return std::make_shared<BooleanValue>(a == b);
+    else if constexpr (op == NotEqual)     return std::make_shared<BooleanValue>(a != b);
+    else if constexpr (op == Less)         return std::make_shared<BooleanValue>(a <  b);
+    else if constexpr (op == Greater)      return std::make_shared<BooleanValue>(a >  b);
+    else if constexpr (op == LessEqual)    return std::make_shared<BooleanValue>(a <= b);
+    else if constexpr (op == GreaterEqual) return std::make_shared<BooleanValue>(a >= b);
+    else if constexpr (op == Plus)         return std::make_shared<NumberValue>(a + b);
+    else if constexpr (op == Minus)        return std::make_shared<NumberValue>(a - b);
+    else if constexpr (op == Multiply)     return std::make_shared<NumberValue>(a * b);
+    else if constexpr (op == Divide)       return std::make_shared<NumberValue>(a / b);
+    else if constexpr (op == Mod)          return std::make_shared<NumberValue>(fmod(a, b));
+    else if constexpr (op == Power)        return std::make_shared<NumberValue>(pow(a, b));
+    else if constexpr (op == Div) {
+        const auto intResult = static_cast<long long>(a / b);
+        return std::make_shared<NumberValue>(static_cast<long double>(intResult));
+    }
+    else if constexpr (op == PlusAssign)     { NUMBER_OF(left) += b; return left; }
+    else if constexpr (op == MinusAssign)    { NUMBER_OF(left) -= b; return left; }
+    else if constexpr (op == MultiplyAssign) { NUMBER_OF(left) *= b; return left; }
+    else if constexpr (op == DivideAssign)   { NUMBER_OF(left) /= b; return left; }
+    else if constexpr (op == PowerAssign)    { NUMBER_OF(left) = pow(a, b); return left; }
+    else throw InternalException("unexpected number operator");
+}
+
+template <Operator op>
+static consteval bool hasStringKernel() {
+    using enum Operator;
+    return op == Equal || op == NotEqual
+        || op == Less  || op == Greater || op == LessEqual || op == GreaterEqual
+        || op == Plus  || op == PlusAssign;
+}
+
+template <Operator op>
+static SharedValue stringKernel(const SharedValue &left, const std::string &b) {
+    using enum Operator;
+    const auto &a = STRING_OF(left);
+    if constexpr (op == Equal)             return std::make_shared<BooleanValue>(a == b);
+    else if constexpr (op == NotEqual)     return std::make_shared<BooleanValue>(a != b);
+    else if constexpr (op == Less)         return std::make_shared<BooleanValue>(a <  b);
+    else if constexpr (op == Greater)      return std::make_shared<BooleanValue>(a >  b);
+    else if constexpr (op == LessEqual)    return std::make_shared<BooleanValue>(a <= b);
+    else if constexpr (op == GreaterEqual) return std::make_shared<BooleanValue>(a >= b);
+    else if constexpr (op == Plus)         return std::make_shared<StringValue>(a + b);
+    else if constexpr (op == PlusAssign)   { STRING_OF(left) += b; return left; }
+    else throw InternalException("unexpected string operator");
+}
+
+template <Operator op>
+static SharedValue numbersBinary(const SharedValue &left, const SharedValue &right) {
+    using enum Operator;
+    if constexpr (op == Equal)         return std::make_shared<BooleanValue>(left == right || NUMBER_OF(left) == NUMBER_OF(right));
+    else if constexpr (op == NotEqual) return std::make_shared<BooleanValue>(left != right && NUMBER_OF(left) != NUMBER_OF(right));
+    else if constexpr (hasNumberKernel<op>()) return numberKernel<op>(left, NUMBER_OF(right));
+    else return genericBinary<op>(left, right);
+}
+
+template <Operator op>
+static SharedValue booleansBinary(const SharedValue &left, const SharedValue &right) {
+    using enum Operator;
+    const auto a = BOOLEAN_OF(left);
+    const auto b = BOOLEAN_OF(right);
+    if constexpr (op == Or)            return std::make_shared<BooleanValue>(a || b);
+    else if constexpr (op == And)      return std::make_shared<BooleanValue>(a && b);
+    else if constexpr (op == Equal)    return std::make_shared<BooleanValue>(a == b);
+    else if constexpr (op == NotEqual) return std::make_shared<BooleanValue>(a != b);
+    else return genericBinary<op>(left, right);
+}
+
+static SharedValue negateNumber(const SharedValue &value) {
+    return std::make_shared<NumberValue>(-NUMBER_OF(value));
+}
+
+static SharedValue notBoolean(const SharedValue &value) {
+    return std::make_shared<BooleanValue>(!BOOLEAN_OF(value));
+}
+
+// tables
+
+template <Operator op>
+static consteval BinaryRow makeBinaryRow() {
+    BinaryRow row {};
+    for (auto &line : row) {
+        line.fill(&genericBinary<op>);
+    }
+    constexpr auto number = static_cast<size_t>(NumberType);
+    constexpr auto boolean = static_cast<size_t>(BooleanType);
+    row[number][number] = &numbersBinary<op>;
+    row[boolean][boolean] = &booleansBinary<op>;
+    return row;
+}
+
+template <size_t... indices>
+static consteval auto makeBinaryTable(std::index_sequence<indices...>) {
+    return std::array<BinaryRow, OPERATORS> { makeBinaryRow<static_cast<Operator>(indices)>()... };
+}
+
+template <Operator op>
+static consteval PrefixRow makePrefixRow() {
+    PrefixRow row {};
+    row.fill(&genericPrefix<op>);
+    if constexpr (op == Operator::Negate) {
+        row[static_cast<size_t>(NumberType)] = &negateNumber;
+    }
+    if constexpr (op == Operator::Not) {
+        row[static_cast<size_t>(BooleanType)] = &notBoolean;
+    }
+    return row;
+}
+
+template <size_t... indices>
+static consteval auto makePrefixTable(std::index_sequence<indices...>) {
+    return std::array<PrefixRow, OPERATORS> { makePrefixRow<static_cast<Operator>(indices)>()... };
+}
+
+static constexpr auto BINARY_TABLE = makeBinaryTable(std::make_index_sequence<OPERATORS>());
+static constexpr auto PREFIX_TABLE = makePrefixTable(std::make_index_sequence<OPERATORS>());
+
+const BinaryRow& operators::binaryRow(Operator op) {
+    return BINARY_TABLE[static_cast<size_t>(op)];
+}
+
+const PrefixRow& operators::prefixRow(Operator op) {
+    return PREFIX_TABLE[static_cast<size_t>(op)];
+}
+
+template <size_t... indices>
+static consteval auto makeNumberKernels(std::index_sequence<indices...>) {
+    return std::array<NumberKernel, OPERATORS> {
+        (hasNumberKernel<static_cast<Operator>(indices)>() ? &numberKernel<static_cast<Operator>(indices)> : nullptr)...
+    };
+}
+
+template <size_t... indices>
+static consteval auto makeStringKernels(std::index_sequence<indices...>) {
+    return std::array<StringKernel, OPERATORS> {
+        (hasStringKernel<static_cast<Operator>(indices)>() ? &stringKernel<static_cast<Operator>(indices)> : nullptr)...
+    };
+}
+
+static constexpr auto NUMBER_KERNELS = makeNumberKernels(std::make_index_sequence<OPERATORS>());
+static constexpr auto STRING_KERNELS = makeStringKernels(std::make_index_sequence<OPERATORS>());
+
+// QUICKENING
+
+QuickenedBinary::QuickenedBinary(Operator op, profiles::Feedback* feedback)
+    : row(&binaryRow(op)),
+      numbers(NUMBER_KERNELS[static_cast<size_t>(op)]),
+      strings(STRING_KERNELS[static_cast<size_t>(op)]),
+      state(State::Unobserved),
+      feedback(feedback) {
+    if (feedback == nullptr) return;
+    // a state whose kernel the operator lacks would not be reachable
+    switch (static_cast<State>(*feedback)) {
+        case State::Numbers: if (numbers) state = State::Numbers; break;
+        case State::Strings: if (strings) state = State::Strings; break;
+        case State::Generic: state = State::Generic; break;
+        default: break;
+    }
+}
+
+SharedValue QuickenedBinary::observe(const SharedValue &left, const SharedValue &right) {
+    const auto leftType = left->dataType();
+    const auto rightType = right->dataType();
+    if (state != State::Unobserved) {
+        state = State::Generic;
+    } else if (numbers && leftType == NumberType && rightType == NumberType) {
+        state = State::Numbers;
+    } else if (strings && leftType == StringType && rightType == StringType) {
+        state = State::Strings;
+    } else {
+        state = State::Generic;
+    }
+    if (feedback) {
+        // copies of the site made by inlining share the slot
+        const auto previous = static_cast<State>(*feedback);
+        const auto merged = previous == State::Unobserved || previous == state ? state : State::Generic;
+        *feedback = static_cast<profiles::Feedback>(merged);
+    }
+    return binary(*row, left, right);
+}
+
+SharedValue QuickenedBinary::withNumber(const SharedValue &left, long double right) const {
+    if (numbers && left->dataType() == NumberType) {
+        return numbers(left, right);
+    }
+    return binary(*row, left, std::make_shared<NumberValue>(right));
+}
@@ -0,0 +1,363 @@
+#include "optimizer.h"
+#include "operators.h"
+#include "resolver.h"
+#include "constants.h"
+#include "except.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace interpreter;
+using namespace interpreter::types;
+using namespace interpreter::exceptions;
+
+static StatementPtr emptyBlock(Position position) {
+    std::vector<StatementPtr> statements;
+    return std::make_unique<BlockStatement>(statements, position);
+}
+
+static SharedValue valueOf(const ExpressionPtr &expression) {
+    using enum Expression::ExpressionType;
+    switch (expression->expressionType()) {
+        case NumberLiteral:
+            return std::make_shared<NumberValue>(static_cast<NumberLiteralExpression*>(expression.get())->value);
+        case BooleanLiteral:
+            return std::make_shared<BooleanValue>(static_cast<BooleanLiteralExpression*>(expression.get())->value);
+        case StringLiteral:
+            return std::make_shared<StringValue>(static_cast<StringLiteralExpression*>(expression.get())->value);
+        default:
+            return nullptr;
+    }
+}
+
+static ExpressionPtr literalOf(const SharedValue &value, Position position) {
+    switch (value->dataType()) {
+        case NumberType: {
+            const auto number = static_cast<NumberValue*>(value.get())->value;
+            // keeps the optimized program printable as source
+            if (!std::isfinite(number)) return nullptr;
+            return std::make_unique<NumberLiteralExpression>(number, position);
+        }
+        case BooleanType:
+            return std::make_unique<BooleanLiteralExpression>(static_cast<BooleanValue*>(value.get())->value, position);
+        case StringType: {
+            auto text = static_cast<StringValue*>(value.get())->value;
+            return std::make_unique<StringLiteralExpression>(text, position);
+        }
+        default:
+            return nullptr;
+    }
+}
+
+// compound assignments change their left operand
+static bool isPure(Operator op) {
+    using enum Operator;
+    switch (op) {
+        case PlusAssign: case MinusAssign: case MultiplyAssign:
+        case DivideAssign: case PowerAssign: case Assign: case Unknown:
+            return false;
+        default:
+            return true;
+    }
+}
+
+void Optimizer::optimize(Program &program) {
+    // the engine has to reject an assignment of a
+    // constant even where it would be removed
+    try {
+        Constants::check(program);
+    } catch (const RuntimeException&) {
+        return;
+    }
+    optimizeSequence(program.statements);
+    // constants folded into literals may be propagated,
+    // and the operations on them folded in turn
+    if (Constants::propagate(program)) {
+        optimizeSequence(program.statements);
+    }
+}
+
+// STATEMENTS
+
+void Optimizer::optimizeStatement(StatementPtr &statement) {
+    #define STMT_PTR(TYPE) static_cast<TYPE*>(statement.get())
+    using enum Statement::StatementType;
+    switch (statement->statementType()) {
+        case VariableDeclaration: {
+            const auto declaration = STMT_PTR(VariableDeclarationStatement);
+            if (declaration->value.has_value()) {
+                optimizeExpression(*declaration->value);
+            }
+            return;
+        }
+        case FunctionDeclaration: {
+            const auto function = STMT_PTR(FunctionDeclarationStatement);
+            optimizeFunction(function->parameters, function->body);
+            return;
+        }
+        case ForLoop: {
+            const auto forLoop = STMT_PTR(ForLoopStatement);
+            optimizeExpression(forLoop->start);
+            optimizeExpression(forLoop->end);
+            if (forLoop->step.has_value()) {
+                optimizeExpression(*forLoop->step);
+            }
+            optimizeBody(forLoop->body);
+            return;
+        }
+        case ForInLoop: {
+            const auto forIn = STMT_PTR(ForInLoopStatement);
+            optimizeExpression(forIn->collection);
+            optimizeBody(forIn->body);
+            return;
+        }
+        case WhileLoop: {
+            const auto whileLoop = STMT_PTR(WhileLoopStatement);
+            optimizeExpression(whileLoop->condition);
+            optimizeBody(whileLoop->body);
+            const auto &condition = whileLoop->condition;
+            const auto never = condition->expressionType() == BooleanLiteral
+                && !static_cast<BooleanLiteralExpression*>(condition.get())->value;
+            if (never && !Resolver::declares(whileLoop->body)) {
+                statement.reset();
+            }
+            return;
+        }
+        case IfElse:
+            return optimizeIfElse(statement);
+        case Match: {
+            const auto match = STMT_PTR(MatchStatement);
+            optimizeExpression(match->subject);
+            for (auto &[values, body] : match->cases) {
+                optimizeBody(body);
+            }
+            if (match->elseClause.has_value()) {
+                optimizeBody(*match->elseClause);
+            }
+            return;
+        }
+        case ReturnOperator: {
+            const auto returnOp = STMT_PTR(ReturnOperatorStatement);
+            if (returnOp->expression.has_value()) {
+                optimizeExpression(*returnOp->expression);
+            }
+            return;
+        }
+        case Yield:
+            return optimizeExpression(STMT_PTR(YieldStatement)->expression);
+        case BareExpression:
+            return optimizeExpression(STMT_PTR(ExpressionStatement)->expression);
+        case Echo:
+            return optimizeExpression(STMT_PTR(EchoStatement)->expression);
+        case BlockOfStatements:
+            return optimizeSequence(STMT_PTR(BlockStatement)->statements);
+        default:
+            return;
+    }
+}
+
+// bodies of loops, conditionals and functions can not be removed
+void Optimizer::optimizeBody(StatementPtr &body) {
+    const auto position = body->position;
+    optimizeStatement(body);
+    if (!body) {
+        body = emptyBlock(position);
+    }
+}
+
+void Optimizer::optimizeSequence(std::vector<StatementPtr> &statements) {
+    for (auto &each : statements) {
+        optimizeStatement(each);
+    }
+    std::erase_if(statements, [](const StatementPtr &each) { return !each; });
+
+    // declarations are kept: unbraced ones define the
+    // layout of the scope, which closures resolve against
+    const auto interruption = std::ranges::find_if(statements, &Optimizer::interrupts);
+    if (interruption != statements.end()) {
+        const auto unreachable = std::remove_if(interruption + 1, statements.end(), [](const StatementPtr &each) {
+            return !Resolver::declares(each);
+        });
+        statements.erase(unreachable, statements.end());
+    }
+}
+
+// a branch that is never taken is dropped only
+// when it declares nothing in the enclosing scope
+void Optimizer::optimizeIfElse(StatementPtr &statement) {
+    const auto ifElse = static_cast<IfElseStatement*>(statement.get());
+    optimizeExpression(ifElse->condition);
+    optimizeBody(ifElse->mainClause);
+    if (ifElse->elseClause.has_value()) {
+        optimizeBody(*ifElse->elseClause);
+    }
+
+    if (ifElse->condition->expressionType() != BooleanLiteral) return;
+    const auto condition = static_cast<BooleanLiteralExpression*>(ifElse->condition.get())->value;
+    if (condition) {
+        if (ifElse->elseClause.has_value() && Resolver::declares(*ifElse->elseClause)) return;
+        auto taken = std::move(ifElse->mainClause);
+        statement = std::move(taken);
+        return;
+    }
+    if (Resolver::declares(ifElse->mainClause)) return;
+    auto taken = ifElse->elseClause.has_value()
+        ? std::move(*ifElse->elseClause)
+        : nullptr;
+    statement = std::move(taken);
+}
+
+bool Optimizer::interrupts(const StatementPtr &statement) {
+    using enum Statement::StatementType;
+    switch (statement->statementType()) {
+        case ReturnOperator:
+        case BreakOperator:
+        case ContinueOperator:
+            return true;
+        case BlockOfStatements:
+            return std::ranges::any_of(STMT_PTR(BlockStatement)->statements, &Optimizer::interrupts);
+        case IfElse: {
+            const auto ifElse = STMT_PTR(IfElseStatement);
+            return ifElse->elseClause.has_value()
+                && interrupts(ifElse->mainClause)
+                && interrupts(*ifElse->elseClause);
+        }
+        case Match: {
+            const auto match = STMT_PTR(MatchStatement);
+            return match->elseClause.has_value()
+                && interrupts(*match->elseClause)
+                && std::ranges::all_of(match->cases, [](const auto &each) { return interrupts(std::get<1>(each)); });
+        }
+        default:
+            return false;
+    }
+}
+
+void Optimizer::optimizeFunction(std::vector<ExpressionPtr> &parameters, StatementPtr &body) {
+    for (auto &each : parameters) {
+        optimizeExpression(each);
+    }
+    optimizeBody(body);
+}
+
+// EXPRESSIONS
+
+void Optimizer::optimizeExpression(ExpressionPtr &expression) {
+    #define EXPR_PTR(TYPE) static_cast<TYPE*>(expression.get())
+    using enum Expression::ExpressionType;
+    switch (expression->expressionType()) {
+        case BinaryOperation: {
+            const auto binOp = EXPR_PTR(BinaryOperationExpression);
+            optimizeExpression(binOp->left);
+            optimizeExpression(binOp->right);
+            if (auto folded = foldBinary(binOp)) {
+                expression = std::move(folded);
+            }
+            return;
+        }
+        case PrefixOperation: {
+            const auto prefOp = EXPR_PTR(PrefixOperationExpression);
+            optimizeExpression(prefOp->expression);
+            if (auto folded = foldPrefix(prefOp)) {
+                expression = std::move(folded);
+            }
+            return;
+        }
+        case Call: {
+            const auto call = EXPR_PTR(CallExpression);
+            optimizeExpression(call->target);
+            for (auto &each : call->arguments) {
+                optimizeExpression(each);
+            }
+            return;
+        }
+        case IndexAccess: {
+            const auto access = EXPR_PTR(IndexAccessExpression);
+            optimizeExpression(access->target);
+            optimizeExpression(access->index);
+            return;
+        }
+        case ArrayLiteral:
+            for (auto &each : EXPR_PTR(ArrayLiteralExpression)->values) {
+                optimizeExpression(each);
+            }
+            return;
+        case Lambda: {
+            const auto lambda = EXPR_PTR(LambdaExpression);
+            optimizeFunction(lambda->parameters, lambda->body);
+            return;
+        }
+        case Object:
+            for (auto &[key, value] : EXPR_PTR(ObjectExpression)->objectList) {
+                optimizeExpression(key);
+                optimizeExpression(value);
+            }
+            return;
+        case Interpolation: {
+            const auto interpolation = EXPR_PTR(InterpolationExpression);
+            for (auto &each : interpolation->parts) {
+                optimizeExpression(each);
+            }
+            if (auto folded = foldInterpolation(interpolation)) {
+                expression = std::move(folded);
+            }
+            return;
+        }
+        default:
+            return;
+    }
+}
+
+ExpressionPtr Optimizer::foldBinary(const BinaryOperationExpression *expression) {
+    if (!isPure(expression->opcode)) return nullptr;
+    const auto left = valueOf(expression->left);
+    const auto right = valueOf(expression->right);
+    if (!left || !right) return nullptr;
+    try {
+        const auto result = operators::binary(operators::binaryRow(expression->opcode), left, right);
+        return literalOf(result, expression->position);
+    } catch (const RuntimeException&) {
+        return nullptr;
+    }
+}
+
+ExpressionPtr Optimizer::foldPrefix(const PrefixOperationExpression *expression) {
+    if (expression->opcode == Operator::Unknown) return nullptr;
+    const auto value = valueOf(expression->expression);
+    if (!value) return nullptr;
+    try {
+        const auto result = operators::prefix(operators::prefixRow(expression->opcode), value);
+        return literalOf(result, expression->position);
+    } catch (const RuntimeException&) {
+        return nullptr;
+    }
+}
+
+// neighbouring literal parts are joined into one text,
+// the interpolation folds once nothing else is left in it
+ExpressionPtr Optimizer::foldInterpolation(InterpolationExpression *expression) {
+    auto &parts = expression->parts;
+    std::vector<ExpressionPtr> joined;
+    std::vector<SharedValue> run;
+    Position runPosition { 0, 0 };
+    const auto flush = [&] {
+        if (run.empty()) return;
+        auto text = static_cast<StringValue*>(concatenate(run).get())->value;
+        joined.push_back(std::make_unique<StringLiteralExpression>(text, runPosition));
+        run.clear();
+    };
+    for (auto &each : parts) {
+        if (auto value = valueOf(each)) {
+            if (run.empty()) runPosition = each->position;
+            run.push_back(std::move(value));
+            continue;
+        }
+        flush();
+        joined.push_back(std::move(each));
+    }
+    flush();
+    parts = std::move(joined);
+    if (parts.size() == 1 && parts[0]->expressionType() == Expression::ExpressionType::StringLiteral) {
+        return std::move(parts[0]);
+    }
+    return nullptr;
+}
@@ -26,15 +26,29 @@
 using namespace interpreter::types;
 using enum AnyValue::DataType;
 
+// elements of an array, or values of a generator, one after another
+static IteratorValue elementsOf(const SharedValue &value) {
+    if (value->dataType() != GeneratorType) {
+        getCastedPointer<ArrayType, ArrayObject>(value);
+    }
+    return IteratorValue(value);
+}
+
+const std::map<std::string, long double>& interpreter::prelude::getConstants() {
+    const static std::map<std::string, long double> constantsMap {
+            {"PI", 3.14159265},
+            {"EXP", 2.718},
+    };
+    return constantsMap;
+}
+
 const std::map<std::string, SharedValue>& interpreter::prelude::getPrelude() {
     const static std::map<std::string, SharedValue>& preludeMap {
-            {"PI", NUMBER(3.14159265)},
-            {"EXP", NUMBER(2.718)},
             {"exports", OBJECT()},
             {"size", std::make_shared<BuiltinFunction>([](auto args) -> SharedValue {
                 ARGS_SIZE(1)
                 const auto arrayPtr = getCastedPointer<ArrayType, ArrayObject>(args[0]);
-                return NUMBER(arrayPtr->value.size());
+                return NUMBER(arrayPtr->size());
             })},
             {"chars", std::make_shared<BuiltinFunction>([](auto args) -> SharedValue {
                 ARGS_SIZE(1)
@@ -55,8 +69,9 @@ const std::map<std::string, SharedValue>& interpreter::prelude::getPrelude() {
             })},
             {"all", std::make_shared<BuiltinFunction>([](auto args) -> SharedValue {
                 ARGS_SIZE(1)
-                const auto arrayPtr = getCastedPointer<ArrayType, ArrayObject>(args[0]);
-                for (const auto &each : arrayPtr->value) {
+                auto iterator = elementsOf(args[0]);
+                SharedValue each;
+                while (iterator.next(nullptr, &each)) {
                     const auto booleanPtr = getCastedPointer<BooleanType, BooleanValue>(each);
                     if (!booleanPtr->value) return BOOL(false);
                 }
@@ -64,8 +79,9 @@ const std::map<std::string, SharedValue>& interpreter::prelude::getPrelude() {
             })},
             {"any", std::make_shared<BuiltinFunction>([](auto args) -> SharedValue {
                 ARGS_SIZE(1)
-                const auto arrayPtr = getCastedPointer<ArrayType, ArrayObject>(args[0]);
-                for (const auto &each : arrayPtr->value) {
+                auto iterator = elementsOf(args[0]);
+                SharedValue each;
+                while (iterator.next(nullptr, &each)) {
                     const auto booleanPtr = getCastedPointer<BooleanType, BooleanValue>(each);
                     if (booleanPtr->value) return BOOL(true);
                 }
@@ -110,7 +126,7 @@ const std::map<std::string, SharedValue>& interpreter::prelude::getPrelude() {
                     case StringType:
                         return BOOL(!static_cast<StringValue*>(value.get())->value.empty());
                     case ArrayType:
-                        return BOOL(!static_cast<ArrayObject*>(value.get())->value.empty());
+                        return BOOL(static_cast<ArrayObject*>(value.get())->size() != 0);
                     default:
                         return BOOL(true);
                 }
@@ -138,10 +154,10 @@ const std::map<std::string, SharedValue>& interpreter::prelude::getPrelude() {
             })},
             {"max", std::make_shared<BuiltinFunction>([](auto args) -> SharedValue {
                 ARGS_SIZE(1)
-                const auto arrayPtr = getCastedPointer<ArrayType, ArrayObject>(args[0]);
-                if (arrayPtr->value.empty()) return NIL;
-                auto maximal = arrayPtr->value[0];
-                for (const auto& each : arrayPtr->value) {
+                auto iterator = elementsOf(args[0]);
+                SharedValue maximal, each;
+                if (!iterator.next(nullptr, &maximal)) return NIL;
+                while (iterator.next(nullptr, &each)) {
                     const auto result = *each > maximal;
                     const auto boolResult = static_cast<BooleanValue*>(result.get());
                     if (boolResult->value) maximal = each;
@@ -150,10 +166,10 @@ const std::map<std::string, SharedValue>& interpreter::prelude::getPrelude() {
             })},
             {"min", std::make_shared<BuiltinFunction>([](auto args) -> SharedValue {
                 ARGS_SIZE(1)
-                const auto arrayPtr = getCastedPointer<ArrayType, ArrayObject>(args[0]);
-                if (arrayPtr->value.empty()) return NIL;
-                auto minimal = arrayPtr->value[0];
-                for (const auto& each : arrayPtr->value) {
+                auto iterator = elementsOf(args[0]);
+                SharedValue minimal, each;
+                if (!iterator.next(nullptr, &minimal)) return NIL;
+                while (iterator.next(nullptr, &each)) {
                     const auto result = *each < minimal;
                     const auto boolResult = static_cast<BooleanValue*>(result.get());
                     if (boolResult->value) minimal = each;
@@ -162,25 +178,10 @@ const std::map<std::string, SharedValue>& interpreter::prelude::getPrelude() {
             })},
             {"range", std::make_shared<BuiltinFunction>([](auto args) -> SharedValue {
                 ARGS_SIZE(3)
-
                 const auto start = getCastedPointer<NumberType, NumberValue>(args[0])->value;
                 const auto end   = getCastedPointer<NumberType, NumberValue>(args[1])->value;
                 const auto step  = getCastedPointer<NumberType, NumberValue>(args[2])->value;
-
-                if (step == 0) return NIL;
-                if (start < end && step < 0) return NIL;
-                if (start > end && step > 0) return NIL;
-
-                std::vector<SharedValue> rangeVector;
-                long double counter = start;
-                while (true) {
-                    if      (counter >= end && step > 0) break;
-                    else if (counter <= end && step < 0) break;
-                    rangeVector.push_back(NUMBER(counter));
-                    counter += step;
-                }
-
-                return ARRAY(rangeVector);
+                return ArrayObject::range(start, end, step);
             })},
             {"typeof", std::make_shared<BuiltinFunction>([](auto args) -> SharedValue {
                 ARGS_SIZE(1)
@@ -192,11 +193,25 @@ const std::map<std::string, SharedValue>& interpreter::prelude::getPrelude() {
             })},
             {"sum", std::make_shared<BuiltinFunction>([](auto args) -> SharedValue {
                 ARGS_SIZE(1)
-                const auto arrayPtr = getCastedPointer<ArrayType, ArrayObject>(args[0]);
-                if (arrayPtr->value.empty()) return NIL;
-                auto output = arrayPtr->value[0];
-                for (size_t i = 1; i < arrayPtr->value.size(); i++) {
-                    *output += arrayPtr->value[i];
+                // numbers of a range are added without making values of them
+                const auto numbers = args[0]->dataType() == ArrayType
+                    ? static_cast<ArrayObject*>(args[0].get())->numbers
+                    : std::nullopt;
+                if (numbers) {
+                    if (numbers->length == 0) return NIL;
+                    auto counter = numbers->first;
+                    auto total = counter;
+                    for (size_t i = 1; i < numbers->length; i++) {
+                        counter += numbers->step;
+                        total += counter;
+                    }
+                    return NUMBER(total);
+                }
+                auto iterator = elementsOf(args[0]);
+                SharedValue output, each;
+                if (!iterator.next(nullptr, &output)) return NIL;
+                while (iterator.next(nullptr, &each)) {
+                    *output += each;
                 }
                 return output;
             })},
@@ -206,6 +221,17 @@ const std::map<std::string, SharedValue>& interpreter::prelude::getPrelude() {
                 const auto start = getCastedPointer<NumberType, NumberValue>(args[1])->value;
                 if (start < 0) return NIL;
                 const auto end = getCastedPointer<NumberType, NumberValue>(args[2])->value;
+                // a slice of a range is a range counted on from its first number
+                if (arrayPtr->numbers) {
+                    const auto from = static_cast<size_t>(start);
+                    const auto to = std::min(static_cast<size_t>(end), arrayPtr->size());
+                    const auto step = arrayPtr->numbers->step;
+                    auto first = arrayPtr->numbers->first;
+                    for (size_t i = 0; i < from && i < to; i++) {
+                        first += step;
+                    }
+                    return std::make_shared<ArrayObject>(ArrayObject::Numbers { first, step, to > from ? to - from : 0 });
+                }
                 std::vector<SharedValue> newArray;
                 for (size_t i = start; i < std::min(static_cast<size_t>(end), arrayPtr->value.size()); i++) {
                     newArray.push_back(arrayPtr->value[i]);
@@ -215,9 +241,11 @@ const std::map<std::string, SharedValue>& interpreter::prelude::getPrelude() {
             {"reversed", std::make_shared<BuiltinFunction>([](auto args) -> SharedValue {
                 ARGS_SIZE(1)
                 const auto arrayPtr = getCastedPointer<ArrayType, ArrayObject>(args[0]);
-                std::vector<SharedValue> newArray(arrayPtr->value.size());
-                for (size_t i = 0; i < arrayPtr->value.size(); i++) {
-                    newArray[i] = arrayPtr->value[arrayPtr->value.size() - i - 1];
+                const auto size = arrayPtr->size();
+                std::vector<SharedValue> newArray(size);
+                long double counter = 0;
+                for (size_t i = 0; i < size; i++) {
+                    newArray[size - i - 1] = arrayPtr->walk(i, counter);
                 }
                 return ARRAY(newArray);
             })},
@@ -269,7 +297,7 @@ const std::map<std::string, SharedValue>& interpreter::prelude::getPrelude() {
             {"keys", std::make_shared<BuiltinFunction>([](auto args) -> SharedValue {
                 ARGS_SIZE(1)
                 const auto obj = getCastedPointer<ObjectType, UserObject>(args[0]);
-                auto keys = utils::mapKeys(obj->value);
+                auto keys = obj->keys();
                 std::vector<SharedValue> values(keys.size());
                 for (size_t i = 0; i < keys.size(); i++) {
                     values[i] = STRING(keys[i]);
@@ -279,7 +307,7 @@ const std::map<std::string, SharedValue>& interpreter::prelude::getPrelude() {
             {"values", std::make_shared<BuiltinFunction>([](auto args) -> SharedValue {
                 ARGS_SIZE(1)
                 const auto obj = getCastedPointer<ObjectType, UserObject>(args[0]);
-                auto values = utils::mapValues(obj->value);
+                auto values = obj->values();
                 return ARRAY(values);
             })},
             {"wait", std::make_shared<BuiltinFunction>([](auto args) -> SharedValue {
@@ -0,0 +1,131 @@
+#include "profiles.h"
+#include <fstream>
+#include <sstream>
+
+using namespace interpreter;
+using namespace interpreter::profiles;
+using namespace parser::AST;
+
+static const std::string HEADER = "toy profile 2";
+// property caches of the first version told objects apart rather than
+// shapes, their feedback is dropped as if the files had changed
+static const std::string OUTDATED = "toy profile 1";
+
+struct Profile {
+    bool enabled = false;
+    std::map<std::string, Source> sources;
+    // files hashed in this run, by name, nullptr for unreadable ones.
+    // A file is read once: feedback is dropped at most once per run,
+    // and the programs streamed from it do not read it again
+    std::map<std::string, Source*> hashed;
+};
+
+static Profile& profile() {
+    static Profile instance;
+    return instance;
+}
+
+// FNV-1a, stable across builds unlike std::hash
+static std::uint64_t hashContents(std::istream &stream) {
+    std::uint64_t hash = 14695981039346656037ull;
+    char buffer[4096];
+    while (stream.read(buffer, sizeof(buffer)) || stream.gcount() > 0) {
+        for (std::streamsize i = 0; i < stream.gcount(); i++) {
+            hash ^= static_cast<unsigned char>(buffer[i]);
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+Feedback* Source::site(SiteKind kind, const Node* node, Position detail) {
+    return &sites[{ static_cast<char>(kind), node->position, detail }];
+}
+
+Position profiles::detail(const BinaryOperationExpression* operation) {
+    return operation->right->position;
+}
+
+Position profiles::detail(const IndexAccessExpression* access) {
+    unsigned links = 0;
+    const Expression* target = access->target.get();
+    while (true) {
+        using enum Expression::ExpressionType;
+        if (target->expressionType() == IndexAccess) {
+            target = static_cast<const IndexAccessExpression*>(target)->target.get();
+        } else if (target->expressionType() == Call) {
+            target = static_cast<const CallExpression*>(target)->target.get();
+        } else {
+            return { links, 0 };
+        }
+        links++;
+    }
+}
+
+void profiles::enable() {
+    profile().enabled = true;
+}
+
+Source* profiles::source(const std::string &filename) {
+    if (!profile().enabled) return nullptr;
+    const auto [hashed, first] = profile().hashed.try_emplace(filename, nullptr);
+    if (!first) return hashed->second;
+    std::ifstream filestream(filename, std::ios::binary);
+    if (!filestream.is_open()) return nullptr;
+    const auto hash = hashContents(filestream);
+    auto &source = profile().sources[filename];
+    if (source.hash != hash) {
+        source.hash = hash;
+        source.sites.clear();
+    }
+    return hashed->second = &source;
+}
+
+bool profiles::load(const std::string &path) {
+    std::ifstream filestream(path);
+    if (!filestream.is_open()) return false;
+    std::string line;
+    if (!std::getline(filestream, line)) return false;
+    if (line == OUTDATED) return true;
+    if (line != HEADER) return false;
+
+    Source* current = nullptr;
+    while (std::getline(filestream, line)) {
+        std::istringstream stream(line);
+        std::string kind;
+        stream >> kind;
+        if (kind == "file") {
+            std::uint64_t hash;
+            if (!(stream >> std::hex >> hash)) return false;
+            stream.get();
+            std::string filename;
+            std::getline(stream, filename);
+            current = &profile().sources[filename];
+            current->hash = hash;
+            continue;
+        }
+        unsigned nodeLine, nodeColumn, detailLine, detailColumn, feedback;
+        stream >> nodeLine >> nodeColumn >> detailLine >> detailColumn >> feedback;
+        if (!stream || current == nullptr || kind.size() != 1 || feedback > 255) return false;
+        const Source::Key key { kind[0], { nodeLine, nodeColumn }, { detailLine, detailColumn } };
+        current->sites[key] = static_cast<Feedback>(feedback);
+    }
+    return true;
+}
+
+bool profiles::save(const std::string &path) {
+    std::ofstream filestream(path);
+    if (!filestream.is_open()) return false;
+    filestream << HEADER << '\n';
+    for (const auto &[filename, source] : profile().sources) {
+        filestream << "file " << std::hex << source.hash << std::dec << ' ' << filename << '\n';
+        for (const auto &[key, feedback] : source.sites) {
+            // sites compiled but never run have nothing to pass on
+            if (feedback == 0) continue;
+            const auto &[kind, node, detail] = key;
+            filestream << kind << ' ' << std::get<0>(node) << ' ' << std::get<1>(node) << ' '
+                << std::get<0>(detail) << ' ' << std::get<1>(detail) << ' ' << static_cast<unsigned>(feedback) << '\n';
+        }
+    }
+    return filestream.good();
+}
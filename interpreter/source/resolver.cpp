@@ -0,0 +1,413 @@
+#include "resolver.h"
+#include "inliner.h"
+#include "except.h"
+#include <algorithm>
+
+using namespace interpreter;
+using namespace interpreter::exceptions;
+
+Resolver::Resolver(Options options, tiers::Unit* program, profiles::Source* profile, std::weak_ptr<const Node> tree)
+    : frames{nullptr},
+      functions(),
+      program(program),
+      profile(profile),
+      tree(std::move(tree)),
+      inlinable(std::make_shared<std::map<std::string, const FunctionDeclarationStatement*>>()),
+      options(options) {}
+
+// Declarations land in the scope that is current at runtime:
+// unbraced bodies of loops and conditionals do not create
+// their own scope, nested blocks and functions do
+void Resolver::collectDeclarations(const StatementPtr &statement, ScopeLayout &layout) {
+    using enum Statement::StatementType;
+    switch (statement->statementType()) {
+        case LibraryImport: {
+            const auto import = static_cast<ImportLibraryStatement*>(statement.get());
+            layout.add(import->alias.value_or(import->libName));
+            return;
+        }
+        case VariableDeclaration:
+            layout.add(static_cast<VariableDeclarationStatement*>(statement.get())->name);
+            return;
+        case FunctionDeclaration:
+            layout.add(static_cast<FunctionDeclarationStatement*>(statement.get())->name);
+            return;
+        case WhileLoop:
+            collectDeclarations(static_cast<WhileLoopStatement*>(statement.get())->body, layout);
+            return;
+        case IfElse: {
+            const auto ifElse = static_cast<IfElseStatement*>(statement.get());
+            collectDeclarations(ifElse->mainClause, layout);
+            if (ifElse->elseClause.has_value()) {
+                collectDeclarations(*ifElse->elseClause, layout);
+            }
+            return;
+        }
+        case Match: {
+            const auto match = static_cast<MatchStatement*>(statement.get());
+            for (const auto &[values, body] : match->cases) {
+                collectDeclarations(body, layout);
+            }
+            if (match->elseClause.has_value()) {
+                collectDeclarations(*match->elseClause, layout);
+            }
+            return;
+        }
+        default:
+            return;
+    }
+}
+
+std::shared_ptr<ScopeLayout> Resolver::blockLayout(const std::vector<StatementPtr> &statements) {
+    auto layout = std::make_shared<ScopeLayout>();
+    for (const auto &each : statements) {
+        collectDeclarations(each, *layout);
+    }
+    return layout;
+}
+
+std::shared_ptr<ScopeLayout> Resolver::forLoopLayout(const ForLoopStatement *forLoop) {
+    auto layout = std::make_shared<ScopeLayout>();
+    layout->add(forLoop->variable);
+    collectDeclarations(forLoop->body, *layout);
+    return layout;
+}
+
+std::shared_ptr<ScopeLayout> Resolver::forInLoopLayout(const ForInLoopStatement *forIn) {
+    auto layout = std::make_shared<ScopeLayout>();
+    for (const auto &each : forIn->variables) {
+        layout->add(each);
+    }
+    collectDeclarations(forIn->body, *layout);
+    return layout;
+}
+
+std::shared_ptr<ScopeLayout> Resolver::parametersLayout (
+    const std::vector<std::string> &parameters,
+    const StatementPtr &body
+) {
+    auto layout = std::make_shared<ScopeLayout>();
+    for (const auto &each : parameters) {
+        layout->add(each);
+    }
+    collectDeclarations(body, *layout);
+    return layout;
+}
+
+bool Resolver::declares(const StatementPtr &statement) {
+    ScopeLayout layout;
+    collectDeclarations(statement, layout);
+    return !layout.names.empty();
+}
+
+bool Resolver::yields(const StatementPtr &statement) {
+    #define STMT_PTR(TYPE) static_cast<TYPE*>(statement.get())
+    using enum Statement::StatementType;
+    switch (statement->statementType()) {
+        case Yield:
+            return true;
+        case ForLoop:
+            return yields(STMT_PTR(ForLoopStatement)->body);
+        case ForInLoop:
+            return yields(STMT_PTR(ForInLoopStatement)->body);
+        case WhileLoop:
+            return yields(STMT_PTR(WhileLoopStatement)->body);
+        case IfElse: {
+            const auto ifElse = STMT_PTR(IfElseStatement);
+            return yields(ifElse->mainClause) || (ifElse->elseClause.has_value() && yields(*ifElse->elseClause));
+        }
+        case Match: {
+            const auto match = STMT_PTR(MatchStatement);
+            const auto inCases = std::ranges::any_of(match->cases, [](const auto &each) {
+                return yields(std::get<1>(each));
+            });
+            return inCases || (match->elseClause.has_value() && yields(*match->elseClause));
+        }
+        case BlockOfStatements:
+            return std::ranges::any_of(STMT_PTR(BlockStatement)->statements, [](const auto &each) {
+                return yields(each);
+            });
+        default:
+            return false;
+    }
+    #undef STMT_PTR
+}
+
+bool Resolver::mentions(const StatementPtr &statement, const std::string &name) {
+    #define STMT_PTR(TYPE) static_cast<TYPE*>(statement.get())
+    using enum Statement::StatementType;
+    switch (statement->statementType()) {
+        case LibraryImport: {
+            const auto import = STMT_PTR(ImportLibraryStatement);
+            return import->alias.value_or(import->libName) == name;
+        }
+        case VariableDeclaration: {
+            const auto declaration = STMT_PTR(VariableDeclarationStatement);
+            return declaration->name == name
+                || (declaration->value.has_value() && mentions(*declaration->value, name));
+        }
+        case FunctionDeclaration: {
+            const auto function = STMT_PTR(FunctionDeclarationStatement);
+            if (function->name == name || mentions(function->body, name)) return true;
+            return std::ranges::any_of(function->parameters, [&](const auto &each) { return mentions(each, name); });
+        }
+        case ForLoop: {
+            const auto forLoop = STMT_PTR(ForLoopStatement);
+            return forLoop->variable == name
+                || mentions(forLoop->start, name)
+                || mentions(forLoop->end, name)
+                || (forLoop->step.has_value() && mentions(*forLoop->step, name))
+                || mentions(forLoop->body, name);
+        }
+        case ForInLoop: {
+            const auto forIn = STMT_PTR(ForInLoopStatement);
+            return std::ranges::find(forIn->variables, name) != forIn->variables.end()
+                || mentions(forIn->collection, name)
+                || mentions(forIn->body, name);
+        }
+        case WhileLoop: {
+            const auto whileLoop = STMT_PTR(WhileLoopStatement);
+            return mentions(whileLoop->condition, name) || mentions(whileLoop->body, name);
+        }
+        case IfElse: {
+            const auto ifElse = STMT_PTR(IfElseStatement);
+            return mentions(ifElse->condition, name)
+                || mentions(ifElse->mainClause, name)
+                || (ifElse->elseClause.has_value() && mentions(*ifElse->elseClause, name));
+        }
+        case Match: {
+            const auto match = STMT_PTR(MatchStatement);
+            const auto inCases = std::ranges::any_of(match->cases, [&](const auto &each) {
+                return mentions(std::get<1>(each), name);
+            });
+            return inCases
+                || mentions(match->subject, name)
+                || (match->elseClause.has_value() && mentions(*match->elseClause, name));
+        }
+        case ReturnOperator: {
+            const auto returnOp = STMT_PTR(ReturnOperatorStatement);
+            return returnOp->expression.has_value() && mentions(*returnOp->expression, name);
+        }
+        case Yield:
+            return mentions(STMT_PTR(YieldStatement)->expression, name);
+        case BareExpression:
+            return mentions(STMT_PTR(ExpressionStatement)->expression, name);
+        case BlockOfStatements:
+            return std::ranges::any_of(STMT_PTR(BlockStatement)->statements, [&](const auto &each) {
+                return mentions(each, name);
+            });
+        case Echo:
+            return mentions(STMT_PTR(EchoStatement)->expression, name);
+        case ContinueOperator:
+        case BreakOperator:
+        case StatementError:
+            return false;
+    }
+    return false;
+    #undef STMT_PTR
+}
+
+bool Resolver::mentions(const ExpressionPtr &expression, const std::string &name) {
+    #define EXPR_PTR(TYPE) static_cast<TYPE*>(expression.get())
+    const auto anyOf = [&](const std::vector<ExpressionPtr> &expressions) {
+        return std::ranges::any_of(expressions, [&](const auto &each) { return mentions(each, name); });
+    };
+    using enum Expression::ExpressionType;
+    switch (expression->expressionType()) {
+        case BinaryOperation: {
+            const auto binary = EXPR_PTR(BinaryOperationExpression);
+            return mentions(binary->left, name) || mentions(binary->right, name);
+        }
+        case PrefixOperation:
+            return mentions(EXPR_PTR(PrefixOperationExpression)->expression, name);
+        case Call: {
+            const auto call = EXPR_PTR(CallExpression);
+            return mentions(call->target, name) || anyOf(call->arguments);
+        }
+        case IndexAccess: {
+            const auto access = EXPR_PTR(IndexAccessExpression);
+            return mentions(access->target, name) || mentions(access->index, name);
+        }
+        case ArrayLiteral:
+            return anyOf(EXPR_PTR(ArrayLiteralExpression)->values);
+        case Interpolation:
+            return anyOf(EXPR_PTR(InterpolationExpression)->parts);
+        case Lambda: {
+            const auto lambda = EXPR_PTR(LambdaExpression);
+            return anyOf(lambda->parameters) || mentions(lambda->body, name);
+        }
+        case Variable:
+            return EXPR_PTR(VariableExpression)->name == name;
+        case Object:
+            return std::ranges::any_of(EXPR_PTR(ObjectExpression)->objectList, [&](const auto &pair) {
+                return mentions(std::get<0>(pair), name) || mentions(std::get<1>(pair), name);
+            });
+        case NumberLiteral:
+        case BooleanLiteral:
+        case StringLiteral:
+        case NilLiteral:
+        case ExpressionError:
+            return false;
+    }
+    return false;
+    #undef EXPR_PTR
+}
+
+void Resolver::enterScope(std::shared_ptr<ScopeLayout> layout) {
+    frames.push_back(std::move(layout));
+}
+
+void Resolver::leaveScope() {
+    if (frames.size() == 1) {
+        throw InternalException("trying to leave main scope");
+    }
+    frames.pop_back();
+}
+
+void Resolver::enterFunction(std::shared_ptr<ScopeLayout> layout, CaptureLayout &captures, tiers::Unit &unit) {
+    enterScope(std::move(layout));
+    functions.push_back({ frames.size() - 1, &captures, {}, &unit });
+}
+
+void Resolver::leaveFunction() {
+    leaveScope();
+    functions.pop_back();
+}
+
+bool Resolver::insideFunction() const {
+    return !functions.empty();
+}
+
+tiers::Unit* Resolver::unit() const {
+    return functions.empty() ? program : functions.back().unit;
+}
+
+const Options& Resolver::getOptions() const {
+    return options;
+}
+
+const std::weak_ptr<const Node>& Resolver::getTree() const {
+    return tree;
+}
+
+profiles::Feedback* Resolver::feedback(profiles::SiteKind kind, const Node* node, Position detail) const {
+    return profile ? profile->site(kind, node, detail) : nullptr;
+}
+
+VariableAddress Resolver::resolve(const std::string &name) {
+    const auto innermost = frames.size() - 1;
+    const auto lowest = functions.empty() ? 1 : functions.back().firstFrame;
+    if (!inlined.empty()) {
+        return { innermost - lowest + 1, LexicalScope::globalSymbol(name) };
+    }
+    std::optional<VariableAddress> local;
+    for (auto index = innermost; index >= lowest; index--) {
+        if (const auto slot = frames[index]->slotOf(name)) {
+            local = { innermost - index, *slot };
+            break;
+        }
+    }
+    // variables around the function are captured even when
+    // a local one shadows them: a local variable read before
+    // its declaration has run falls back to them by name
+    std::optional<size_t> captured;
+    for (auto index = lowest - 1; index > 0; index--) {
+        if (const auto slot = frames[index]->slotOf(name)) {
+            const auto capturedIndex = capture(functions.size() - 1, name, index, *slot);
+            captured = captured.value_or(capturedIndex);
+        }
+    }
+    if (local.has_value()) return *local;
+    if (captured.has_value()) return { innermost - lowest, *captured, true };
+    return { innermost - lowest + 1, LexicalScope::globalSymbol(name) };
+}
+
+// source of the capture is addressed from the scope the function is created in:
+// either the cell of a slot there or a capture of the enclosing function
+size_t Resolver::capture(size_t level, const std::string &name, size_t frame, size_t slot) {
+    auto &function = functions[level];
+    const auto key = std::pair(frame, slot);
+    if (const auto it = function.indices.find(key); it != function.indices.end()) {
+        return it->second;
+    }
+    const auto defining = function.firstFrame - 1;
+    const auto enclosingFirst = level == 0 ? 1 : functions[level - 1].firstFrame;
+    VariableAddress source {};
+    if (frame >= enclosingFirst) {
+        frames[frame]->capture(slot);
+        source = { defining - frame, slot };
+    } else {
+        source = { defining - enclosingFirst, capture(level - 1, name, frame, slot), true };
+    }
+    const auto index = function.captures->add(name, source);
+    function.indices.emplace(key, index);
+    return index;
+}
+
+void Resolver::collectInlinable(const std::vector<StatementPtr> &statements) {
+    std::map<std::string, size_t> declarations;
+    for (const auto &each : statements) {
+        ScopeLayout layout;
+        collectDeclarations(each, layout);
+        for (const auto &name : layout.names) {
+            declarations[name]++;
+        }
+    }
+    for (const auto &each : statements) {
+        if (each->statementType() != Statement::StatementType::FunctionDeclaration) continue;
+        const auto function = static_cast<FunctionDeclarationStatement*>(each.get());
+        if (declarations[function->name] == 1 && inliner::inlinable(function, options)) {
+            inlinable->emplace(function->name, function);
+        }
+    }
+}
+
+// Only a global name is resolved to the function: the call still checks
+// at runtime that the variable holds it, as it may be assigned or not yet declared
+const FunctionDeclarationStatement* Resolver::inlineTarget(const ExpressionPtr &target) const {
+    if (target->expressionType() != Expression::ExpressionType::Variable) return nullptr;
+    const auto &name = static_cast<VariableExpression*>(target.get())->name;
+    const auto it = inlinable->find(name);
+    if (it == inlinable->end()) return nullptr;
+    if (std::ranges::find(inlined, it->second) != inlined.end()) return nullptr;
+    if (inlined.empty()) {
+        for (size_t index = 1; index < frames.size(); index++) {
+            if (frames[index]->slotOf(name).has_value()) return nullptr;
+        }
+    } else if (inlinedArgument(name).has_value()) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+void Resolver::enterInlined(const FunctionDeclarationStatement *function) {
+    inlined.push_back(function);
+}
+
+void Resolver::leaveInlined() {
+    inlined.pop_back();
+}
+
+bool Resolver::insideInlined() const {
+    return !inlined.empty();
+}
+
+std::optional<size_t> Resolver::inlinedArgument(const std::string &name) const {
+    if (inlined.empty()) return std::nullopt;
+    const auto &parameters = inlined.back()->parameters;
+    for (size_t i = 0; i < parameters.size(); i++) {
+        if (static_cast<VariableExpression*>(parameters[i].get())->name == name) return i;
+    }
+    return std::nullopt;
+}
+
+size_t Resolver::declare(const std::string &name) const {
+    if (frames.size() == 1) {
+        return LexicalScope::globalSymbol(name);
+    }
+    const auto slot = frames.back()->slotOf(name);
+    if (!slot.has_value()) {
+        throw InternalException("variable '" + name + "' is missing from the scope layout");
+    }
+    return *slot;
+}
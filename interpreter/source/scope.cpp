@@ -1,4 +1,6 @@
 #include "scope.h"
+#include <algorithm>
+#include <unordered_map>
 #include <utility>
 #include "except.h"
 
@@ -6,17 +8,111 @@ using namespace interpreter;
 using namespace interpreter::exceptions;
 using interpreter::types::NilValue;
 
+std::optional<size_t> ScopeLayout::slotOf(const std::string &name) const {
+    const auto position = std::find(names.begin(), names.end(), name);
+    if (position == names.end()) return std::nullopt;
+    return position - names.begin();
+}
+
+size_t ScopeLayout::add(const std::string &name) {
+    if (const auto slot = slotOf(name)) return *slot;
+    names.push_back(name);
+    return names.size() - 1;
+}
+
+void ScopeLayout::capture(size_t slot) {
+    if (std::find(captured.begin(), captured.end(), slot) == captured.end()) {
+        captured.push_back(slot);
+    }
+}
+
+size_t CaptureLayout::add(const std::string &name, const VariableAddress &source) {
+    names.push_back(name);
+    sources.push_back(source);
+    return names.size() - 1;
+}
+
 SharedScope LexicalScope::create() {
     return std::shared_ptr<LexicalScope>(new LexicalScope());
 }
 
-SharedScope LexicalScope::createInner(SharedScope &parent) {
+SharedScope LexicalScope::createInner (
+    SharedScope &parent,
+    const ScopeLayout* layout,
+    std::shared_ptr<const Captures> captures
+) {
     auto inner = LexicalScope::create();
     inner->parent = parent;
+    inner->captures = std::move(captures);
+    if (layout != nullptr) {
+        inner->layout = layout;
+        inner->slots.resize(layout->names.size());
+        if (!layout->captured.empty()) {
+            inner->cells.resize(layout->names.size());
+            for (const auto slot : layout->captured) {
+                inner->cells[slot] = std::make_shared<SharedValue>();
+            }
+        }
+    }
     return inner;
 }
 
+size_t LexicalScope::globalSymbol(const std::string &name) {
+    static std::unordered_map<std::string, size_t> symbols;
+    const auto [position, _] = symbols.try_emplace(name, symbols.size());
+    return position->second;
+}
+
+SharedValue* LexicalScope::findLocal(const std::string &name) {
+    if (!parent.has_value()) {
+        const auto symbol = globalSymbol(name);
+        if (symbol < slots.size() && slots[symbol]) return &slots[symbol];
+        return nullptr;
+    }
+    if (layout != nullptr) {
+        const auto slot = layout->slotOf(name);
+        if (slot.has_value() && place(*slot)) return &place(*slot);
+    }
+    if (const auto position = storage.find(name); position != storage.end()) {
+        return &position->second;
+    }
+    // captured variables stand in for the scopes around the definition
+    return findCaptured(name, 0);
+}
+
+SharedValue* LexicalScope::findCaptured(const std::string &name, size_t from) {
+    if (!captures) return nullptr;
+    const auto &names = captures->layout->names;
+    for (auto index = from; index < names.size(); index++) {
+        if (names[index] == name && *captures->cells[index]) {
+            return captures->cells[index].get();
+        }
+    }
+    return nullptr;
+}
+
+SharedValue& LexicalScope::place(size_t slot) {
+    if (slot < cells.size() && cells[slot]) return *cells[slot];
+    return slots[slot];
+}
+
+LexicalScope* LexicalScope::ancestor(size_t depth) {
+    auto current = this;
+    for (; depth > 0; depth--) {
+        current = current->parent->get();
+    }
+    return current;
+}
+
 void LexicalScope::initVariable(const std::string &name, std::optional<SharedValue> value) {
+    if (!parent.has_value()) {
+        return initSlot(globalSymbol(name), name, value.value_or(NilValue::getInstance()));
+    }
+    if (layout != nullptr) {
+        if (const auto slot = layout->slotOf(name)) {
+            return initSlot(*slot, name, value.value_or(NilValue::getInstance()));
+        }
+    }
     if (storage.find(name) != storage.end()) {
         throw CannotRedeclareException(name);
     }
@@ -28,8 +124,8 @@ void LexicalScope::initVariable(const std::string &name, std::optional<SharedVal
 }
 
 SharedValue LexicalScope::getValue(const std::string &name) {
-    if (storage.find(name) != storage.end()) {
-        return storage[name];
+    if (const auto place = findLocal(name)) {
+        return *place;
     }
     if (!parent.has_value()) {
         throw UndefinedVariableException(name);
@@ -38,8 +134,8 @@ SharedValue LexicalScope::getValue(const std::string &name) {
 }
 
 void LexicalScope::setValue(const std::string &name, SharedValue &value) {
-    if (storage.find(name) != storage.end()) {
-        storage[name] = value;
+    if (const auto place = findLocal(name)) {
+        *place = value;
         return;
     }
     if (!parent.has_value()) {
@@ -48,6 +144,70 @@ void LexicalScope::setValue(const std::string &name, SharedValue &value) {
     (*parent)->setValue(name, value);
 }
 
+void LexicalScope::initSlot(size_t slot, const std::string &name, SharedValue value) {
+    if (slot >= slots.size()) {
+        slots.resize(slot + 1);
+    }
+    auto &holder = place(slot);
+    if (holder) {
+        throw CannotRedeclareException(name);
+    }
+    holder = std::move(value);
+}
+
+SharedValue LexicalScope::getValue(const VariableAddress &address, const std::string &name) {
+    const auto target = ancestor(address.depth);
+    if (address.captured) {
+        if (const auto &value = *target->captures->cells[address.slot]) return value;
+        if (const auto next = target->findCaptured(name, address.slot + 1)) return *next;
+        return (*target->parent)->getValue(name);
+    }
+    if (address.slot < target->slots.size()) {
+        if (const auto &value = target->place(address.slot)) return value;
+    }
+    // declared in that scope, but not yet at this point
+    if (!target->parent.has_value()) {
+        throw UndefinedVariableException(name);
+    }
+    return (*target->parent)->getValue(name);
+}
+
+void LexicalScope::setValue(const VariableAddress &address, const std::string &name, SharedValue &value) {
+    const auto target = ancestor(address.depth);
+    if (address.captured) {
+        auto &cell = *target->captures->cells[address.slot];
+        if (cell) {
+            cell = value;
+        } else if (const auto next = target->findCaptured(name, address.slot + 1)) {
+            *next = value;
+        } else {
+            (*target->parent)->setValue(name, value);
+        }
+        return;
+    }
+    if (address.slot < target->slots.size()) {
+        if (auto &holder = target->place(address.slot)) {
+            holder = value;
+            return;
+        }
+    }
+    if (!target->parent.has_value()) {
+        throw UndefinedVariableException(name);
+    }
+    (*target->parent)->setValue(name, value);
+}
+
+SharedCell LexicalScope::getCell(const VariableAddress &address) {
+    const auto target = ancestor(address.depth);
+    if (address.captured) {
+        return target->captures->cells[address.slot];
+    }
+    if (address.slot < target->cells.size() && target->cells[address.slot]) {
+        return target->cells[address.slot];
+    }
+    throw InternalException("captured variable is not kept in a cell");
+}
+
 std::optional<SharedScope> LexicalScope::getParent() {
     return parent;
-}
\ No newline at end of file
+}
@@ -0,0 +1,35 @@
+#include "tiers.h"
+#include <chrono>
+#include <cmath>
+
+using namespace interpreter;
+
+static const auto processStart = std::chrono::steady_clock::now();
+
+std::vector<tiers::Promotion>& tiers::promotions() {
+    static std::vector<Promotion> instance;
+    return instance;
+}
+
+void tiers::Unit::start(std::string unitLabel, size_t unitThreshold, profiles::Feedback* unitFeedback) {
+    label = std::move(unitLabel);
+    threshold = unitThreshold;
+    feedback = unitFeedback;
+    hot = threshold == 0;
+    if (!hot && feedback && *feedback) promote("profile");
+}
+
+void tiers::Unit::expect(long double loopIterations) {
+    if (hot || !(loopIterations >= static_cast<long double>(threshold - calls - iterations))) return;
+    if (!std::isfinite(loopIterations)) {
+        return promote("endless loop");
+    }
+    promote("loop of " + std::to_string(static_cast<size_t>(loopIterations)) + " iterations");
+}
+
+void tiers::Unit::promote(std::string reason) {
+    hot = true;
+    if (feedback) *feedback = 1;
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - processStart;
+    promotions().push_back({ label, std::move(reason), calls, iterations, elapsed.count() });
+}
@@ -31,6 +31,131 @@ SharedValue interpreter::types::copyForAssignment(const SharedValue &value) {
     }
 }
 
+SharedValue interpreter::types::concatenate(std::span<const SharedValue> values) {
+    // strings are read in place, other values are turned into text first
+    std::vector<std::string> converted;
+    std::vector<const std::string*> texts;
+    converted.reserve(values.size());
+    texts.reserve(values.size());
+    size_t size = 0;
+    for (const auto &value : values) {
+        if (value->dataType() == StringType) {
+            texts.push_back(&static_cast<const StringValue*>(value.get())->value);
+        } else {
+            texts.push_back(&converted.emplace_back(value->toString()));
+        }
+        size += texts.back()->size();
+    }
+    std::string output;
+    output.reserve(size);
+    for (const auto text : texts) {
+        output += *text;
+    }
+    return std::make_shared<StringValue>(std::move(output));
+}
+
+IteratorValue::IteratorValue(SharedValue collection) : collection(std::move(collection)), index(0), counter(0) {
+    switch (this->collection->dataType()) {
+        case ArrayType:
+        case StringType:
+        case ObjectType:
+        case GeneratorType:
+            break;
+        default:
+            throw exceptions::NotIterableException(this->collection->getTypename());
+    }
+}
+
+bool IteratorValue::keyed() const {
+    return collection->dataType() == ObjectType;
+}
+
+bool IteratorValue::next(SharedValue* key, SharedValue* element) {
+    switch (collection->dataType()) {
+        case ArrayType: {
+            const auto array = static_cast<ArrayObject*>(collection.get());
+            if (index >= array->size()) return false;
+            const auto value = array->walk(index, counter);
+            if (element) *element = copyForAssignment(value);
+            break;
+        }
+        case StringType: {
+            const auto &string = static_cast<StringValue*>(collection.get())->value;
+            if (index >= string.size()) return false;
+            if (element) *element = std::make_shared<StringValue>(std::string(1, string[index]));
+            break;
+        }
+        case GeneratorType: {
+            SharedValue value;
+            if (!static_cast<GeneratorObject*>(collection.get())->resume(value)) return false;
+            if (element) *element = std::move(value);
+            break;
+        }
+        default: {
+            // the key visited last is where the next one is looked for,
+            // so keys added right after it are not skipped
+            const auto object = static_cast<UserObject*>(collection.get());
+            const auto &keys = object->shape->slots;
+            const auto entry = index++ == 0 ? keys.begin() : keys.upper_bound(this->key);
+            if (entry == keys.end()) return false;
+            this->key = entry->first;
+            if (key) *key = std::make_shared<StringValue>(entry->first);
+            if (element) *element = copyForAssignment(object->slots[entry->second]);
+            return true;
+        }
+    }
+    if (key) *key = std::make_shared<NumberValue>(static_cast<long double>(index));
+    index++;
+    return true;
+}
+
+SharedValue ArrayObject::range(long double start, long double end, long double step) {
+    if (step == 0) return NilValue::getInstance();
+    if (start < end && step < 0) return NilValue::getInstance();
+    if (start > end && step > 0) return NilValue::getInstance();
+
+    size_t length = 0;
+    for (auto counter = start; step > 0 ? counter < end : counter > end; counter += step) {
+        length++;
+    }
+    return std::make_shared<ArrayObject>(Numbers { start, step, length });
+}
+
+size_t ArrayObject::size() const {
+    return numbers ? numbers->length : value.size();
+}
+
+SharedValue ArrayObject::walk(size_t index, long double &counter) const {
+    if (!numbers) return value[index];
+    counter = index == 0 ? numbers->first : counter + numbers->step;
+    return std::make_shared<NumberValue>(counter);
+}
+
+std::vector<SharedValue>& ArrayObject::elements() {
+    if (numbers) {
+        value.reserve(numbers->length);
+        auto counter = numbers->first;
+        for (size_t i = 0; i < numbers->length; i++) {
+            value.push_back(std::make_shared<NumberValue>(counter));
+            counter += numbers->step;
+        }
+        numbers.reset();
+    }
+    return value;
+}
+
+// elements of an array in a vector of their own
+static std::vector<SharedValue> copyElements(const ArrayObject &array) {
+    if (!array.numbers) return array.value;
+    std::vector<SharedValue> elements;
+    elements.reserve(array.size());
+    long double counter = 0;
+    for (size_t i = 0; i < array.size(); i++) {
+        elements.push_back(array.walk(i, counter));
+    }
+    return elements;
+}
+
 SharedValue NilValue::getInstance() {
     static const auto singleton = std::shared_ptr<NilValue>(new NilValue());
     return singleton;
@@ -38,10 +163,11 @@ SharedValue NilValue::getInstance() {
 
 STRING_FOR(ArrayObject) {
     auto output = std::string("[");
-    for (size_t i = 0; i < value.size(); i++) {
-        const auto elem = value[i];
+    long double counter = 0;
+    for (size_t i = 0; i < size(); i++) {
+        const auto elem = walk(i, counter);
         output += elem->toString();
-        if (i != value.size() - 1) {
+        if (i != size() - 1) {
             output += ", ";
         }
     }
@@ -65,12 +191,83 @@ STRING_FOR(BuiltinFunction) {
     return "built-in";
 }
 
+Shape::~Shape() {
+    if (!parent) return;
+    const auto transition = parent->transitions.find(key);
+    if (transition != parent->transitions.end() && transition->second.expired()) {
+        parent->transitions.erase(transition);
+    }
+}
+
+const std::shared_ptr<Shape>& Shape::empty() {
+    static const auto instance = std::make_shared<Shape>();
+    return instance;
+}
+
+std::shared_ptr<Shape> Shape::with(const std::string &key) {
+    if (!isShared) {
+        slots.try_emplace(key, slots.size());
+        return shared_from_this();
+    }
+    if (slots.size() >= SHARED_KEYS) {
+        auto dictionary = std::make_shared<Shape>(false);
+        dictionary->slots = slots;
+        dictionary->slots.try_emplace(key, slots.size());
+        return dictionary;
+    }
+    auto &transition = transitions[key];
+    if (auto existing = transition.lock()) return existing;
+    auto next = std::make_shared<Shape>();
+    next->slots = slots;
+    next->slots.try_emplace(key, slots.size());
+    next->parent = shared_from_this();
+    next->key = key;
+    transition = next;
+    return next;
+}
+
+UserObject::UserObject(std::map<std::string, SharedValue> value) : shape(Shape::empty()) {
+    for (auto &[key, each] : value) {
+        getPlace(key) = std::move(each);
+    }
+}
+
+SharedValue* UserObject::findPlace(const std::string &key) {
+    const auto position = shape->slots.find(key);
+    if (position == shape->slots.end()) return nullptr;
+    return &slots[position->second];
+}
+
+SharedValue& UserObject::getPlace(const std::string &key) {
+    if (const auto place = findPlace(key)) return *place;
+    shape = shape->with(key);
+    return slots.emplace_back();
+}
+
+std::vector<std::string> UserObject::keys() const {
+    std::vector<std::string> output;
+    output.reserve(slots.size());
+    for (const auto &[key, slot] : shape->slots) {
+        output.push_back(key);
+    }
+    return output;
+}
+
+std::vector<SharedValue> UserObject::values() const {
+    std::vector<SharedValue> output;
+    output.reserve(slots.size());
+    for (const auto &[key, slot] : shape->slots) {
+        output.push_back(slots[slot]);
+    }
+    return output;
+}
+
 STRING_FOR(UserObject) {
     auto output = std::string("obj {");
-    for (const auto& [key, val] : value) {
+    for (const auto& [key, slot] : shape->slots) {
         output += key;
         output += ": ";
-        output += val->toString();
+        output += slots[slot]->toString();
         output += ", ";
     }
     output.erase(output.size() - 2);
@@ -309,12 +506,13 @@ BIN_OP_FOR(ArrayObject, ==) {
     EQUAL_OBJS_BOOL(true)
     NON_EQUAL_TYPES_BOOL(false)
     UNCHECKED_CASTED_OTHER(ArrayObject)
-    if (value.size() != castedOther->value.size()) {
+    if (size() != castedOther->size()) {
         return SHARED_BOOL(false);
     }
-    for (size_t i = 0; i < value.size(); i++) {
-        const auto mineValue = value[i];
-        const auto otherValue = castedOther->value[i];
+    long double mineCounter = 0, otherCounter = 0;
+    for (size_t i = 0; i < size(); i++) {
+        const auto mineValue = walk(i, mineCounter);
+        const auto otherValue = castedOther->walk(i, otherCounter);
         const auto result = static_cast<BooleanValue*>((*mineValue == otherValue).get());
         if (!result->value) {
             return SHARED_BOOL(false);
@@ -327,12 +525,13 @@ BIN_OP_FOR(ArrayObject, !=) {
     EQUAL_OBJS_BOOL(false)
     NON_EQUAL_TYPES_BOOL(true)
     UNCHECKED_CASTED_OTHER(ArrayObject)
-    if (value.size() != castedOther->value.size()) {
+    if (size() != castedOther->size()) {
         return SHARED_BOOL(true);
     }
-    for (size_t i = 0; i < value.size(); i++) {
-        const auto mineValue = value[i];
-        const auto otherValue = castedOther->value[i];
+    long double mineCounter = 0, otherCounter = 0;
+    for (size_t i = 0; i < size(); i++) {
+        const auto mineValue = walk(i, mineCounter);
+        const auto otherValue = castedOther->walk(i, otherCounter);
         const auto result = static_cast<BooleanValue*>((*mineValue == otherValue).get());
         if (!result->value) {
             return SHARED_BOOL(true);
@@ -342,16 +541,17 @@ BIN_OP_FOR(ArrayObject, !=) {
 }
 
 BIN_OP_FOR(ArrayObject, +) {
-    auto newValue = value;
+    auto newValue = copyElements(*this);
     newValue.push_back(other);
     return SHARED_ARRAY(newValue);
 }
 
 BIN_OP_FOR(ArrayObject, *) {
     CHECKED_CASTED_OTHER(NumberType, NumberValue)
+    const auto elements = copyElements(*this);
     std::vector<SharedValue> newValue;
     for (auto i = 0; i < castedOther->value; i++) {
-        for (const auto &each : value) {
+        for (const auto &each : elements) {
             newValue.push_back(each);
         }
     }
@@ -359,12 +559,12 @@ BIN_OP_FOR(ArrayObject, *) {
 }
 
 ASSIGN_FOR(ArrayObject, +=) {
-    value.push_back(other);
+    elements().push_back(other);
 }
 
 ASSIGN_FOR(ArrayObject, *=) {
     CHECKED_CASTED_OTHER(NumberType, NumberValue)
-    const auto oldValue = std::move(value);
+    const auto oldValue = std::move(elements());
     value = {};
     for (auto i = 0; i < castedOther->value; i++) {
         for (const auto &each : oldValue) {
@@ -374,7 +574,7 @@ ASSIGN_FOR(ArrayObject, *=) {
 }
 
 ASSIGN_FOR(ArrayObject, -=) {
-    const auto oldValue = std::move(value);
+    const auto oldValue = std::move(elements());
     value = {};
     for (auto &each : oldValue) {
         const auto boolValue = static_cast<BooleanValue*>((*each != other).get())->value;
@@ -384,7 +584,7 @@ ASSIGN_FOR(ArrayObject, -=) {
 
 BIN_OP_FOR(ArrayObject, -) {
     std::vector<SharedValue> next;
-    for (auto &each : value) {
+    for (auto &each : copyElements(*this)) {
         const auto boolValue = static_cast<BooleanValue*>((*each != other).get())->value;
         if (boolValue) next.push_back(each);
     }
@@ -402,6 +602,17 @@ BIN_OP_FOR(FunctionalObject, !=) {
     return SHARED_BOOL(true);
 }
 
+// GeneratorObject -- pointer eq/neq
+BIN_OP_FOR(GeneratorObject, ==) {
+    EQUAL_OBJS_BOOL(true)
+    return SHARED_BOOL(false);
+}
+
+BIN_OP_FOR(GeneratorObject, !=) {
+    EQUAL_OBJS_BOOL(false)
+    return SHARED_BOOL(true);
+}
+
 // builtin function with C++ code
 BIN_OP_FOR(BuiltinFunction, ==) {
     EQUAL_OBJS_BOOL(true)
@@ -419,14 +630,16 @@ BIN_OP_FOR(UserObject, ==) {
     NON_EQUAL_TYPES_BOOL(false)
     UNCHECKED_CASTED_OTHER(UserObject)
 
-    const auto myKeys = utils::mapKeys(value);
-    const auto otherKeys = utils::mapKeys(castedOther->value);
+    const auto myKeys = keys();
+    const auto otherKeys = castedOther->keys();
     if (!utils::compareVectors(myKeys, otherKeys)) {
         return SHARED_BOOL(false);
     }
 
-    for (const auto& each: myKeys) {
-        const auto result = *value.at(each) != castedOther->value.at(each);
+    const auto myValues = values();
+    const auto otherValues = castedOther->values();
+    for (size_t i = 0; i < myValues.size(); i++) {
+        const auto result = *myValues[i] != otherValues[i];
         const auto boolResult = static_cast<BooleanValue*>(result.get())->value;
         if (boolResult) return SHARED_BOOL(false);
     }
@@ -439,14 +652,16 @@ BIN_OP_FOR(UserObject, !=) {
     NON_EQUAL_TYPES_BOOL(true)
     UNCHECKED_CASTED_OTHER(UserObject)
 
-    const auto myKeys = utils::mapKeys(value);
-    const auto otherKeys = utils::mapKeys(castedOther->value);
+    const auto myKeys = keys();
+    const auto otherKeys = castedOther->keys();
     if (!utils::compareVectors(myKeys, otherKeys)) {
         return SHARED_BOOL(true);
     }
 
-    for (const auto& each: myKeys) {
-        const auto result = *value.at(each) != castedOther->value.at(each);
+    const auto myValues = values();
+    const auto otherValues = castedOther->values();
+    for (size_t i = 0; i < myValues.size(); i++) {
+        const auto result = *myValues[i] != otherValues[i];
         const auto boolResult = static_cast<BooleanValue*>(result.get())->value;
         if (boolResult) return SHARED_BOOL(true);
     }
@@ -0,0 +1,589 @@
+#include "vm/compiler.h"
+#include "resolver.h"
+#include <algorithm>
+
+using namespace interpreter::vm;
+
+#define OPERAND(VALUE) static_cast<unsigned>(VALUE)
+
+// public interface
+
+Compiler::Compiler(Code &code, bool insideFunction, std::vector<std::shared_ptr<ScopeLayout>> frames)
+    : code(code), insideFunction(insideFunction), frames(std::move(frames)), scopeDepth(0), currentPath(-1) {}
+
+// a program runs in the global scope
+std::unique_ptr<Code> Compiler::compileProgram(const Program &program) {
+    auto code = std::make_unique<Code>();
+    auto compiler = Compiler(*code, false, { nullptr });
+    for (const auto &statement : program.statements) {
+        compiler.compileStatement(statement);
+    }
+    compiler.emit(OpCode::ReturnNil);
+    return code;
+}
+
+std::unique_ptr<Code> Compiler::compileFunction (
+    const std::vector<ExpressionPtr> &parameters,
+    const StatementPtr &body,
+    std::vector<std::shared_ptr<ScopeLayout>> enclosing
+) {
+    auto code = std::make_unique<Code>();
+    std::vector<std::string> names;
+    for (const auto &param : parameters) {
+        if (param->expressionType() == Variable) {
+            names.push_back(static_cast<VariableExpression*>(param.get())->name);
+        } else if (param->expressionType() == BinaryOperation) {
+            const auto binOp = static_cast<BinaryOperationExpression*>(param.get());
+            if (binOp->opcode == Operator::Assign && binOp->left->expressionType() == Variable) {
+                names.push_back(static_cast<VariableExpression*>(binOp->left.get())->name);
+            }
+        }
+    }
+    code->frame = Resolver::parametersLayout(names, body);
+    enclosing.push_back(code->frame);
+    auto compiler = Compiler(*code, true, std::move(enclosing));
+    compiler.compileParameters(parameters);
+    code->generator = Resolver::yields(body);
+    if (code->generator) {
+        compiler.emit(OpCode::GeneratorStart);
+    }
+    compiler.compileStatement(body);
+    compiler.emit(OpCode::ReturnNil);
+    return code;
+}
+
+// statements
+
+void Compiler::compileStatement(const StatementPtr &statement) {
+    #define STMT_PTR(TYPE) static_cast<TYPE*>(statement.get())
+    enterPath(statement.get());
+    using enum Statement::StatementType;
+    switch (statement->statementType()) {
+        case LibraryImport:
+            code.imports.push_back(STMT_PTR(ImportLibraryStatement));
+            emit(OpCode::Import, code.imports.size() - 1);
+            break;
+        case VariableDeclaration:
+            compileVariableDeclaration(STMT_PTR(VariableDeclarationStatement));
+            break;
+        case FunctionDeclaration:
+            compileFunctionDeclaration(STMT_PTR(FunctionDeclarationStatement));
+            break;
+        case ForLoop:
+            compileForLoop(STMT_PTR(ForLoopStatement));
+            break;
+        case ForInLoop:
+            compileForInLoop(STMT_PTR(ForInLoopStatement));
+            break;
+        case WhileLoop:
+            compileWhileLoop(STMT_PTR(WhileLoopStatement));
+            break;
+        case IfElse:
+            compileIfElse(STMT_PTR(IfElseStatement));
+            break;
+        case Match:
+            compileMatch(STMT_PTR(MatchStatement));
+            break;
+        case ContinueOperator:
+            compileContinue();
+            break;
+        case BreakOperator:
+            compileBreak();
+            break;
+        case ReturnOperator:
+            compileReturn(STMT_PTR(ReturnOperatorStatement));
+            break;
+        case Yield:
+            compileYield(STMT_PTR(YieldStatement));
+            break;
+        case BlockOfStatements:
+            compileBlock(STMT_PTR(BlockStatement));
+            break;
+        case BareExpression:
+            compileExpression(STMT_PTR(ExpressionStatement)->expression);
+            emit(OpCode::Pop, 1);
+            break;
+        case Echo:
+            compileExpression(STMT_PTR(EchoStatement)->expression);
+            emit(OpCode::Echo);
+            break;
+        case StatementError:
+            emit(OpCode::ThrowErrorNode);
+            break;
+    }
+    leavePath();
+}
+
+void Compiler::compileVariableDeclaration(const VariableDeclarationStatement *declaration) {
+    if (!declaration->value) {
+        emit(OpCode::DeclareNil, declare(declaration->name));
+        return;
+    }
+    compileExpression(*declaration->value);
+    emit(OpCode::CopyValue);
+    emit(OpCode::DeclareVariable, declare(declaration->name));
+}
+
+void Compiler::compileFunctionDeclaration(const FunctionDeclarationStatement *function) {
+    emit(OpCode::MakeFunction, addFunction(function->parameters, function->body));
+    emit(OpCode::DeclareVariable, declare(function->name));
+}
+
+// the loop keeps [end, step, direction, counter] on the stack,
+// just like the interpreter keeps them in its local variables
+void Compiler::compileForLoop(const ForLoopStatement *forLoop) {
+    compileExpression(forLoop->start);
+    compileExpression(forLoop->end);
+    if (forLoop->step.has_value()) {
+        compileExpression(*forLoop->step);
+    } else {
+        emit(OpCode::PushNumber, addNumber(1));
+    }
+    emit(OpCode::ForPrepare);
+    enterScope(Resolver::forLoopLayout(forLoop));
+    const auto counter = declare(forLoop->variable);
+    emit(OpCode::ForDeclare, counter);
+
+    const auto loopStart = emit(OpCode::ForCheck);
+    loops.push_back({ scopeDepth, std::nullopt, {}, {} });
+    compileStatement(forLoop->body);
+    const auto context = loops.back();
+    loops.pop_back();
+
+    for (const auto jump : context.continueJumps) {
+        patchJump(jump);
+    }
+    emit(OpCode::ForStep, counter);
+    emit(OpCode::Jump, loopStart);
+
+    patchJump(loopStart);
+    for (const auto jump : context.breakJumps) {
+        patchJump(jump);
+    }
+    leaveScope();
+    emit(OpCode::Pop, 4);
+}
+
+// the loop keeps its iterator on the stack, the variables
+// are declared once and assigned on every iteration
+void Compiler::compileForInLoop(const ForInLoopStatement *forIn) {
+    compileExpression(forIn->collection);
+    emit(OpCode::IterPrepare);
+    enterScope(Resolver::forInLoopLayout(forIn));
+    std::vector<unsigned> variables;
+    for (const auto &each : forIn->variables) {
+        variables.push_back(declare(each));
+        emit(OpCode::DeclareNil, variables.back());
+    }
+
+    const auto loopStart = emit(variables.size() == 2 ? OpCode::IterNextPair : OpCode::IterNext);
+    for (auto variable = variables.rbegin(); variable != variables.rend(); variable++) {
+        emit(OpCode::StoreSlot, *variable);
+        emit(OpCode::Pop, 1);
+    }
+    loops.push_back({ scopeDepth, loopStart, {}, {} });
+    compileStatement(forIn->body);
+    const auto context = loops.back();
+    loops.pop_back();
+    emit(OpCode::Jump, loopStart);
+
+    patchJump(loopStart);
+    for (const auto jump : context.breakJumps) {
+        patchJump(jump);
+    }
+    leaveScope();
+    emit(OpCode::Pop, 1);
+}
+
+void Compiler::compileWhileLoop(const WhileLoopStatement *whileLoop) {
+    const auto loopStart = code.instructions.size();
+    compileExpression(whileLoop->condition);
+    const auto exitJump = emit(OpCode::JumpIfFalse);
+    loops.push_back({ scopeDepth, loopStart, {}, {} });
+    compileStatement(whileLoop->body);
+    const auto context = loops.back();
+    loops.pop_back();
+    emit(OpCode::Jump, loopStart);
+    patchJump(exitJump);
+    for (const auto jump : context.breakJumps) {
+        patchJump(jump);
+    }
+}
+
+void Compiler::compileIfElse(const IfElseStatement *ifElse) {
+    compileExpression(ifElse->condition);
+    const auto elseJump = emit(OpCode::JumpIfFalse);
+    compileStatement(ifElse->mainClause);
+    if (!ifElse->elseClause.has_value()) {
+        patchJump(elseJump);
+        return;
+    }
+    const auto endJump = emit(OpCode::Jump);
+    patchJump(elseJump);
+    compileStatement(*ifElse->elseClause);
+    patchJump(endJump);
+}
+
+// the arms follow each other, each one jumping to the end;
+// nested matches add their tables meanwhile, so ours is indexed
+void Compiler::compileMatch(const MatchStatement *match) {
+    compileExpression(match->subject);
+    const auto dispatch = code.dispatches.size();
+    code.dispatches.push_back({ DispatchTable(match->cases), {} });
+    emit(OpCode::Dispatch, dispatch);
+    std::vector<size_t> endJumps;
+    for (const auto &[values, body] : match->cases) {
+        code.dispatches[dispatch].targets.push_back(code.instructions.size());
+        compileStatement(body);
+        endJumps.push_back(emit(OpCode::Jump));
+    }
+    code.dispatches[dispatch].targets.push_back(code.instructions.size());
+    if (match->elseClause.has_value()) {
+        compileStatement(*match->elseClause);
+    }
+    for (const auto jump : endJumps) {
+        patchJump(jump);
+    }
+}
+
+// flow operators that have no loop to affect are reported
+// by the interpreter only after the whole function (or top level
+// statement) is over, outside any node -- so they are emitted at the root
+void Compiler::compileContinue() {
+    if (loops.empty()) {
+        emitMisplaced(MisplacedFlow::Continue);
+        return;
+    }
+    auto &context = loops.back();
+    leaveScopesUntil(context.scopeDepth);
+    if (context.continueTarget.has_value()) {
+        emit(OpCode::Jump, *context.continueTarget);
+    } else {
+        context.continueJumps.push_back(emit(OpCode::Jump));
+    }
+}
+
+void Compiler::compileBreak() {
+    if (loops.empty()) {
+        emitMisplaced(MisplacedFlow::Break);
+        return;
+    }
+    auto &context = loops.back();
+    leaveScopesUntil(context.scopeDepth);
+    context.breakJumps.push_back(emit(OpCode::Jump));
+}
+
+void Compiler::compileReturn(const ReturnOperatorStatement *returnOp) {
+    if (insideFunction) {
+        if (returnOp->expression) {
+            compileExpression(*returnOp->expression);
+            emit(OpCode::Return);
+        } else {
+            emit(OpCode::ReturnNil);
+        }
+        return;
+    }
+    if (returnOp->expression) {
+        compileExpression(*returnOp->expression);
+        emit(OpCode::Pop, 1);
+    }
+    emitMisplaced(MisplacedFlow::Return);
+}
+
+// a function yielding anywhere is a generator, so
+// only a yield outside of functions is misplaced
+void Compiler::compileYield(const YieldStatement *yield) {
+    if (!insideFunction) {
+        emit(OpCode::ThrowMisplaced, OPERAND(MisplacedFlow::Yield));
+        return;
+    }
+    compileExpression(yield->expression);
+    emit(OpCode::CopyValue);
+    emit(OpCode::Yield);
+}
+
+void Compiler::compileBlock(const BlockStatement *block) {
+    // a block declaring nothing runs in the enclosing scope
+    auto layout = Resolver::blockLayout(block->statements);
+    if (layout->names.empty()) {
+        for (const auto &each : block->statements) {
+            compileStatement(each);
+        }
+        return;
+    }
+    enterScope(std::move(layout));
+    for (const auto &each : block->statements) {
+        compileStatement(each);
+    }
+    leaveScope();
+}
+
+// expressions
+
+void Compiler::compileExpression(const ExpressionPtr &expression) {
+    #define EXPR_PTR(TYPE) static_cast<TYPE*>(expression.get())
+    enterPath(expression.get());
+    using enum Expression::ExpressionType;
+    switch (expression->expressionType()) {
+        case BinaryOperation:
+            compileBinaryOperation(EXPR_PTR(BinaryOperationExpression));
+            break;
+        case PrefixOperation:
+            compilePrefixOperation(EXPR_PTR(PrefixOperationExpression));
+            break;
+        case Call:
+            compileCall(EXPR_PTR(CallExpression));
+            break;
+        case IndexAccess: {
+            const auto access = EXPR_PTR(IndexAccessExpression);
+            compileExpression(access->target);
+            emit(OpCode::CheckIndexTarget);
+            compileExpression(access->index);
+            emit(OpCode::LoadIndex);
+            break;
+        }
+        case NumberLiteral:
+            emit(OpCode::PushNumber, addNumber(EXPR_PTR(NumberLiteralExpression)->value));
+            break;
+        case BooleanLiteral:
+            emit(OpCode::PushBoolean, OPERAND(EXPR_PTR(BooleanLiteralExpression)->value));
+            break;
+        case StringLiteral:
+            emit(OpCode::PushString, addName(EXPR_PTR(StringLiteralExpression)->value));
+            break;
+        case ArrayLiteral: {
+            const auto &values = EXPR_PTR(ArrayLiteralExpression)->values;
+            for (const auto &each : values) {
+                compileExpression(each);
+            }
+            emit(OpCode::MakeArray, values.size());
+            break;
+        }
+        case NilLiteral:
+            emit(OpCode::PushNil);
+            break;
+        case Variable:
+            emitVariable(EXPR_PTR(VariableExpression)->name, false);
+            break;
+        case Lambda: {
+            const auto lambda = EXPR_PTR(LambdaExpression);
+            emit(OpCode::MakeFunction, addFunction(lambda->parameters, lambda->body));
+            break;
+        }
+        case Object:
+            compileObject(EXPR_PTR(ObjectExpression));
+            break;
+        case Interpolation: {
+            const auto &parts = EXPR_PTR(InterpolationExpression)->parts;
+            for (const auto &each : parts) {
+                compileExpression(each);
+            }
+            emit(OpCode::Concatenate, parts.size());
+            break;
+        }
+        case ExpressionError:
+            emit(OpCode::ThrowErrorNode);
+            break;
+    }
+    leavePath();
+}
+
+void Compiler::compileBinaryOperation(const BinaryOperationExpression *expression) {
+    if (expression->opcode == Operator::Assign) {
+        compileAssignment(expression->left, expression->right);
+        return;
+    }
+    compileExpression(expression->left);
+    // a number on the right is only boxed when the left operand is not one
+    if (expression->opcode != Operator::Unknown && expression->right->expressionType() == NumberLiteral) {
+        const auto number = static_cast<NumberLiteralExpression*>(expression->right.get())->value;
+        emit(OpCode::BinaryWithNumber, addSite(expression->opcode, number));
+        return;
+    }
+    compileExpression(expression->right);
+    if (expression->opcode == Operator::Unknown) {
+        emit(OpCode::ThrowUnsupportedOperator, addName(expression->op));
+    } else {
+        emit(OpCode::BinaryOperation, addSite(expression->opcode));
+    }
+}
+
+// index access on the left side is not evaluated as a node on its own,
+// so its target and index belong to the assignment
+void Compiler::compileAssignment(const ExpressionPtr &left, const ExpressionPtr &right) {
+    compileExpression(right);
+    emit(OpCode::CopyValue);
+    if (left->expressionType() == Variable) {
+        emitVariable(static_cast<VariableExpression*>(left.get())->name, true);
+    } else if (left->expressionType() == IndexAccess) {
+        const auto access = static_cast<IndexAccessExpression*>(left.get());
+        compileExpression(access->target);
+        emit(OpCode::CheckIndexTarget);
+        compileExpression(access->index);
+        emit(OpCode::StoreIndex);
+    } else {
+        emit(OpCode::ThrowExpectedIdentifier);
+    }
+}
+
+void Compiler::compilePrefixOperation(const PrefixOperationExpression *expression) {
+    compileExpression(expression->expression);
+    if (expression->opcode == Operator::Unknown) {
+        emit(OpCode::ThrowUnsupportedOperator, addName(expression->op));
+    } else {
+        emit(OpCode::PrefixOperation, OPERAND(expression->opcode));
+    }
+}
+
+void Compiler::compileCall(const CallExpression *expression) {
+    for (const auto &each : expression->arguments) {
+        compileExpression(each);
+        emit(OpCode::CopyValue);
+    }
+    compileExpression(expression->target);
+    emit(OpCode::Call, expression->arguments.size());
+}
+
+void Compiler::compileObject(const ObjectExpression *objExpr) {
+    for (const auto &[keyExpr, valExpr] : objExpr->objectList) {
+        compileExpression(keyExpr);
+        compileExpression(valExpr);
+    }
+    emit(OpCode::MakeObject, objExpr->objectList.size());
+}
+
+// function prologue
+
+// defaults are evaluated in order before the arguments are bound,
+// a broken parameter fails the call once the ones before it are done
+void Compiler::compileParameters(const std::vector<ExpressionPtr> &parameters) {
+    std::vector<std::string> seen;
+    for (const auto &param : parameters) {
+        const VariableExpression* variable = nullptr;
+        const ExpressionPtr* defaultValue = nullptr;
+        if (param->expressionType() == Variable) {
+            variable = static_cast<VariableExpression*>(param.get());
+        } else if (param->expressionType() == BinaryOperation) {
+            const auto binOp = static_cast<BinaryOperationExpression*>(param.get());
+            if (binOp->opcode == Operator::Assign && binOp->left->expressionType() == Variable) {
+                variable = static_cast<VariableExpression*>(binOp->left.get());
+                defaultValue = &binOp->right;
+            }
+        }
+        if (variable == nullptr) {
+            emit(OpCode::ThrowParameterFormat);
+            return;
+        }
+        const auto &name = variable->name;
+        if (std::ranges::find(seen, name) != seen.end()) {
+            emit(OpCode::ThrowDuplicateParameter, addName(name));
+            return;
+        }
+        seen.push_back(name);
+        code.parameters.push_back({ addName(name), *code.frame->slotOf(name), defaultValue == nullptr });
+        if (defaultValue != nullptr) {
+            compileExpression(*defaultValue);
+            emit(OpCode::CopyValue);
+            emit(OpCode::DeclareVariable, declare(name));
+        }
+    }
+    emit(OpCode::BindArguments);
+}
+
+// helper functions
+
+size_t Compiler::emit(OpCode opCode, unsigned operand) {
+    code.instructions.push_back({ opCode, operand, currentPath });
+    return code.instructions.size() - 1;
+}
+
+void Compiler::emitMisplaced(MisplacedFlow flow) {
+    const auto path = currentPath;
+    currentPath = -1;
+    emit(OpCode::ThrowMisplaced, OPERAND(flow));
+    currentPath = path;
+}
+
+void Compiler::patchJump(size_t instruction) {
+    code.instructions[instruction].operand = code.instructions.size();
+}
+
+void Compiler::enterPath(const Node *node) {
+    code.paths.push_back({ node, currentPath });
+    currentPath = static_cast<int>(code.paths.size() - 1);
+}
+
+void Compiler::leavePath() {
+    currentPath = code.paths[currentPath].parent;
+}
+
+void Compiler::leaveScopesUntil(size_t depth) {
+    if (scopeDepth > depth) {
+        emit(OpCode::LeaveScope, scopeDepth - depth);
+    }
+}
+
+void Compiler::enterScope(std::shared_ptr<ScopeLayout> layout) {
+    code.layouts.push_back(layout);
+    emit(OpCode::EnterScope, code.layouts.size() - 1);
+    frames.push_back(std::move(layout));
+    scopeDepth++;
+}
+
+void Compiler::leaveScope() {
+    emit(OpCode::LeaveScope, 1);
+    frames.pop_back();
+    scopeDepth--;
+}
+
+// the innermost scope laying the name out holds it, the global
+// scope holds every name under its symbol
+void Compiler::emitVariable(const std::string &name, bool store) {
+    for (size_t depth = 0; depth < frames.size(); depth++) {
+        const auto &layout = frames[frames.size() - 1 - depth];
+        const auto slot = layout ? layout->slotOf(name) : LexicalScope::globalSymbol(name);
+        if (slot.has_value()) {
+            emit(store ? OpCode::StoreSlot : OpCode::LoadSlot, addSlot({ depth, *slot }, name));
+            return;
+        }
+    }
+    emit(store ? OpCode::StoreVariable : OpCode::LoadVariable, addName(name));
+}
+
+// layouts collect every declaration of their scope,
+// a name missing from one is added just in case
+unsigned Compiler::declare(const std::string &name) {
+    const auto &layout = frames.back();
+    const auto slot = layout ? layout->add(name) : LexicalScope::globalSymbol(name);
+    return addSlot({ 0, slot }, name);
+}
+
+unsigned Compiler::addSlot(const VariableAddress &address, const std::string &name) {
+    code.slots.push_back({ address, addName(name) });
+    return OPERAND(code.slots.size() - 1);
+}
+
+unsigned Compiler::addSite(Operator op, long double number) {
+    code.sites.push_back({ operators::QuickenedBinary(op), number });
+    return OPERAND(code.sites.size() - 1);
+}
+
+unsigned Compiler::addName(const std::string &name) {
+    if (const auto it = names.find(name); it != names.end()) {
+        return it->second;
+    }
+    code.strings.push_back(name);
+    const auto index = OPERAND(code.strings.size() - 1);
+    names[name] = index;
+    return index;
+}
+
+unsigned Compiler::addNumber(long double number) {
+    code.numbers.push_back(number);
+    return OPERAND(code.numbers.size() - 1);
+}
+
+unsigned Compiler::addFunction(const std::vector<ExpressionPtr> &parameters, const StatementPtr &body) {
+    code.functions.push_back({ parameters, body, frames });
+    return OPERAND(code.functions.size() - 1);
+}
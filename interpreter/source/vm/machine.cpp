@@ -0,0 +1,623 @@
+#include "vm/machine.h"
+#include "vm/compiler.h"
+#include "except.h"
+#include "prelude.h"
+#include "operators.h"
+#include "optimizer.h"
+#include "constants.h"
+#include "aot/modules.h"
+#include "utils/utils.h"
+#include "parser/parser.h"
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <utility>
+
+using namespace interpreter;
+using namespace interpreter::vm;
+using namespace interpreter::exceptions;
+using namespace interpreter::types;
+
+Machine::Machine(std::string filename, const Storage& initialStorage, const Options& options)
+    : filename(std::move(filename)),
+      options(options),
+      maxCallDepth(options.maxCallDepth.value_or(Options::DEFAULT_MAX_CALL_DEPTH)),
+      fatalError(std::nullopt),
+      importedASTs(),
+      functionCode(std::make_shared<std::unordered_map<const Statement*, std::unique_ptr<Code>>>()),
+      running(false) {
+    scope = LexicalScope::create();
+    for (const auto &[key, value] : prelude::getConstants()) {
+        scope->initVariable(key, std::make_shared<NumberValue>(value));
+    }
+    for (const auto &[key, value] : prelude::getPrelude()) {
+        scope->initVariable(key, value);
+    }
+    for (const auto &[key, value] : initialStorage) {
+        scope->initVariable(key, value);
+    }
+}
+
+// a generator runs without a prelude of its
+// own: it only sees the scope of its function
+Machine::Machine(const Machine &parent, std::string filename)
+    : filename(std::move(filename)),
+      options(parent.options),
+      maxCallDepth(parent.maxCallDepth),
+      fatalError(std::nullopt),
+      importedASTs(),
+      functionCode(parent.functionCode),
+      running(false) {}
+
+void Machine::executeProgram(Program &program) {
+    execute(program, {});
+}
+
+// whether the code was read in a program run as it is read or in
+// a module, an empty pointer never shares ownership with one that was set
+static bool streamed(const std::weak_ptr<const Node> &tree) {
+    const std::weak_ptr<const Node> none;
+    return tree.owner_before(none) || none.owner_before(tree);
+}
+
+void Machine::executeStreamed(const std::shared_ptr<Program> &program) {
+    execute(*program, program);
+    dropFreedCode();
+}
+
+// code of functions whose trees were freed, streamed
+// pieces of the program or modules no longer used
+void Machine::dropFreedCode() {
+    std::erase_if(*functionCode, [](const auto &entry) {
+        const auto &tree = entry.second->tree;
+        return tree.expired() && streamed(tree);
+    });
+}
+
+void Machine::execute(Program &program, const std::weak_ptr<const Node> &tree) {
+    try {
+        Constants::check(program);
+        const auto code = Compiler::compileProgram(program);
+        code->tree = tree;
+        run(*code);
+    } catch (const RuntimeException &exception) {
+        fatalError = exception.what();
+    }
+}
+
+bool Machine::didFailed() const {
+    return fatalError.has_value();
+}
+
+const std::optional<std::string> &Machine::getFatalError() const {
+    return fatalError;
+}
+
+std::vector<std::shared_ptr<Program>>& Machine::getImportedASTs() {
+    return importedASTs;
+}
+
+const SharedScope& Machine::getScope() const {
+    return scope;
+}
+
+// error reporting
+
+static std::string describeException(const std::exception_ptr &exception) {
+    std::string description = "unknown runtime exception";
+    try {
+        std::rethrow_exception(exception);
+    } catch (const RuntimeException &runtimeException) {
+        description = std::string(runtimeException.what());
+    } catch (...) {}
+    return description;
+}
+
+// wraps the exception into the labels of the instructions
+// being executed in all the frames entered by the current run,
+// innermost first, then drops those frames
+void Machine::unwind(size_t entryDepth, size_t ip, const std::exception_ptr &exception) {
+    std::vector<std::string> labels;
+    for (auto depth = frames.size(); depth-- > entryDepth;) {
+        const auto &frame = frames[depth];
+        const auto frameIp = depth + 1 == frames.size() ? ip : frame.ip;
+        if (frame.code != nullptr) {
+            auto path = frame.code->instructions[frameIp - 1].path;
+            while (path >= 0) {
+                const auto &entry = frame.code->paths[path];
+                labels.push_back(entry.node->nodeLabel());
+                path = entry.parent;
+            }
+        }
+        if (frame.function) {
+            const auto function = static_cast<FunctionalObject*>(frame.function.get());
+            labels.push_back("calling a function from file \"" + function->filename + "\"");
+        }
+    }
+
+    stack.resize(frames[entryDepth].base);
+    scope = frames[entryDepth].callingScope;
+    frames.resize(entryDepth);
+
+    if (labels.empty()) {
+        std::rethrow_exception(exception);
+    }
+    // the same text nested PropagatedExceptions would produce
+    std::string description;
+    for (size_t i = labels.size() - 1; i > 0; i--) {
+        description += "At " + labels[i - 1] + ":\n";
+    }
+    description = std::move(description) + describeException(exception);
+    throw PropagatedException(labels.back(), description);
+}
+
+// execution
+
+#define POP_VALUE(NAME)                  \
+    auto NAME = std::move(stack.back()); \
+    stack.pop_back();
+
+SharedValue Machine::run(const Code &entry) {
+    frames.push_back(Frame { &entry, 0, stack.size(), nullptr, scope, {} });
+    return execute(frames.size() - 1);
+}
+
+// runs the innermost frame from where it stopped until the frame
+// at entryDepth returns, or until the generator of the machine yields
+SharedValue Machine::execute(size_t entryDepth) {
+    const Code* code = frames.back().code;
+    size_t base = frames.back().base;
+    size_t ip = frames.back().ip;
+    try {
+        using enum OpCode;
+        while (true) {
+            const auto &instruction = code->instructions[ip++];
+            const auto operand = instruction.operand;
+            switch (instruction.code) {
+                case Pop:
+                    stack.resize(stack.size() - operand);
+                    break;
+                case PushNumber:
+                    stack.push_back(std::make_shared<NumberValue>(code->numbers[operand]));
+                    break;
+                case PushString:
+                    stack.push_back(std::make_shared<StringValue>(code->strings[operand]));
+                    break;
+                case PushBoolean:
+                    stack.push_back(std::make_shared<BooleanValue>(operand != 0));
+                    break;
+                case PushNil:
+                    stack.push_back(NilValue::getInstance());
+                    break;
+                case CopyValue:
+                    stack.back() = copyForAssignment(stack.back());
+                    break;
+                case LoadVariable:
+                    stack.push_back(scope->getValue(code->strings[operand]));
+                    break;
+                case StoreVariable:
+                    scope->setValue(code->strings[operand], stack.back());
+                    break;
+                case LoadSlot: {
+                    const auto &slot = code->slots[operand];
+                    stack.push_back(scope->getValue(slot.address, code->strings[slot.name]));
+                    break;
+                }
+                case StoreSlot: {
+                    const auto &slot = code->slots[operand];
+                    scope->setValue(slot.address, code->strings[slot.name], stack.back());
+                    break;
+                }
+                case DeclareVariable: {
+                    POP_VALUE(value)
+                    const auto &slot = code->slots[operand];
+                    scope->initSlot(slot.address.slot, code->strings[slot.name], std::move(value));
+                    break;
+                }
+                case DeclareNil: {
+                    const auto &slot = code->slots[operand];
+                    scope->initSlot(slot.address.slot, code->strings[slot.name], NilValue::getInstance());
+                    break;
+                }
+                case EnterScope:
+                    scope = LexicalScope::createInner(scope, code->layouts[operand].get());
+                    break;
+                case LeaveScope:
+                    for (unsigned i = 0; i < operand; i++) {
+                        scope = *scope->getParent();
+                    }
+                    break;
+                case BinaryOperation: {
+                    POP_VALUE(right)
+                    stack.back() = code->sites[operand].operation(stack.back(), right);
+                    break;
+                }
+                case BinaryWithNumber: {
+                    const auto &site = code->sites[operand];
+                    stack.back() = site.operation.withNumber(stack.back(), site.number);
+                    break;
+                }
+                case PrefixOperation: {
+                    const auto &handlers = operators::prefixRow(static_cast<parser::AST::Operator>(operand));
+                    stack.back() = operators::prefix(handlers, stack.back());
+                    break;
+                }
+                case MakeArray: {
+                    std::vector<SharedValue> values (
+                        std::make_move_iterator(stack.end() - operand),
+                        std::make_move_iterator(stack.end())
+                    );
+                    stack.resize(stack.size() - operand);
+                    stack.push_back(std::make_shared<ArrayObject>(values));
+                    break;
+                }
+                case MakeObject: {
+                    std::map<std::string, SharedValue> objValue;
+                    const auto first = stack.size() - 2 * operand;
+                    for (auto i = first; i < stack.size(); i += 2) {
+                        objValue[stack[i]->toString()] = stack[i + 1];
+                    }
+                    stack.resize(first);
+                    stack.push_back(std::make_shared<UserObject>(objValue));
+                    break;
+                }
+                case Concatenate: {
+                    auto output = concatenate(std::span(stack.end() - operand, stack.end()));
+                    stack.resize(stack.size() - operand);
+                    stack.push_back(std::move(output));
+                    break;
+                }
+                case MakeFunction: {
+                    const auto &function = code->functions[operand];
+                    auto made = std::make_shared<FunctionalObject>(
+                        filename,
+                        function.parameters,
+                        function.body,
+                        scope,
+                        nullptr,
+                        code->tree.lock()
+                    );
+                    getFunctionCode(made.get(), &function);
+                    stack.push_back(std::move(made));
+                    break;
+                }
+                case CheckIndexTarget: {
+                    const auto type = stack.back()->dataType();
+                    if (type != ArrayType && type != ObjectType) {
+                        throw WrongIndexAccessTargetException(stack.back()->getTypename());
+                    }
+                    break;
+                }
+                case LoadIndex: {
+                    POP_VALUE(index)
+                    const auto placePointer = getPlacePointer(stack.back(), index, true);
+                    stack.back() = placePointer == nullptr ? NilValue::getInstance() : *placePointer;
+                    break;
+                }
+                case StoreIndex: {
+                    POP_VALUE(index)
+                    POP_VALUE(target)
+                    const auto placePointer = getPlacePointer(target, index, false);
+                    *placePointer = stack.back();
+                    break;
+                }
+                case Jump:
+                    ip = operand;
+                    break;
+                case JumpIfFalse: {
+                    POP_VALUE(condition)
+                    if (!getCastedPointer<BooleanType, BooleanValue>(condition)->value) {
+                        ip = operand;
+                    }
+                    break;
+                }
+                case Dispatch: {
+                    POP_VALUE(subject)
+                    const auto &dispatch = code->dispatches[operand];
+                    ip = dispatch.targets[dispatch.table.lookup(subject)];
+                    break;
+                }
+                case ForPrepare: {
+                    POP_VALUE(step)
+                    POP_VALUE(end)
+                    const auto startValue = getCastedPointer<NumberType, NumberValue>(stack.back())->value;
+                    const auto endValue = getCastedPointer<NumberType, NumberValue>(end)->value;
+                    const auto stepValue = getCastedPointer<NumberType, NumberValue>(step)->value;
+                    if (stepValue == 0) throw ZeroStepException();
+                    if (startValue < endValue && stepValue < 0) throw NegativeStepException();
+                    if (startValue > endValue && stepValue > 0) throw PositiveStepException();
+                    auto start = std::move(stack.back());
+                    stack.back() = end;
+                    stack.push_back(step);
+                    stack.push_back(std::make_shared<BooleanValue>(stepValue > 0));
+                    stack.push_back(start);
+                    break;
+                }
+                case IterPrepare:
+                    stack.back() = std::make_shared<IteratorValue>(stack.back());
+                    break;
+                case IterNext: {
+                    const auto iterator = static_cast<IteratorValue*>(stack.back().get());
+                    SharedValue element;
+                    const auto keyed = iterator->keyed();
+                    if (!iterator->next(keyed ? &element : nullptr, keyed ? nullptr : &element)) {
+                        ip = operand;
+                        break;
+                    }
+                    stack.push_back(std::move(element));
+                    break;
+                }
+                case IterNextPair: {
+                    SharedValue key, element;
+                    if (!static_cast<IteratorValue*>(stack.back().get())->next(&key, &element)) {
+                        ip = operand;
+                        break;
+                    }
+                    stack.push_back(std::move(key));
+                    stack.push_back(std::move(element));
+                    break;
+                }
+                case ForDeclare: {
+                    const auto &slot = code->slots[operand];
+                    scope->initSlot(slot.address.slot, code->strings[slot.name], stack.back());
+                    break;
+                }
+                // the counter, the end and the step are numbers since ForPrepare
+                case ForCheck: {
+                    const auto top = stack.size() - 1;
+                    const auto counter = static_cast<NumberValue*>(stack[top].get())->value;
+                    const auto end = static_cast<NumberValue*>(stack[top - 3].get())->value;
+                    const auto positive = static_cast<BooleanValue*>(stack[top - 1].get())->value;
+                    if (positive ? counter >= end : counter <= end) {
+                        ip = operand;
+                    }
+                    break;
+                }
+                case ForStep: {
+                    const auto top = stack.size() - 1;
+                    const auto counter = static_cast<NumberValue*>(stack[top].get())->value;
+                    const auto step = static_cast<NumberValue*>(stack[top - 2].get())->value;
+                    stack[top] = std::make_shared<NumberValue>(counter + step);
+                    const auto &slot = code->slots[operand];
+                    scope->setValue(slot.address, code->strings[slot.name], stack[top]);
+                    break;
+                }
+                case Call: {
+                    POP_VALUE(target)
+                    std::vector<SharedValue> arguments (
+                        std::make_move_iterator(stack.end() - operand),
+                        std::make_move_iterator(stack.end())
+                    );
+                    stack.resize(stack.size() - operand);
+                    if (target->dataType() == BuiltinType) {
+                        const auto builtin = static_cast<BuiltinFunction*>(target.get());
+                        stack.push_back(builtin->cppCode(arguments));
+                        break;
+                    }
+                    const auto &callee = getFunctionCode(getCastedPointer<FunctionType, FunctionalObject>(target));
+                    frames.back().ip = ip;
+                    if (callee.generator) {
+                        stack.push_back(startGenerator(callee, std::move(target), std::move(arguments)));
+                        break;
+                    }
+                    enterFunction(callee, std::move(target), std::move(arguments));
+                    code = frames.back().code;
+                    base = frames.back().base;
+                    ip = 0;
+                    break;
+                }
+                case Return:
+                case ReturnNil: {
+                    auto value = instruction.code == Return ? std::move(stack.back()) : NilValue::getInstance();
+                    stack.resize(base);
+                    if (frames.size() - 1 == entryDepth) {
+                        frames.pop_back();
+                        return value;
+                    }
+                    scope = std::move(frames.back().callingScope);
+                    frames.pop_back();
+                    const auto &caller = frames.back();
+                    code = caller.code;
+                    base = caller.base;
+                    ip = caller.ip;
+                    stack.push_back(std::move(value));
+                    break;
+                }
+                // only the frame the machine of a generator
+                // was started with suspends, it is the entry one
+                case Yield: {
+                    frames.back().ip = ip;
+                    POP_VALUE(value)
+                    return value;
+                }
+                case GeneratorStart:
+                    frames.back().ip = ip;
+                    return NilValue::getInstance();
+                case BindArguments: {
+                    auto &arguments = frames.back().arguments;
+                    const auto &parameters = code->parameters;
+                    if (arguments.size() > parameters.size()) {
+                        throw ParamsAndArgsDontMatchException(parameters.size(), arguments.size());
+                    }
+                    for (size_t i = 0; i < arguments.size(); i++) {
+                        const auto &param = parameters[i];
+                        const auto &name = code->strings[param.name];
+                        if (param.required) {
+                            scope->initSlot(param.slot, name, std::move(arguments[i]));
+                        } else {
+                            scope->setValue(VariableAddress { 0, param.slot }, name, arguments[i]);
+                        }
+                    }
+                    // listed in the order of names
+                    std::set<std::string> unset;
+                    for (auto i = arguments.size(); i < parameters.size(); i++) {
+                        if (parameters[i].required) unset.insert(code->strings[parameters[i].name]);
+                    }
+                    if (!unset.empty()) {
+                        throw UnsetParametersException(utils::stringJoin(unset, ", "));
+                    }
+                    break;
+                }
+                case Import:
+                    executeImport(code->imports[operand]);
+                    break;
+                case Echo: {
+                    POP_VALUE(toPrint)
+                    std::cout << toPrint->toString() << std::endl;
+                    break;
+                }
+                case ThrowMisplaced:
+                    switch (static_cast<MisplacedFlow>(operand)) {
+                        case MisplacedFlow::Break:    throw MisplacedFlowOperator("loop break");
+                        case MisplacedFlow::Continue: throw MisplacedFlowOperator("loop continue");
+                        case MisplacedFlow::Return:   throw MisplacedFlowOperator("return value");
+                        case MisplacedFlow::Yield:    throw MisplacedFlowOperator("yield");
+                    }
+                    break;
+                case ThrowUnsupportedOperator:
+                    throw UnsupportedOperatorException(code->strings[operand]);
+                case ThrowExpectedIdentifier:
+                    throw ExpectedIdentifierException();
+                case ThrowParameterFormat:
+                    throw FunctionParameterWrongFormatException();
+                case ThrowDuplicateParameter:
+                    throw DuplicateParameterException(code->strings[operand]);
+                case ThrowErrorNode:
+                    throw ErrorNodeException();
+            }
+        }
+    } catch (...) {
+        unwind(entryDepth, ip, std::current_exception());
+    }
+}
+
+// pushes the frame of the callee: the loop
+// of run continues with its code from the start
+void Machine::enterFunction(const Code &code, SharedValue function, std::vector<SharedValue> arguments) {
+    if (frames.size() - 1 >= maxCallDepth) {
+        throw CallDepthExceededException(maxCallDepth);
+    }
+    const auto functionPtr = static_cast<FunctionalObject*>(function.get());
+    frames.push_back(Frame { &code, 0, stack.size(), std::move(function), scope, std::move(arguments) });
+    scope = LexicalScope::createInner(functionPtr->scope, code.frame.get());
+}
+
+// The call binds the arguments right away, then the body waits on
+// a machine of its own: while it is suspended, its frame and values
+// stay there and the machine resuming it goes on as usual
+SharedValue Machine::startGenerator(const Code &code, SharedValue function, std::vector<SharedValue> arguments) {
+    const auto functionPtr = static_cast<FunctionalObject*>(function.get());
+    const std::shared_ptr<Machine> generator(new Machine(*this, functionPtr->filename));
+    generator->frames.push_back(Frame { &code, 0, 0, std::move(function), nullptr, std::move(arguments) });
+    generator->scope = LexicalScope::createInner(functionPtr->scope, code.frame.get());
+    generator->execute(0);
+    return std::make_shared<GeneratorObject>([generator](SharedValue &value) {
+        return generator->resume(value);
+    });
+}
+
+// false once the body is over, an error ends it as well
+bool Machine::resume(SharedValue &value) {
+    if (frames.empty()) return false;
+    if (running) throw GeneratorRunningException();
+    running = true;
+    SharedValue yielded;
+    try {
+        yielded = execute(0);
+    } catch (...) {
+        running = false;
+        throw;
+    }
+    running = false;
+    if (frames.empty()) return false;
+    value = std::move(yielded);
+    return true;
+}
+
+// Functions are compiled once, when they are first made: the scopes
+// around are laid out then. A body freed with its tree may leave its
+// address to a later one. A function the machine did not make has
+// names from around its body looked up by name
+const Code& Machine::getFunctionCode(const FunctionalObject *function, const FunctionTemplate* source) {
+    const auto body = function->body.get();
+    if (const auto it = functionCode->find(body); it != functionCode->end()) {
+        const auto &tree = it->second->tree;
+        if (!tree.owner_before(function->tree) && !function->tree.owner_before(tree)) {
+            return *it->second;
+        }
+    }
+    auto enclosing = source != nullptr ? source->enclosing : std::vector<std::shared_ptr<ScopeLayout>>();
+    auto code = Compiler::compileFunction(function->parameters, function->body, std::move(enclosing));
+    code->tree = function->tree;
+    const auto &result = *code;
+    (*functionCode)[body] = std::move(code);
+    return result;
+}
+
+void Machine::executeImport(const ImportLibraryStatement *import) {
+    const auto localName = import->libName + ".toy";
+    auto programAST = aot::embeddedModule(localName);
+    if (!programAST) {
+        std::ifstream filestream(localName);
+        if (filestream.bad() || !filestream.is_open()) {
+            throw FileImportFailedException(localName);
+        }
+
+        auto _parser = parser::Parser(filestream);
+        programAST = _parser.readProgram();
+        if (!_parser.getErrors().empty()) {
+            const auto& errors = _parser.getErrors();
+            const auto errorString = utils::stringJoin(errors, "\n");
+            throw ImportParserException(localName, errorString);
+        }
+    }
+    if (options.optimizationLevel > 0) {
+        Optimizer::optimize(*programAST);
+    }
+
+    // functions of the module own its tree, so it outlives
+    // a machine that goes away first, the one of a generator
+    const std::shared_ptr<Program> module = std::move(programAST);
+    auto _machine = Machine(localName, {}, options);
+    _machine.execute(*module, module);
+    if (_machine.getFatalError().has_value()) {
+        throw ImportEvalException(localName, _machine.getFatalError().value());
+    }
+
+    importedASTs.push_back(module);
+    dropFreedCode();
+    for (auto& each : _machine.getImportedASTs()) {
+        importedASTs.push_back(std::move(each));
+    }
+
+    const auto exportObject = _machine.getScope()->getValue("exports");
+    if (import->alias.has_value()) {
+        scope->initVariable(import->alias.value(), exportObject);
+    } else {
+        scope->initVariable(import->libName, exportObject);
+    }
+}
+
+// helpers
+
+SharedValue* Machine::getPlacePointer(const SharedValue &target, const SharedValue &index, bool read) {
+    if (target->dataType() == ArrayType) {
+        auto arrayObject = static_cast<ArrayObject*>(target.get());
+        const auto floatingIndex = getCastedPointer<NumberType, NumberValue>(index)->value;
+        if (!utils::isInteger(floatingIndex)) throw NonIntegerIndexException();
+        if (floatingIndex < 0) throw NegativeArrayIndexException();
+        const auto integerIndex = static_cast<size_t>(floatingIndex);
+        auto &elements = arrayObject->elements();
+        if (integerIndex >= elements.size()) throw IndexOutOfBoundsException(integerIndex);
+        return &elements[integerIndex];
+    }
+
+    if (target->dataType() == ObjectType) {
+        auto objectPtr = static_cast<UserObject*>(target.get());
+        const auto key = index->toString();
+        if (read) return objectPtr->findPlace(key);
+        return &objectPtr->getPlace(key);
+    }
+
+    throw WrongIndexAccessTargetException(target->getTypename());
+}
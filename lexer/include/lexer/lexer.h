@@ -1,11 +1,19 @@
 #pragma once
 #include <optional>
+#include <vector>
 #include "ibuffer.h"
 #include "token.h"
 
 namespace lexer {
     class Lexer final {
+        // string whose embedded expression is being read
+        struct Interpolation {
+            char quoteSign;
+            // of the braces opened inside the expression
+            unsigned depth;
+        };
         InputBuffer buffer;
+        std::vector<Interpolation> interpolations;
         std::optional<Token> currentToken;
         std::tuple<unsigned, unsigned> currentPosition;
         // private parsing functions
@@ -16,6 +24,7 @@ namespace lexer {
         Token readWordToken    (std::string &valueBuffer);
         Token readNumberToken  (std::string &valueBuffer);
         Token readStringToken  (std::string &valueBuffer);
+        Token readStringPart   (std::string &valueBuffer, char quoteSign, bool resumed);
         // helper functions
         void skipWhile(const std::function<bool(char)> &predicate);
         void skipWhitespace();
@@ -6,6 +6,9 @@ namespace lexer {
         Keyword, Identifier,
         Operator, Punctuation,
         Number, String,
+        // parts of a string with embedded expressions: text up to
+        // the first `${`, between a `}` and the next `${`, up to the end
+        InterpolationStart, InterpolationMiddle, InterpolationEnd,
         EndOfFile, Illegal
     };
 
@@ -4,13 +4,16 @@
 using namespace lexer;
 
 const std::set<std::string> KEYWORDS {
-    "let",                          // variable declaration
+    "let", "const",                 // variable and constant declarations
     "for", "from", "to", "step",    // for loop
+    "in",                           // for-in loop
     "while",                        // while loop
     "continue", "break",            // loop flow operators
     "if", "else",                   // if-else
+    "match", "case",                // match statement
     "fun", "lambda",                // functions
     "return",                       // return value from functions
+    "yield",                        // next value of a generator
     "true", "false",                // boolean literals
     "nil",                          // for nil type
     "import", "as",                 // import system
@@ -95,6 +98,21 @@ Token Lexer::readToken() {
         return readNumberToken(valueBuffer);
     }
 
+    // the brace closing an embedded expression resumes its string
+    if (!interpolations.empty() && (current == '{' || current == '}')) {
+        auto &interpolation = interpolations.back();
+        if (current == '{') {
+            interpolation.depth++;
+        } else if (interpolation.depth > 0) {
+            interpolation.depth--;
+        } else {
+            const auto quoteSign = interpolation.quoteSign;
+            interpolations.pop_back();
+            buffer.next();
+            return readStringPart(valueBuffer, quoteSign, true);
+        }
+    }
+
     // Punctuation (){},;
     if (PUNCTUATION.contains(current)) {
         valueBuffer += buffer.next();
@@ -161,9 +179,22 @@ Token Lexer::readNumberToken(std::string &valueBuffer) {
 
 Token Lexer::readStringToken(std::string &valueBuffer) {
     const auto quoteSign = buffer.next();
+    return readStringPart(valueBuffer, quoteSign, false);
+}
+
+// reads up to the closing quote or up to `${`, which
+// leaves the rest of the string for after the expression
+Token Lexer::readStringPart(std::string &valueBuffer, char quoteSign, bool resumed) {
+    using enum TokenType;
     while (!buffer.eof()) {
         if (buffer.peek() == quoteSign || buffer.peek() == '\n') break;
-        if (const auto current = buffer.next(); current != '\\') {
+        const auto current = buffer.next();
+        if (current == '$' && buffer.peek() == '{') {
+            buffer.next();
+            interpolations.push_back({ quoteSign, 0 });
+            return makeToken(resumed ? InterpolationMiddle : InterpolationStart, valueBuffer);
+        }
+        if (current != '\\') {
             valueBuffer += current;
             continue;
         }
@@ -172,6 +203,7 @@ Token Lexer::readStringToken(std::string &valueBuffer) {
             case 't' :  valueBuffer += '\t'; buffer.next(); break;
             case '"' :  valueBuffer += '"' ; buffer.next(); break;
             case '\'':  valueBuffer += '\''; buffer.next(); break;
+            case '$' :  valueBuffer += '$' ; buffer.next(); break;
             default:    valueBuffer += '\\';  break;
         }
     }
@@ -180,7 +212,7 @@ Token Lexer::readStringToken(std::string &valueBuffer) {
         return makeToken(TokenType::Illegal, valueBuffer);
     }
     buffer.next();
-    return makeToken(TokenType::String, valueBuffer);
+    return makeToken(resumed ? InterpolationEnd : String, valueBuffer);
 }
 
 Token Lexer::makeToken(TokenType type, std::string &valueBuffer) const {
@@ -12,6 +12,9 @@ std::string lexer::tokenTypeToString(TokenType type) {
         case Punctuation: return "punctuation";
         case Number:      return "number";
         case String:      return "string";
+        case InterpolationStart:  return "interpolation start";
+        case InterpolationMiddle: return "interpolation middle";
+        case InterpolationEnd:    return "interpolation end";
         case EndOfFile:   return "end of file";
         case Illegal:     return "illegal";
         default:          return "unknown";
@@ -31,7 +34,7 @@ std::string Token::toString() const {
 std::string Token::toStringShort() const {
     using enum TokenType;
     auto output = tokenTypeToString(type);
-    if (type == String) {
+    if (type == String || type == InterpolationStart || type == InterpolationMiddle || type == InterpolationEnd) {
         auto prepared = utils::quotedString(value, "'");
         output += " " + prepared;
     } else if (type != EndOfFile) {
@@ -24,6 +24,28 @@ namespace parser::AST {
     // Position as a separate shortcut type
     using Position = std::tuple<unsigned, unsigned>;
 
+    // Data an execution engine attaches to nodes
+    // (e.g. code compiled at load time).
+    // Parser never looks inside
+    struct RuntimeData {
+        virtual ~RuntimeData() = default;
+    };
+
+    // Operators are decoded once by the parser,
+    // so that runtime never compares operator strings
+    enum class Operator : unsigned char {
+        Or, And,
+        Equal, NotEqual,
+        Less, Greater, LessEqual, GreaterEqual,
+        Plus, Minus, Multiply, Divide, Div, Mod, Power,
+        PlusAssign, MinusAssign, MultiplyAssign, DivideAssign, PowerAssign,
+        Assign,
+        Not, Negate,
+        Unknown,
+    };
+    Operator decodeBinaryOperator(const std::string &op);
+    Operator decodePrefixOperator(const std::string &op);
+
     // Abstract base struct for all AST constructs
     struct Node {
         enum class NodeType {
@@ -33,6 +55,7 @@ namespace parser::AST {
         };
 
         const Position position;
+        mutable std::shared_ptr<RuntimeData> runtimeData;
         explicit Node(Position &position)
             : position(std::move(position)) {}
 
@@ -56,11 +79,14 @@ namespace parser::AST {
             VariableDeclaration,
             FunctionDeclaration,
             ForLoop,
+            ForInLoop,
             WhileLoop,
             IfElse,
+            Match,
             ContinueOperator,
             BreakOperator,
             ReturnOperator,
+            Yield,
             BareExpression,
             BlockOfStatements,
             Echo,
@@ -88,6 +114,7 @@ namespace parser::AST {
             Lambda,
             Variable,
             Object,
+            Interpolation,
             ExpressionError
         };
         explicit Expression(Position &position)
@@ -96,7 +123,9 @@ namespace parser::AST {
         virtual ~Expression() = default;
     };
 
-    // to keep my code concise, I define two new types:
+    // to keep my code concise, I define two new types.
+    // Children are held by non-const pointers, so that
+    // passes over a parsed tree can replace them in place
     using StatementPtr = std::unique_ptr<Statement>;
     using ExpressionPtr = std::unique_ptr<Expression>;
 
@@ -104,7 +133,7 @@ namespace parser::AST {
     struct Program final : Node {
         NODE_NAME("program")
         NODE_TYPE(NodeType::ProgramNode)
-        const std::vector<StatementPtr> statements;
+        std::vector<StatementPtr> statements;
         Program (
             std::vector<StatementPtr> &statements,
             Position &position
@@ -132,16 +161,20 @@ namespace parser::AST {
         ENABLE_PRINTING
     };
 
+    // `const NAME = value;` is a declaration whose
+    // variable can not be assigned after it
     struct VariableDeclarationStatement final : Statement {
-        NODE_NAME("variable declaration")
+        CUSTOM_NODE_NAME { return constant ? "constant declaration" : "variable declaration"; }
         STATEMENT_TYPE(VariableDeclaration)
         const std::string name;
-        const std::optional<ExpressionPtr> value;
+        std::optional<ExpressionPtr> value;
+        const bool constant;
         VariableDeclarationStatement (
             std::string &name,
             std::optional<ExpressionPtr> &value,
-            Position &position
-        ) : name(std::move(name)), value(std::move(value)), Statement(position) {}
+            Position &position,
+            bool constant = false
+        ) : name(std::move(name)), value(std::move(value)), constant(constant), Statement(position) {}
     protected:
         ENABLE_PRINTING
     };
@@ -150,8 +183,8 @@ namespace parser::AST {
         NODE_NAME("function declaration")
         STATEMENT_TYPE(FunctionDeclaration)
         const std::string name;
-        const std::vector<ExpressionPtr> parameters;
-        const StatementPtr body;
+        std::vector<ExpressionPtr> parameters;
+        StatementPtr body;
         FunctionDeclarationStatement (
             std::string &name,
             std::vector<ExpressionPtr> &parameters,
@@ -165,10 +198,10 @@ namespace parser::AST {
         NODE_NAME("for loop")
         STATEMENT_TYPE(ForLoop)
         const std::string variable;
-        const ExpressionPtr start;
-        const ExpressionPtr end;
-        const std::optional<ExpressionPtr> step;
-        const StatementPtr body;
+        ExpressionPtr start;
+        ExpressionPtr end;
+        std::optional<ExpressionPtr> step;
+        StatementPtr body;
         ForLoopStatement (
             std::string &variable,
             ExpressionPtr &start, ExpressionPtr &end, std::optional<ExpressionPtr> &step,
@@ -180,11 +213,30 @@ namespace parser::AST {
         ENABLE_PRINTING
     };
 
+    // `for (x in collection)` walks arrays, strings and objects.
+    // A single variable takes the elements (keys of objects),
+    // two take the index or key and the element
+    struct ForInLoopStatement final : Statement {
+        NODE_NAME("for-in loop")
+        STATEMENT_TYPE(ForInLoop)
+        const std::vector<std::string> variables;
+        ExpressionPtr collection;
+        StatementPtr body;
+        ForInLoopStatement (
+            std::vector<std::string> &variables,
+            ExpressionPtr &collection,
+            StatementPtr &body,
+            Position &position
+        ) : variables(std::move(variables)), collection(std::move(collection)),
+            body(std::move(body)), Statement(position) {}
+        ENABLE_PRINTING
+    };
+
     struct WhileLoopStatement final : Statement {
         NODE_NAME("while loop")
         STATEMENT_TYPE(WhileLoop)
-        const ExpressionPtr condition;
-        const StatementPtr body;
+        ExpressionPtr condition;
+        StatementPtr body;
         WhileLoopStatement (
             ExpressionPtr &condition,
             StatementPtr &body,
@@ -196,9 +248,9 @@ namespace parser::AST {
     struct IfElseStatement final : Statement {
         NODE_NAME("if-else statement")
         STATEMENT_TYPE(IfElse)
-        const ExpressionPtr condition;
-        const StatementPtr mainClause;
-        const std::optional<StatementPtr> elseClause;
+        ExpressionPtr condition;
+        StatementPtr mainClause;
+        std::optional<StatementPtr> elseClause;
         IfElseStatement (
             ExpressionPtr &condition,
             StatementPtr &mainClause,
@@ -209,6 +261,27 @@ namespace parser::AST {
         ENABLE_PRINTING
     };
 
+    // `match (subject) { case 1, 2: ... else: ... }` runs the first
+    // case listing a literal equal to the subject, or the else clause.
+    // Case values are literals only, so that engines can dispatch
+    // on them through tables instead of comparing one by one
+    struct MatchStatement final : Statement {
+        NODE_NAME("match statement")
+        STATEMENT_TYPE(Match)
+        using CaseList = std::vector<std::tuple<std::vector<ExpressionPtr>, StatementPtr>>;
+        ExpressionPtr subject;
+        CaseList cases;
+        std::optional<StatementPtr> elseClause;
+        MatchStatement (
+            ExpressionPtr &subject,
+            CaseList &cases,
+            std::optional<StatementPtr> &elseClause,
+            Position &position
+        ) : subject(std::move(subject)), cases(std::move(cases)),
+            elseClause(std::move(elseClause)), Statement(position) {}
+        ENABLE_PRINTING
+    };
+
     struct ContinueOperatorStatement final : Statement {
         NODE_NAME("continue operator")
         STATEMENT_TYPE(ContinueOperator)
@@ -226,7 +299,7 @@ namespace parser::AST {
     struct ReturnOperatorStatement final : Statement {
         NODE_NAME("return operator")
         STATEMENT_TYPE(ReturnOperator)
-        const std::optional<ExpressionPtr> expression;
+        std::optional<ExpressionPtr> expression;
         ReturnOperatorStatement (
             std::optional<ExpressionPtr> &expression,
             Position &position
@@ -234,10 +307,22 @@ namespace parser::AST {
         ENABLE_PRINTING
     };
 
+    // makes the function around a generator
+    struct YieldStatement final : Statement {
+        NODE_NAME("yield statement")
+        STATEMENT_TYPE(Yield)
+        ExpressionPtr expression;
+        YieldStatement(
+            ExpressionPtr &expression,
+            Position &position
+        ) : expression(std::move(expression)), Statement(position) {}
+        ENABLE_PRINTING
+    };
+
     struct ExpressionStatement final : Statement {
         NODE_NAME("bare expression")
         STATEMENT_TYPE(BareExpression)
-        const ExpressionPtr expression;
+        ExpressionPtr expression;
         ExpressionStatement (
             ExpressionPtr &expression,
             Position &position
@@ -248,7 +333,7 @@ namespace parser::AST {
     struct BlockStatement final : Statement {
         NODE_NAME("block of statements")
         STATEMENT_TYPE(BlockOfStatements)
-        const std::vector<StatementPtr> statements;
+        std::vector<StatementPtr> statements;
         BlockStatement (
             std::vector<StatementPtr> &statements,
             Position &position
@@ -259,7 +344,7 @@ namespace parser::AST {
     struct EchoStatement final : Statement {
         NODE_NAME("echo statement")
         STATEMENT_TYPE(Echo)
-        const ExpressionPtr expression;
+        ExpressionPtr expression;
         EchoStatement(
             ExpressionPtr &expression,
             Position &position
@@ -280,36 +365,40 @@ namespace parser::AST {
     struct BinaryOperationExpression final : Expression {
         CUSTOM_NODE_NAME { return "binary operation '" + op + "'"; }
         EXPRESSION_TYPE(BinaryOperation)
-        const ExpressionPtr left;
-        const ExpressionPtr right;
+        ExpressionPtr left;
+        ExpressionPtr right;
         const std::string op;
+        const Operator opcode;
         BinaryOperationExpression (
             ExpressionPtr &left,
             ExpressionPtr &right,
             std::string &op,
             Position &position
-        ) : left(std::move(left)), right(std::move(right)), op(std::move(op)), Expression(position) {}
+        ) : left(std::move(left)), right(std::move(right)), op(std::move(op)),
+            opcode(decodeBinaryOperator(this->op)), Expression(position) {}
         ENABLE_PRINTING
     };
 
     struct PrefixOperationExpression final : Expression {
         CUSTOM_NODE_NAME { return "prefix operation '" + op + "'"; }
         EXPRESSION_TYPE(PrefixOperation)
-        const ExpressionPtr expression;
+        ExpressionPtr expression;
         const std::string op;
+        const Operator opcode;
         PrefixOperationExpression (
             ExpressionPtr &expression,
             std::string &op,
             Position &position
-        ) : expression(std::move(expression)), op(std::move(op)), Expression(position) {}
+        ) : expression(std::move(expression)), op(std::move(op)),
+            opcode(decodePrefixOperator(this->op)), Expression(position) {}
         ENABLE_PRINTING
     };
 
     struct CallExpression final : Expression {
         NODE_NAME("call expression")
         EXPRESSION_TYPE(Call)
-        const ExpressionPtr target;
-        const std::vector<ExpressionPtr> arguments;
+        ExpressionPtr target;
+        std::vector<ExpressionPtr> arguments;
         CallExpression (
             ExpressionPtr &target,
             std::vector<ExpressionPtr> &arguments,
@@ -321,8 +410,8 @@ namespace parser::AST {
     struct IndexAccessExpression final : Expression {
         NODE_NAME("index access expression")
         EXPRESSION_TYPE(IndexAccess)
-        const ExpressionPtr target;
-        const ExpressionPtr index;
+        ExpressionPtr target;
+        ExpressionPtr index;
         IndexAccessExpression (
             ExpressionPtr &target,
             ExpressionPtr &index,
@@ -367,7 +456,7 @@ namespace parser::AST {
     struct ArrayLiteralExpression final : Expression {
         NODE_NAME("array literal")
         EXPRESSION_TYPE(ArrayLiteral)
-        const std::vector<ExpressionPtr> values;
+        std::vector<ExpressionPtr> values;
         ArrayLiteralExpression (
             std::vector<ExpressionPtr> &values,
             Position &position
@@ -396,8 +485,8 @@ namespace parser::AST {
     struct LambdaExpression final : Expression {
         NODE_NAME("lambda expression")
         EXPRESSION_TYPE(Lambda)
-        const std::vector<ExpressionPtr> parameters;
-        const StatementPtr body;
+        std::vector<ExpressionPtr> parameters;
+        StatementPtr body;
         LambdaExpression (
             std::vector<ExpressionPtr> &parameters,
             StatementPtr &body,
@@ -410,7 +499,7 @@ namespace parser::AST {
         NODE_NAME("object")
         EXPRESSION_TYPE(Object)
         using ObjectList = std::vector<std::tuple<ExpressionPtr, ExpressionPtr>>;
-        const ObjectList objectList;
+        ObjectList objectList;
         ObjectExpression (
             ObjectList &list,
             Position &position
@@ -418,6 +507,20 @@ namespace parser::AST {
         ENABLE_PRINTING
     };
 
+    // "text ${expression} text": parts are the string literals
+    // and the expressions in order, the text around is left out
+    // when it is empty. Evaluates to the concatenation of them all
+    struct InterpolationExpression final : Expression {
+        NODE_NAME("string interpolation")
+        EXPRESSION_TYPE(Interpolation)
+        std::vector<ExpressionPtr> parts;
+        InterpolationExpression (
+            std::vector<ExpressionPtr> &parts,
+            Position &position
+        ) : parts(std::move(parts)), Expression(position) {}
+        ENABLE_PRINTING
+    };
+
     struct IllegalExpression final : Expression {
         NODE_NAME("illegal expression")
         EXPRESSION_TYPE(ExpressionError)
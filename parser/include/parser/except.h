@@ -42,4 +42,20 @@ namespace parser::exceptions {
         ENABLE_WHAT
     };
 
+    class DuplicateLoopVariableException final : public ParserException {
+        const std::string message;
+    public:
+        explicit DuplicateLoopVariableException(const std::string &name)
+            : message("Loop variable '" + name + "' is declared twice") {}
+        ENABLE_WHAT
+    };
+
+    class IllegalCaseValueException final : public ParserException {
+        const std::string message;
+    public:
+        explicit IllegalCaseValueException(const Token &token)
+            : message("Expected number, string, boolean or nil literal as a case value, found: " + token.toStringShort()) {}
+        ENABLE_WHAT
+    };
+
 }
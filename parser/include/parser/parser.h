@@ -19,13 +19,16 @@ namespace parser {
         // statements
         StatementPtr readImportLibraryStatement() noexcept;
         StatementPtr readVariableDeclaration() noexcept;
+        StatementPtr readConstantDeclaration() noexcept;
         StatementPtr readFunctionDeclaration() noexcept;
         StatementPtr readForLoop() noexcept;
         StatementPtr readWhileLoop() noexcept;
         StatementPtr readIfElseStatement() noexcept;
+        StatementPtr readMatchStatement() noexcept;
         StatementPtr readContinueOperator() noexcept;
         StatementPtr readBreakOperator() noexcept;
         StatementPtr readReturnOperator() noexcept;
+        StatementPtr readYieldStatement() noexcept;
         StatementPtr readBareExpression() noexcept;
         StatementPtr readBlockOfStatements() noexcept;
         StatementPtr readEchoStatement() noexcept;
@@ -38,6 +41,8 @@ namespace parser {
         ExpressionPtr readAtomicExpression() noexcept;
         ExpressionPtr readObjectExpression() noexcept;
         ExpressionPtr readLambdaExpression() noexcept;
+        ExpressionPtr readInterpolationExpression() noexcept;
+        ExpressionPtr readCaseValue();
         // helper functions
         std::vector<ExpressionPtr> readExpressionList(const std::string &start, const std::string &end);
         bool peekValueIs(const std::string &value);
@@ -53,5 +58,7 @@ namespace parser {
         [[nodiscard]] const std::vector<std::string>& getErrors() const;
         StatementPtr readStatement();
         ProgramPtr readProgram();
+        // whether every statement has been read
+        [[nodiscard]] bool eof();
     };
 }
@@ -5,12 +5,49 @@
 #include "ast.h"
 #include "utils/utils.h"
 #include <tuple>
+#include <map>
 
 using namespace parser::AST;
 
 #define FORMAT_FOR(CLS) void CLS::acceptFormatPrinter(Printer &printer) const
 #define DEBUG_FOR(CLS)  void CLS::acceptDebugPrinter(Printer &printer) const
 
+// decoding operators
+
+Operator parser::AST::decodeBinaryOperator(const std::string &op) {
+    static const std::map<std::string, Operator> operators {
+        {"or",  Operator::Or            },
+        {"and", Operator::And           },
+        {"==",  Operator::Equal         },
+        {"!=",  Operator::NotEqual      },
+        {"<",   Operator::Less          },
+        {">",   Operator::Greater       },
+        {"<=",  Operator::LessEqual     },
+        {">=",  Operator::GreaterEqual  },
+        {"+",   Operator::Plus          },
+        {"-",   Operator::Minus         },
+        {"*",   Operator::Multiply      },
+        {"/",   Operator::Divide        },
+        {"div", Operator::Div           },
+        {"mod", Operator::Mod           },
+        {"^",   Operator::Power         },
+        {"+=",  Operator::PlusAssign    },
+        {"-=",  Operator::MinusAssign   },
+        {"*=",  Operator::MultiplyAssign},
+        {"/=",  Operator::DivideAssign  },
+        {"^=",  Operator::PowerAssign   },
+        {"=",   Operator::Assign        },
+    };
+    const auto position = operators.find(op);
+    return position != operators.end() ? position->second : Operator::Unknown;
+}
+
+Operator parser::AST::decodePrefixOperator(const std::string &op) {
+    if (op == "not") return Operator::Not;
+    if (op == "-")   return Operator::Negate;
+    return Operator::Unknown;
+}
+
 // implementing to string functions
 
 std::string Node::nodeLabel() const {
@@ -79,7 +116,7 @@ FORMAT_FOR(ArrayLiteralExpression) {
 }
 
 FORMAT_FOR(VariableDeclarationStatement) {
-    printer << "let " << name;
+    printer << (constant ? "const " : "let ") << name;
     if (value) {
         printer << " = ";
         (*value)->acceptFormatPrinter(printer);
@@ -112,6 +149,20 @@ FORMAT_FOR(ForLoopStatement) {
     body->acceptFormatPrinter(printer);
 }
 
+FORMAT_FOR(ForInLoopStatement) {
+    printer << "for (";
+    for (size_t i = 0; i < variables.size(); i++) {
+        printer << variables[i];
+        if (i != variables.size() - 1) {
+            printer << ", ";
+        }
+    }
+    printer << " in ";
+    collection->acceptFormatPrinter(printer);
+    printer << ") ";
+    body->acceptFormatPrinter(printer);
+}
+
 FORMAT_FOR(WhileLoopStatement) {
     printer << "while (";
     condition->acceptFormatPrinter(printer);
@@ -130,6 +181,35 @@ FORMAT_FOR(IfElseStatement) {
     }
 }
 
+FORMAT_FOR(MatchStatement) {
+    printer << "match (";
+    subject->acceptFormatPrinter(printer);
+    printer << ") {\n";
+    printer.increaseTabLevel();
+    for (const auto &[values, body] : cases) {
+        printer.pad();
+        printer << "case ";
+        for (size_t i = 0; i < values.size(); i++) {
+            values[i]->acceptFormatPrinter(printer);
+            if (i != values.size() - 1) {
+                printer << ", ";
+            }
+        }
+        printer << ": ";
+        body->acceptFormatPrinter(printer);
+        printer << "\n";
+    }
+    if (elseClause) {
+        printer.pad();
+        printer << "else: ";
+        (*elseClause)->acceptFormatPrinter(printer);
+        printer << "\n";
+    }
+    printer.decreaseTabLevel();
+    printer.pad();
+    printer << "}";
+}
+
 FORMAT_FOR(ContinueOperatorStatement) {
     printer << "continue;";
 }
@@ -147,6 +227,12 @@ FORMAT_FOR(ReturnOperatorStatement) {
     printer << ";";
 }
 
+FORMAT_FOR(YieldStatement) {
+    printer << "yield ";
+    expression->acceptFormatPrinter(printer);
+    printer << ";";
+}
+
 FORMAT_FOR(ExpressionStatement) {
     expression->acceptFormatPrinter(printer);
     printer << ";";
@@ -238,6 +324,23 @@ FORMAT_FOR(ObjectExpression) {
     printer << "\n}";
 }
 
+FORMAT_FOR(InterpolationExpression) {
+    printer << "\"";
+    for (const auto &each : parts) {
+        if (each->expressionType() != ExpressionType::StringLiteral) {
+            printer << "${";
+            each->acceptFormatPrinter(printer);
+            printer << "}";
+            continue;
+        }
+        const auto quoted = utils::quotedString(static_cast<StringLiteralExpression*>(each.get())->value, "\"");
+        auto text = quoted.substr(1, quoted.size() - 2);
+        utils::stringReplace(text, "${", "\\${");
+        printer << text;
+    }
+    printer << "\"";
+}
+
 FORMAT_FOR(IllegalExpression) {
     printer << "ERROR";
 }
@@ -302,7 +405,7 @@ DEBUG_FOR(ArrayLiteralExpression) {
 }
 
 DEBUG_FOR(VariableDeclarationStatement) {
-    const auto varDeclLabel = "[let " + name + "]";
+    const auto varDeclLabel = (constant ? "[const " : "[let ") + name + "]";
     PUSH_LABEL(varDeclLabel)
     if (value) {
         NESTED_DEBUG(*value)
@@ -347,6 +450,24 @@ DEBUG_FOR(ForLoopStatement) {
     printer.decreaseTabLevel();
 }
 
+DEBUG_FOR(ForInLoopStatement) {
+    PUSH_LABEL("[for-in loop]")
+    printer.increaseTabLevel();
+
+    for (const auto &each : variables) {
+        const auto loopVarLabel = "[iter " + each + "]";
+        PUSH_LABEL(loopVarLabel)
+    }
+
+    PUSH_LABEL("[collection]")
+    NESTED_DEBUG(collection)
+
+    PUSH_LABEL("[body]")
+    NESTED_DEBUG(body)
+
+    printer.decreaseTabLevel();
+}
+
 DEBUG_FOR(WhileLoopStatement) {
     PUSH_LABEL("[while loop]")
     printer.increaseTabLevel();
@@ -378,6 +499,31 @@ DEBUG_FOR(IfElseStatement) {
     printer.decreaseTabLevel();
 }
 
+DEBUG_FOR(MatchStatement) {
+    PUSH_LABEL("[match]")
+    printer.increaseTabLevel();
+
+    PUSH_LABEL("[subject]")
+    NESTED_DEBUG(subject)
+
+    for (const auto &[values, body] : cases) {
+        PUSH_LABEL("[case]")
+        printer.increaseTabLevel();
+        PUSH_LABEL("[values]")
+        NESTED_DEBUG_EACH(values)
+        PUSH_LABEL("[body]")
+        NESTED_DEBUG(body)
+        printer.decreaseTabLevel();
+    }
+
+    if (elseClause) {
+        PUSH_LABEL("[else clause]")
+        NESTED_DEBUG(*elseClause)
+    }
+
+    printer.decreaseTabLevel();
+}
+
 DEBUG_FOR(ContinueOperatorStatement) {
     PUSH_LABEL("[continue]")
 }
@@ -393,6 +539,11 @@ DEBUG_FOR(ReturnOperatorStatement) {
     }
 }
 
+DEBUG_FOR(YieldStatement) {
+    PUSH_LABEL("[yield]")
+    NESTED_DEBUG(expression)
+}
+
 DEBUG_FOR(ExpressionStatement) {
     PUSH_LABEL("[bare expression]")
     NESTED_DEBUG(expression)
@@ -477,6 +628,11 @@ DEBUG_FOR(ObjectExpression) {
     printer.decreaseTabLevel();
 }
 
+DEBUG_FOR(InterpolationExpression) {
+    PUSH_LABEL("[interpolation]")
+    NESTED_DEBUG_EACH(parts)
+}
+
 DEBUG_FOR(IllegalExpression) {
     PUSH_LABEL("[EXPRESSION ERROR]")
 }
\ No newline at end of file
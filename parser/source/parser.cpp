@@ -33,6 +33,18 @@ using namespace parser::exceptions;
         return std::make_unique<TYPE>(illegal);                          \
     }
 
+// text of strings is never read as syntax,
+// even when it spells a keyword or an operator
+static const std::string& syntaxOf(const Token &token) {
+    static const std::string text;
+    switch (token.type) {
+        case String: case InterpolationStart: case InterpolationMiddle: case InterpolationEnd:
+            return text;
+        default:
+            return token.value;
+    }
+}
+
 // public interface
 
 Parser::Parser(std::istream &input) :
@@ -52,19 +64,26 @@ ProgramPtr Parser::readProgram() {
     return std::unique_ptr<Program>(block);
 }
 
+bool Parser::eof() {
+    return lexer.eof();
+}
+
 // statements
 
 StatementPtr Parser::readStatement() {
-    const auto currentValue = lexer.peek().value;
+    const auto currentValue = syntaxOf(lexer.peek());
     if (currentValue == "import"  ) return readImportLibraryStatement();
     if (currentValue == "let"     ) return readVariableDeclaration();
+    if (currentValue == "const"   ) return readConstantDeclaration();
     if (currentValue == "fun"     ) return readFunctionDeclaration();
     if (currentValue == "for"     ) return readForLoop();
     if (currentValue == "while"   ) return readWhileLoop();
     if (currentValue == "if"      ) return readIfElseStatement();
+    if (currentValue == "match"   ) return readMatchStatement();
     if (currentValue == "continue") return readContinueOperator();
     if (currentValue == "break"   ) return readBreakOperator();
     if (currentValue == "return"  ) return readReturnOperator();
+    if (currentValue == "yield"   ) return readYieldStatement();
     if (currentValue == "{"       ) return readBlockOfStatements();
     if (currentValue == "echo"    ) return readEchoStatement();
     return readBareExpression();
@@ -98,6 +117,18 @@ StatementPtr Parser::readVariableDeclaration() noexcept {
     END_CATCHING_BLOCK(IllegalStatement, "variable declaration")
 }
 
+StatementPtr Parser::readConstantDeclaration() noexcept {
+    CATCHING_BLOCK
+        expectValueToBe("const");
+        auto identifier = expectTypeToBe(Identifier);
+        expectValueToBe("=");
+        std::optional<ExpressionPtr> init = readExpression();
+        expectValueToBe(";");
+        const auto declaration = new VariableDeclarationStatement(identifier, init, startPosition, true);
+        return std::unique_ptr<VariableDeclarationStatement>(declaration);
+    END_CATCHING_BLOCK(IllegalStatement, "constant declaration")
+}
+
 StatementPtr Parser::readFunctionDeclaration() noexcept {
     CATCHING_BLOCK
         expectValueToBe("fun");
@@ -115,6 +146,22 @@ StatementPtr Parser::readForLoop() noexcept {
         expectValueToBe("(");
         auto variable = expectTypeToBe(Identifier);
 
+        if (peekValueIs(",") || peekValueIs("in")) {
+            std::vector<std::string> variables { variable };
+            if (nextIfValue(",")) {
+                variables.push_back(expectTypeToBe(Identifier));
+                if (variables[1] == variable) {
+                    throw DuplicateLoopVariableException(variable);
+                }
+            }
+            expectValueToBe("in");
+            auto collection = readExpression();
+            expectValueToBe(")");
+            auto body = readStatement();
+            const auto loop = new ForInLoopStatement(variables, collection, body, startPosition);
+            return std::unique_ptr<ForInLoopStatement>(loop);
+        }
+
         expectValueToBe("from");
         auto start = readExpression();
         expectValueToBe("to");
@@ -160,6 +207,33 @@ StatementPtr Parser::readIfElseStatement() noexcept {
     END_CATCHING_BLOCK(IllegalStatement, "if-else statement")
 }
 
+StatementPtr Parser::readMatchStatement() noexcept {
+    CATCHING_BLOCK
+        expectValueToBe("match");
+        expectValueToBe("(");
+        auto subject = readExpression();
+        expectValueToBe(")");
+        expectValueToBe("{");
+        MatchStatement::CaseList cases;
+        while (nextIfValue("case")) {
+            std::vector<ExpressionPtr> values;
+            do {
+                values.push_back(readCaseValue());
+            } while (nextIfValue(","));
+            expectValueToBe(":");
+            cases.emplace_back(std::move(values), readStatement());
+        }
+        std::optional<StatementPtr> elseClause = std::nullopt;
+        if (nextIfValue("else")) {
+            expectValueToBe(":");
+            elseClause = readStatement();
+        }
+        expectValueToBe("}");
+        const auto match = new MatchStatement(subject, cases, elseClause, startPosition);
+        return std::unique_ptr<MatchStatement>(match);
+    END_CATCHING_BLOCK(IllegalStatement, "match statement")
+}
+
 StatementPtr Parser::readContinueOperator() noexcept {
     CATCHING_BLOCK
         expectValueToBe("continue");
@@ -192,6 +266,16 @@ StatementPtr Parser::readReturnOperator() noexcept {
     END_CATCHING_BLOCK(IllegalStatement, "return operator")
 }
 
+StatementPtr Parser::readYieldStatement() noexcept {
+    CATCHING_BLOCK
+        expectValueToBe("yield");
+        auto expression = readExpression();
+        expectValueToBe(";");
+        const auto yield = new YieldStatement(expression, startPosition);
+        return std::unique_ptr<YieldStatement>(yield);
+    END_CATCHING_BLOCK(IllegalStatement, "yield statement")
+}
+
 StatementPtr Parser::readBareExpression() noexcept {
     CATCHING_BLOCK
         auto expression = readExpression();
@@ -235,7 +319,7 @@ ExpressionPtr Parser::readExpression() noexcept {
 ExpressionPtr Parser::readLeftBinOp(const std::set<std::string> &ops, const ExpressionParser &parser) {
     auto startPosition = lexer.peek().position;
     auto left = parser();
-    while (ops.contains(lexer.peek().value)) {
+    while (ops.contains(syntaxOf(lexer.peek()))) {
         auto op = lexer.next().value;
         auto right = parser();
         const auto binOp = new BinaryOperationExpression(left, right, op, startPosition);
@@ -247,7 +331,7 @@ ExpressionPtr Parser::readLeftBinOp(const std::set<std::string> &ops, const Expr
 ExpressionPtr Parser::readRightBinOp(const std::set<std::string> &ops, const ExpressionParser &parser) {
     auto startPosition = lexer.peek().position;
     auto left = parser();
-    if (ops.contains(lexer.peek().value)) {
+    if (ops.contains(syntaxOf(lexer.peek()))) {
         auto op = lexer.next().value;
         auto right = readRightBinOp(ops, parser);
         const auto binOp = new BinaryOperationExpression(left, right, op, startPosition);
@@ -262,7 +346,7 @@ const std::set<std::string> PREFIX_OPERATORS {
 
 ExpressionPtr Parser::readPrefixOperation() {
     auto startPosition = lexer.peek().position;
-    if (PREFIX_OPERATORS.contains(lexer.peek().value)) {
+    if (PREFIX_OPERATORS.contains(syntaxOf(lexer.peek()))) {
         auto op = lexer.next().value;
         auto nested = readPrefixOperation();
         const auto prefOp = new PrefixOperationExpression(nested, op, startPosition);
@@ -335,6 +419,9 @@ ExpressionPtr Parser::readAtomicExpression() noexcept {
             auto value = lexer.next().value;
             return std::make_unique<StringLiteralExpression>(value, startPosition);
         }
+        if (peekTypeIs(InterpolationStart)) {
+            return readInterpolationExpression();
+        }
         if (peekTypeIs(Identifier)) {
             auto name = lexer.next().value;
             const auto var = new VariableExpression(name, startPosition);
@@ -371,6 +458,52 @@ ExpressionPtr Parser::readLambdaExpression() noexcept {
     END_CATCHING_BLOCK(IllegalExpression, "lambda expression")
 }
 
+ExpressionPtr Parser::readInterpolationExpression() noexcept {
+    CATCHING_BLOCK
+        std::vector<ExpressionPtr> parts;
+        const auto addText = [&parts](std::string text, Position position) {
+            if (text.empty()) return;
+            parts.push_back(std::make_unique<StringLiteralExpression>(text, position));
+        };
+        addText(expectTypeToBe(InterpolationStart), startPosition);
+        while (true) {
+            parts.push_back(readExpression());
+            const auto textPosition = lexer.peek().position;
+            if (peekTypeIs(InterpolationMiddle)) {
+                addText(lexer.next().value, textPosition);
+                continue;
+            }
+            addText(expectTypeToBe(InterpolationEnd), textPosition);
+            break;
+        }
+        return std::make_unique<InterpolationExpression>(parts, startPosition);
+    END_CATCHING_BLOCK(IllegalExpression, "string interpolation")
+}
+
+// case values are literals, a number may be negated
+ExpressionPtr Parser::readCaseValue() {
+    auto startPosition = lexer.peek().position;
+    if (nextIfValue("nil")) {
+        return std::make_unique<NilLiteralExpression>(startPosition);
+    }
+    if (nextIfValue("true")) {
+        return std::make_unique<BooleanLiteralExpression>(true, startPosition);
+    }
+    if (nextIfValue("false")) {
+        return std::make_unique<BooleanLiteralExpression>(false, startPosition);
+    }
+    if (peekTypeIs(String)) {
+        auto value = lexer.next().value;
+        return std::make_unique<StringLiteralExpression>(value, startPosition);
+    }
+    const auto negated = nextIfValue("-");
+    if (!peekTypeIs(Number)) {
+        throw IllegalCaseValueException(lexer.peek());
+    }
+    const auto value = std::stold(lexer.next().value);
+    return std::make_unique<NumberLiteralExpression>(negated ? -value : value, startPosition);
+}
+
 // helper functions
 
 std::vector<ExpressionPtr> Parser::readExpressionList(const std::string &start, const std::string &end) {
@@ -386,7 +519,7 @@ std::vector<ExpressionPtr> Parser::readExpressionList(const std::string &start,
 
 bool Parser::peekValueIs(const std::string &value) {
     const auto peek = lexer.peek();
-    return peek.value == value;
+    return syntaxOf(peek) == value;
 }
 
 bool Parser::peekTypeIs(TokenType type) {
@@ -403,7 +536,7 @@ bool Parser::nextIfValue(const std::string &value) {
 }
 
 void Parser::expectValueToBe(const std::string &expectedValue) {
-    if (lexer.peek().value == expectedValue) {
+    if (syntaxOf(lexer.peek()) == expectedValue) {
         lexer.next();
         return;
     }
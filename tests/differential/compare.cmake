@@ -0,0 +1,45 @@
+# Runs PROGRAM with `toy_lang_app run` and as the executable
+# `toy_lang_app build` makes of it, failing unless both print
+# the same. The executable runs from OUTPUT_DIRECTORY, away
+# from the modules the program imports, so they have to be
+# embedded into it. LOWERED tells whether the program has to be
+# turned into C++ instead of having its syntax tree embedded
+separate_arguments(RUN_OPTIONS UNIX_COMMAND "${OPTIONS}")
+get_filename_component(PROGRAM_DIRECTORY ${PROGRAM} DIRECTORY)
+get_filename_component(PROGRAM_NAME ${PROGRAM} NAME_WE)
+set(EXECUTABLE ${OUTPUT_DIRECTORY}/${PROGRAM_NAME}${SUFFIX})
+file(MAKE_DIRECTORY ${OUTPUT_DIRECTORY})
+
+execute_process(
+    COMMAND ${APP} run ${RUN_OPTIONS} ${PROGRAM_NAME}.toy
+    WORKING_DIRECTORY ${PROGRAM_DIRECTORY}
+    OUTPUT_VARIABLE EXPECTED ERROR_VARIABLE EXPECTED
+    RESULT_VARIABLE EXPECTED_RESULT
+)
+execute_process(
+    COMMAND ${APP} build --output=${EXECUTABLE} ${RUN_OPTIONS} ${PROGRAM_NAME}.toy
+    WORKING_DIRECTORY ${PROGRAM_DIRECTORY}
+    OUTPUT_VARIABLE BUILD_OUTPUT ERROR_VARIABLE BUILD_OUTPUT
+    RESULT_VARIABLE BUILD_RESULT
+)
+if (NOT BUILD_RESULT EQUAL 0)
+    message(FATAL_ERROR "Could not build ${PROGRAM}:\n${BUILD_OUTPUT}")
+endif()
+string(FIND "${BUILD_OUTPUT}" "syntax tree is embedded" EMBEDDED)
+if (LOWERED AND NOT EMBEDDED EQUAL -1)
+    message(FATAL_ERROR "${PROGRAM} was embedded instead of lowered:\n${BUILD_OUTPUT}")
+endif()
+if (NOT LOWERED AND EMBEDDED EQUAL -1)
+    message(FATAL_ERROR "${PROGRAM} was embedded without a note:\n${BUILD_OUTPUT}")
+endif()
+execute_process(
+    COMMAND ${EXECUTABLE}
+    WORKING_DIRECTORY ${OUTPUT_DIRECTORY}
+    OUTPUT_VARIABLE ACTUAL ERROR_VARIABLE ACTUAL
+    RESULT_VARIABLE ACTUAL_RESULT
+)
+if (NOT ACTUAL STREQUAL EXPECTED OR NOT ACTUAL_RESULT EQUAL EXPECTED_RESULT)
+    message(FATAL_ERROR "${PROGRAM} built with \"${OPTIONS}\" differs from `run`\n"
+        "run (exit code ${EXPECTED_RESULT}):\n${EXPECTED}\n"
+        "built (exit code ${ACTUAL_RESULT}):\n${ACTUAL}")
+endif()
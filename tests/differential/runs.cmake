@@ -0,0 +1,25 @@
+# Runs PROGRAM with `toy_lang_app run` twice, with REFERENCE
+# and with OPTIONS, failing unless both print the same and
+# exit with the same code
+separate_arguments(REFERENCE_OPTIONS UNIX_COMMAND "${REFERENCE}")
+separate_arguments(RUN_OPTIONS UNIX_COMMAND "${OPTIONS}")
+get_filename_component(PROGRAM_DIRECTORY ${PROGRAM} DIRECTORY)
+get_filename_component(PROGRAM_NAME ${PROGRAM} NAME_WE)
+
+execute_process(
+    COMMAND ${APP} run ${REFERENCE_OPTIONS} ${PROGRAM_NAME}.toy
+    WORKING_DIRECTORY ${PROGRAM_DIRECTORY}
+    OUTPUT_VARIABLE EXPECTED ERROR_VARIABLE EXPECTED
+    RESULT_VARIABLE EXPECTED_RESULT
+)
+execute_process(
+    COMMAND ${APP} run ${RUN_OPTIONS} ${PROGRAM_NAME}.toy
+    WORKING_DIRECTORY ${PROGRAM_DIRECTORY}
+    OUTPUT_VARIABLE ACTUAL ERROR_VARIABLE ACTUAL
+    RESULT_VARIABLE ACTUAL_RESULT
+)
+if (NOT ACTUAL STREQUAL EXPECTED OR NOT ACTUAL_RESULT EQUAL EXPECTED_RESULT)
+    message(FATAL_ERROR "${PROGRAM} run with \"${OPTIONS}\" differs from \"${REFERENCE}\"\n"
+        "\"${REFERENCE}\" (exit code ${EXPECTED_RESULT}):\n${EXPECTED}\n"
+        "\"${OPTIONS}\" (exit code ${ACTUAL_RESULT}):\n${ACTUAL}")
+endif()
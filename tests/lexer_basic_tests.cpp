@@ -194,3 +194,14 @@ TEST(BasicLexerTests, ConstructionsTest) {
     };
     STRICT_VALUES_MATCH;
 }
+
+TEST(BasicLexerTests, InterpolationTest) {
+    INPUT R"(
+        "Cat ${name} said ${obj {"n": n}["n"]}!" "\${plain}"
+    )";
+    FULL_TOKENS {
+        "Cat ", "name", " said ", "obj", "{", "n", ":", "n", "}", "[", "n", "]", "!",
+        "${plain}",
+    };
+    STRICT_VALUES_MATCH;
+}
@@ -31,6 +31,25 @@ R"([program]
     checkParser(program, expectedOutput);
 }
 
+TEST(BasicParserTests, ConstantDeclarationTest) {
+    const auto program = R"(
+        const SIZE = 64;
+        const AREA = SIZE * SIZE;
+        const EMPTY;
+    )";
+    const auto expectedOutput =
+R"([program]
+  [const SIZE]
+    [number 64]
+  [const AREA]
+    [op *]
+      [var SIZE]
+      [var SIZE]
+  [STATEMENT ERROR]
+)";
+    checkParser(program, expectedOutput);
+}
+
 TEST(BasicParserTests, VariableDeclarationTest) {
     const auto program = R"(
         let a;
@@ -286,4 +305,141 @@ R"([program]
             [continue]
 )";
     checkParser(program, expectedOutput);
-}
\ No newline at end of file
+}
+
+TEST(BasicParserTests, MatchStatementTest) {
+    const auto program = R"(
+        match (x) {
+            case 1, -2: echo "small";
+            case "a": { break; }
+            else: echo nil;
+        }
+    )";
+    const auto expectedOutput =
+R"([program]
+  [match]
+    [subject]
+      [var x]
+    [case]
+      [values]
+        [number 1]
+        [number -2]
+      [body]
+        [echo]
+          [str "small"]
+    [case]
+      [values]
+        [str "a"]
+      [body]
+        [block]
+          [break]
+    [else clause]
+      [echo]
+        [nil]
+)";
+    checkParser(program, expectedOutput);
+}
+
+TEST(BasicParserTests, ForInLoopTest) {
+    const auto program = R"(
+        for (x in xs) echo x;
+        for (key, value in obj {}) { continue; }
+    )";
+    const auto expectedOutput =
+R"([program]
+  [for-in loop]
+    [iter x]
+    [collection]
+      [var xs]
+    [body]
+      [echo]
+        [var x]
+  [for-in loop]
+    [iter key]
+    [iter value]
+    [collection]
+      [object]
+    [body]
+      [block]
+        [continue]
+)";
+    checkParser(program, expectedOutput);
+}
+
+TEST(BasicParserTests, YieldTest) {
+    const auto program = R"(
+        fun naturals() {
+            while (true) yield n += 1;
+        }
+    )";
+    const auto expectedOutput =
+R"([program]
+  [fun naturals]
+    [parameters]
+    [body]
+      [block]
+        [while loop]
+          [condition]
+            [bool true]
+          [body]
+            [yield]
+              [op +=]
+                [var n]
+                [number 1]
+)";
+    checkParser(program, expectedOutput);
+}
+
+TEST(BasicParserTests, InterpolationTest) {
+    const auto program = R"(
+        echo "Hello, ${name}! ${a + 1}";
+    )";
+    const auto expectedOutput =
+R"([program]
+  [echo]
+    [interpolation]
+      [str "Hello, "]
+      [var name]
+      [str "! "]
+      [op +]
+        [var a]
+        [number 1]
+)";
+    checkParser(program, expectedOutput);
+}
+
+TEST(BasicParserTests, InterpolationOperatorTextTest) {
+    const auto program = R"(
+        echo "${key}=${value}+";
+    )";
+    const auto expectedOutput =
+R"([program]
+  [echo]
+    [interpolation]
+      [var key]
+      [str "="]
+      [var value]
+      [str "+"]
+)";
+    checkParser(program, expectedOutput);
+}
+
+TEST(BasicParserTests, DecodedOperatorsTest) {
+    std::istringstream stream("a += b div 2 == -c; not d;");
+    auto parser = Parser(stream);
+    const auto ast = parser.readProgram();
+    ASSERT_TRUE(parser.getErrors().empty());
+    using namespace parser::AST;
+    const auto first = static_cast<ExpressionStatement*>(ast->statements[0].get());
+    const auto assign = static_cast<BinaryOperationExpression*>(first->expression.get());
+    EXPECT_EQ(Operator::PlusAssign, assign->opcode);
+    const auto equal = static_cast<BinaryOperationExpression*>(assign->right.get());
+    EXPECT_EQ(Operator::Equal, equal->opcode);
+    const auto div = static_cast<BinaryOperationExpression*>(equal->left.get());
+    EXPECT_EQ(Operator::Div, div->opcode);
+    const auto negate = static_cast<PrefixOperationExpression*>(equal->right.get());
+    EXPECT_EQ(Operator::Negate, negate->opcode);
+    const auto second = static_cast<ExpressionStatement*>(ast->statements[1].get());
+    const auto notOp = static_cast<PrefixOperationExpression*>(second->expression.get());
+    EXPECT_EQ(Operator::Not, notOp->opcode);
+}